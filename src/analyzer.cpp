@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <thread>
+
+#include "analyzer.h"
+
+
+const char* GradeName(MoveGrade grade)
+{
+	switch (grade) {
+	case GRADE_BEST:
+		return "best";
+	case GRADE_INACCURACY:
+		return "inaccuracy";
+	case GRADE_MISSED_WIN:
+		return "missed win";
+	case GRADE_BLUNDER:
+		return "blunder";
+	}
+
+	return "?";
+}
+
+// Whether a is the better result for the same player: a higher value, then
+// a quicker win or a slower loss.
+static bool Better(const PositionValue& a, const PositionValue& b)
+{
+	if (a.m_Value != b.m_Value) {
+		return a.m_Value > b.m_Value;
+	}
+	if (a.m_Value > 0) {
+		return a.m_Distance < b.m_Distance;
+	}
+	if (a.m_Value < 0) {
+		return a.m_Distance > b.m_Distance;
+	}
+
+	return false;
+}
+
+PositionCache::PositionCache() :
+	m_Values(Positions),
+	m_Known(Positions),
+	m_Lookups {},
+	m_Solved {}
+{
+}
+
+PositionValue PositionCache::Lookup(const i32 cells[3][3])
+{
+	i32 board[3][3] {};
+	u32 index {};
+	u32 moves {};
+	u32 power = 1;
+
+	for (u32 i = 0; i < 9; ++i, power *= 3) {
+		board[i / 3][i % 3] = cells[i / 3][i % 3];
+		index += static_cast<u32>(cells[i / 3][i % 3]) * power;
+		moves += cells[i / 3][i % 3] != 0 ? 1 : 0;
+	}
+
+	++m_Lookups;
+	if (m_Known[index]) {
+		return m_Values[index];
+	}
+
+	++m_Solved;
+	return Solve(board, index, moves);
+}
+
+u64 PositionCache::Lookups() const
+{
+	return m_Lookups;
+}
+
+u64 PositionCache::Solved() const
+{
+	return m_Solved;
+}
+
+PositionValue PositionCache::Solve(i32 cells[3][3], u32 index, u32 moves)
+{
+	if (m_Known[index]) {
+		return m_Values[index];
+	}
+
+	PositionValue best {};
+
+	// The player who just moved has won, or nobody can move.
+	if (CheckWinner(cells) != Utility::T) {
+		best.m_Value = -1;
+	}
+	else if (moves < 9) {
+		const i32 mark  = moves % 2 == 0 ? 1 : 2;
+		bool      first = true;
+
+		u32 power = 1;
+		for (u32 i = 0; i < 9; ++i, power *= 3) {
+			if (cells[i / 3][i % 3] != 0) {
+				continue;
+			}
+
+			cells[i / 3][i % 3] = mark;
+			const PositionValue child =
+				Solve(cells, index + static_cast<u32>(mark) * power, moves + 1);
+			cells[i / 3][i % 3] = 0;
+
+			const PositionValue value { static_cast<signed char>(-child.m_Value),
+										static_cast<unsigned char>(child.m_Distance + 1) };
+			if (first or Better(value, best)) {
+				best  = value;
+				first = false;
+			}
+		}
+	}
+
+	m_Values[index] = best;
+	m_Known[index]  = true;
+
+	return best;
+}
+
+GameAnalyzer::GameAnalyzer(u32 threads) :
+	m_Threads { threads > 0 ? threads : 1 },
+	m_Finished { false }
+{
+}
+
+void GameAnalyzer::Analyze(const GameRecord& record, PositionCache& cache, GameAnalysis& analysis)
+{
+	analysis          = GameAnalysis {};
+	analysis.m_Record = record;
+
+	i32 cells[3][3] {};
+	u32 best[2] {};
+	u32 played[2] {};
+
+	for (u32 i = 0; i < record.m_Moves and i < 9; ++i) {
+		const u32 cell = record.m_History[i];
+		if (cell > 8 or cells[cell / 3][cell % 3] != 0 or CheckWinner(cells) != Utility::T) {
+			break;
+		}
+
+		const u32 side = i % 2;
+
+		MoveAnnotation& annotation = analysis.m_Annotations[i];
+		annotation.m_Cell          = cell;
+		annotation.m_Best          = cache.Lookup(cells);
+
+		cells[cell / 3][cell % 3] = side == 0 ? 1 : 2;
+
+		const PositionValue after = cache.Lookup(cells);
+		annotation.m_Played       = { static_cast<signed char>(-after.m_Value),
+									  static_cast<unsigned char>(after.m_Distance + 1) };
+
+		if (annotation.m_Played.m_Value < annotation.m_Best.m_Value) {
+			annotation.m_Grade = annotation.m_Best.m_Value > 0 and annotation.m_Played.m_Value == 0
+									 ? GRADE_MISSED_WIN
+									 : GRADE_BLUNDER;
+		}
+		else if (Better(annotation.m_Best, annotation.m_Played)) {
+			annotation.m_Grade = GRADE_INACCURACY;
+		}
+
+		++played[side];
+		if (annotation.m_Grade == GRADE_BEST) {
+			++best[side];
+		}
+		else {
+			++analysis.m_Mistakes[side];
+		}
+
+		analysis.m_Moves = i + 1;
+	}
+
+	for (u32 side = 0; side < 2; ++side) {
+		analysis.m_Accuracy[side] =
+			played[side] > 0 ? 100.0 * best[side] / played[side] : 100.0;
+	}
+}
+
+AnalyzerStats GameAnalyzer::Run(
+	const std::function<bool(GameRecord&)>&         next,
+	const std::function<void(const GameAnalysis&)>& visit)
+{
+	m_Stats    = AnalyzerStats {};
+	m_Finished = false;
+
+	std::vector<std::thread> workers {};
+	for (u32 i = 0; i < m_Threads; ++i) {
+		workers.emplace_back(&GameAnalyzer::RunWorker, this);
+	}
+
+	// Enough batches in flight to keep every worker busy while the results
+	// of the oldest one are handed out.
+	const u64 limit = m_Threads * 2;
+
+	u64  produced {};
+	u64  emitted {};
+	bool more = true;
+
+	std::unique_lock lock { m_Mutex };
+	while (true) {
+		for (auto done = m_Done.find(emitted); done != m_Done.end(); done = m_Done.find(emitted)) {
+			std::unique_ptr<Batch> batch = std::move(done->second);
+			m_Done.erase(done);
+			++emitted;
+
+			lock.unlock();
+			for (const auto& result : batch->m_Results) {
+				visit(result);
+			}
+			lock.lock();
+		}
+
+		if (more and produced - emitted < limit) {
+			lock.unlock();
+
+			auto batch        = std::make_unique<Batch>();
+			batch->m_Sequence = produced;
+			batch->m_Records.resize(BatchSize);
+
+			u32 count {};
+			while (count < BatchSize and next(batch->m_Records[count])) {
+				++count;
+			}
+			batch->m_Records.resize(count);
+			more = count == BatchSize;
+
+			lock.lock();
+			if (count > 0) {
+				m_Input.push_back(std::move(batch));
+				++produced;
+				m_Work.notify_one();
+			}
+			continue;
+		}
+
+		if (!more and emitted == produced) {
+			break;
+		}
+
+		m_Ready.wait(lock);
+	}
+
+	m_Finished = true;
+	m_Work.notify_all();
+	lock.unlock();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	return m_Stats;
+}
+
+void GameAnalyzer::RunWorker()
+{
+	PositionCache cache {};
+	AnalyzerStats stats {};
+
+	std::unique_lock lock { m_Mutex };
+	while (true) {
+		m_Work.wait(lock, [this]() { return !m_Input.empty() or m_Finished; });
+		if (m_Input.empty()) {
+			break;
+		}
+
+		std::unique_ptr<Batch> batch = std::move(m_Input.front());
+		m_Input.pop_front();
+		lock.unlock();
+
+		batch->m_Results.resize(batch->m_Records.size());
+		for (u64 i = 0; i < batch->m_Records.size(); ++i) {
+			GameAnalysis& analysis = batch->m_Results[i];
+			Analyze(batch->m_Records[i], cache, analysis);
+
+			++stats.m_Games;
+			stats.m_Moves += analysis.m_Moves;
+			stats.m_Illegal += analysis.m_Moves < std::min(analysis.m_Record.m_Moves, 9u);
+			for (u32 move = 0; move < analysis.m_Moves; ++move) {
+				const MoveGrade grade = analysis.m_Annotations[move].m_Grade;
+				stats.m_Inaccuracies += grade == GRADE_INACCURACY;
+				stats.m_MissedWins += grade == GRADE_MISSED_WIN;
+				stats.m_Blunders += grade == GRADE_BLUNDER;
+			}
+		}
+
+		lock.lock();
+		m_Done.emplace(batch->m_Sequence, std::move(batch));
+		m_Ready.notify_one();
+	}
+
+	m_Stats.m_Games += stats.m_Games;
+	m_Stats.m_Moves += stats.m_Moves;
+	m_Stats.m_Inaccuracies += stats.m_Inaccuracies;
+	m_Stats.m_MissedWins += stats.m_MissedWins;
+	m_Stats.m_Blunders += stats.m_Blunders;
+	m_Stats.m_Illegal += stats.m_Illegal;
+	m_Stats.m_Lookups += cache.Lookups();
+	m_Stats.m_Solved += cache.Solved();
+}
@@ -0,0 +1,117 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "journal.h"
+
+
+enum MoveGrade : unsigned char {
+	GRADE_BEST,
+	GRADE_INACCURACY,    // keeps the result but wins slower or loses sooner
+	GRADE_MISSED_WIN,    // a won position let go to a draw
+	GRADE_BLUNDER        // a win or draw turned into a loss
+};
+
+const char* GradeName(MoveGrade grade);
+
+// Perfect-play value of a position for the side to move (1 win, 0 draw,
+// -1 loss) and the number of moves to the end when both sides play for the
+// quickest win and the slowest loss.
+struct PositionValue {
+	signed char   m_Value {};
+	unsigned char m_Distance {};
+};
+
+struct MoveAnnotation {
+	u32           m_Cell {};
+	MoveGrade     m_Grade { GRADE_BEST };
+	PositionValue m_Best;      // before the move
+	PositionValue m_Played;    // after it, still for the player who moved
+};
+
+struct GameAnalysis {
+	GameRecord     m_Record;
+	u32            m_Moves {};    // annotated, stops at an illegal move
+	MoveAnnotation m_Annotations[9];
+	u32            m_Mistakes[2] {};    // X, O: anything but GRADE_BEST
+	double         m_Accuracy[2] {};    // X, O: percent of best moves
+};
+
+struct AnalyzerStats {
+	u64 m_Games {};
+	u64 m_Moves {};
+	u64 m_Inaccuracies {};
+	u64 m_MissedWins {};
+	u64 m_Blunders {};
+	u64 m_Illegal {};     // games cut short at an illegal move
+	u64 m_Lookups {};
+	u64 m_Solved {};      // lookups that had to search
+};
+
+// Solves positions on demand and keeps every answer, one per thread so no
+// lookup ever takes a lock.
+class PositionCache {
+public:
+	PositionCache();
+
+	PositionValue Lookup(const i32 cells[3][3]);
+
+	u64 Lookups() const;
+	u64 Solved() const;
+
+private:
+	static constexpr u32 Positions = 19683;    // 3^9
+
+	std::vector<PositionValue> m_Values;
+	std::vector<bool>          m_Known;
+	u64                        m_Lookups;
+	u64                        m_Solved;
+
+	PositionValue Solve(i32 cells[3][3], u32 index, u32 moves);
+};
+
+// Grades every move of a stream of games against perfect play. Games are cut
+// into batches that worker threads analyze with caches of their own, and the
+// results come back in input order.
+class GameAnalyzer {
+public:
+	static constexpr u32 BatchSize = 1024;
+
+	explicit GameAnalyzer(u32 threads = 1);
+
+	// Pulls games from next until it returns false and calls visit for each
+	// result on the calling thread.
+	AnalyzerStats Run(
+		const std::function<bool(GameRecord&)>&         next,
+		const std::function<void(const GameAnalysis&)>& visit);
+
+	static void Analyze(const GameRecord& record, PositionCache& cache, GameAnalysis& analysis);
+
+private:
+	struct Batch {
+		u64                       m_Sequence {};
+		std::vector<GameRecord>   m_Records;
+		std::vector<GameAnalysis> m_Results;
+	};
+
+	u32 m_Threads;
+
+	std::mutex                            m_Mutex;
+	std::condition_variable               m_Work;
+	std::condition_variable               m_Ready;
+	std::deque<std::unique_ptr<Batch>>    m_Input;
+	std::map<u64, std::unique_ptr<Batch>> m_Done;
+	bool                                  m_Finished;
+	AnalyzerStats                         m_Stats;
+
+	void RunWorker();
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "analyzer.h"
+#include "search.h"
+
+
+// Writes a journal of games where each move is the engine's with a given
+// chance and random otherwise, then analyzes it with one thread and with
+// the requested number. Engine moves must never be graded as losing value,
+// and results must come back in journal order.
+//
+//     AnalyzerBench [games] [threads] [path]
+int main(int argc, char* argv[])
+{
+	const u64   games   = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+	const u32   threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+	const char* path    = argc > 3 ? argv[3] : "analyzer-bench.journal";
+
+	if (games == 0 or threads == 0) {
+		std::cerr << "Usage: AnalyzerBench [games] [threads] [path]" << std::endl;
+		return -1;
+	}
+
+	unlink(path);
+
+	const PerfectTable& table = PerfectTable::Get();
+	std::mt19937_64     random { 1 };
+
+	// One bit per move, set where the engine chose it.
+	std::vector<u32> engine(games);
+
+	{
+		GameJournal journal {};
+		if (!journal.Open(path)) {
+			return -1;
+		}
+
+		for (u64 i = 0; i < games; ++i) {
+			GameRecord record {};
+			record.m_GameId = i + 1;
+			record.m_Time   = UnixNanoseconds();
+
+			Board board {};
+			while (board.m_State == GAME_INPROGRESS) {
+				const i32 mark = board.m_Player1Turn ? 1 : 2;
+				u32       cell {};
+
+				if (random() % 100 < 80) {
+					const auto [row, col] = table.BestMove(board.m_Cells, mark);
+					cell                  = static_cast<u32>(row * 3 + col);
+					engine[i] |= 1u << board.m_Moves;
+				}
+				else {
+					do {
+						cell = random() % 9;
+					} while (board.m_Cells[cell / 3][cell % 3] != 0);
+				}
+
+				record.m_History[board.m_Moves] = static_cast<unsigned char>(cell);
+				board.Play(cell / 3, cell % 3);
+			}
+
+			record.m_Moves  = board.m_Moves;
+			record.m_Winner = board.m_Winner;
+			journal.Append(record);
+		}
+
+		journal.Sync();
+	}
+
+	u64 failures {};
+
+	for (const u32 count : { 1u, threads }) {
+		JournalReader reader {};
+		if (!reader.Open(path)) {
+			return -1;
+		}
+
+		u64 expected = 1;
+
+		const auto check = [&](const GameAnalysis& analysis) {
+			const u64 id = analysis.m_Record.m_GameId;
+			failures += id != expected++;
+
+			for (u32 move = 0; move < analysis.m_Moves; ++move) {
+				const MoveGrade grade = analysis.m_Annotations[move].m_Grade;
+				if ((engine[id - 1] >> move & 1) != 0 and grade != GRADE_BEST and
+					grade != GRADE_INACCURACY) {
+					++failures;
+				}
+			}
+		};
+
+		const u64           start = NowNanoseconds();
+		GameAnalyzer        analyzer { count };
+		const AnalyzerStats stats = analyzer.Run(
+			[&reader](GameRecord& record) { return reader.Next(record); }, check);
+		const u64 took = NowNanoseconds() - start;
+
+		failures += stats.m_Games != games;
+
+		std::cout << count << " thread(s): " << stats.m_Games << " games in " << took / 1'000'000
+				  << " ms (" << static_cast<double>(stats.m_Games) * 1e9 / static_cast<double>(took)
+				  << " games/s), " << stats.m_Blunders << " blunders, " << stats.m_MissedWins
+				  << " missed wins, " << stats.m_Inaccuracies << " inaccuracies, "
+				  << stats.m_Solved << "/" << stats.m_Lookups << " lookups solved" << std::endl;
+	}
+
+	unlink(path);
+	std::cout << failures << " failures" << std::endl;
+
+	return failures == 0 ? 0 : -1;
+}
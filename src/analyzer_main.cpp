@@ -0,0 +1,95 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "analyzer.h"
+#include "archive.h"
+
+
+//     TicTacToeAnalyze [--threads N] [--archive] [--all] LOG
+//
+// Grades every move in a game journal (or an archive with --archive) against
+// perfect play. Prints one line per game with a mistake in it, or per game
+// with --all, then totals and the average accuracy of each side.
+int main(int argc, char* argv[])
+{
+	u32         threads = 1;
+	bool        archive {};
+	bool        all {};
+	const char* path {};
+
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--threads") == 0 and i + 1 < argc) {
+			threads = static_cast<u32>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--archive") == 0) {
+			archive = true;
+		}
+		else if (std::strcmp(argv[i], "--all") == 0) {
+			all = true;
+		}
+		else if (path == nullptr) {
+			path = argv[i];
+		}
+		else {
+			path = nullptr;
+			break;
+		}
+	}
+
+	if (path == nullptr) {
+		std::cerr << "Usage: TicTacToeAnalyze [--threads N] [--archive] [--all] LOG" << std::endl;
+		return -1;
+	}
+
+	JournalReader journal {};
+	ArchiveReader reader {};
+	if (archive ? !reader.Open(path) : !journal.Open(path)) {
+		return -1;
+	}
+
+	const auto next = [&](GameRecord& record) {
+		return archive ? reader.Next(record) : journal.Next(record);
+	};
+
+	double accuracy[2] {};
+
+	const auto report = [&](const GameAnalysis& analysis) {
+		accuracy[0] += analysis.m_Accuracy[0];
+		accuracy[1] += analysis.m_Accuracy[1];
+
+		if (!all and analysis.m_Mistakes[0] + analysis.m_Mistakes[1] == 0) {
+			return;
+		}
+
+		std::cout << "game " << analysis.m_Record.m_GameId << " X " << analysis.m_Accuracy[0]
+				  << "% O " << analysis.m_Accuracy[1] << "%";
+
+		for (u32 i = 0; i < analysis.m_Moves; ++i) {
+			const MoveAnnotation& annotation = analysis.m_Annotations[i];
+			if (annotation.m_Grade != GRADE_BEST) {
+				std::cout << ", " << i + 1 << (i % 2 == 0 ? " X" : " O") << annotation.m_Cell
+						  << " " << GradeName(annotation.m_Grade);
+			}
+		}
+		std::cout << "\n";
+	};
+
+	const u64           start = NowNanoseconds();
+	GameAnalyzer        analyzer { threads };
+	const AnalyzerStats stats = analyzer.Run(next, report);
+	const u64           took  = NowNanoseconds() - start;
+
+	const double games = static_cast<double>(stats.m_Games > 0 ? stats.m_Games : 1);
+
+	std::cout << stats.m_Games << " games, " << stats.m_Moves << " moves in " << took / 1'000'000
+			  << " ms (" << static_cast<double>(stats.m_Games) * 1e9 / static_cast<double>(took)
+			  << " games/s)\n"
+			  << stats.m_Blunders << " blunders, " << stats.m_MissedWins << " missed wins, "
+			  << stats.m_Inaccuracies << " inaccuracies, " << stats.m_Illegal
+			  << " games cut at an illegal move\n"
+			  << "Accuracy X " << accuracy[0] / games << "%, O " << accuracy[1] / games << "%"
+			  << std::endl;
+
+	return archive and reader.Failed() ? -1 : 0;
+}
@@ -0,0 +1,307 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "archive.h"
+#include "file_io.h"
+#include "game_codec.h"
+
+
+static constexpr unsigned char Magic[8] = { 'T', 'T', 'T', 'A', 'R', 'C', 'H', '1' };
+
+// Two varints of at most ten bytes, the word and five bytes of moves.
+static constexpr u64 MaxRecordSize = 10 + 10 + 4 + 5;
+
+enum RecordKind : u32 {
+	KIND_COMPLETE,
+	KIND_PREFIX,
+	KIND_RAW
+};
+
+static u64 ZigZag(i64 value)
+{
+	return (static_cast<u64>(value) << 1) ^ static_cast<u64>(value >> 63);
+}
+
+static i64 UnZigZag(u64 value)
+{
+	return static_cast<i64>(value >> 1) ^ -static_cast<i64>(value & 1);
+}
+
+ArchiveWriter::ArchiveWriter() :
+	m_File { -1 },
+	m_Failed { false },
+	m_Time {},
+	m_GameId {},
+	m_Records {},
+	m_Bytes {}
+{
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+	Close();
+}
+
+bool ArchiveWriter::Open(const char* path)
+{
+	m_File = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (m_File == -1) {
+		std::cerr << "Archive: cannot create " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		return false;
+	}
+
+	m_Buffer.reserve(BufferSize + MaxRecordSize);
+	m_Buffer.assign(Magic, Magic + sizeof(Magic));
+
+	return true;
+}
+
+bool ArchiveWriter::Write(const GameRecord& record)
+{
+	const GameRanking& ranking = GameRanking::Get();
+
+	WriteVarint(ZigZag(static_cast<i64>(record.m_Time - m_Time)), m_Buffer);
+	WriteVarint(ZigZag(static_cast<i64>(record.m_GameId - m_GameId)), m_Buffer);
+	m_Time   = record.m_Time;
+	m_GameId = record.m_GameId;
+
+	const u32 moves = record.m_Moves > 9 ? 9 : record.m_Moves;
+
+	u32 kind = KIND_RAW;
+	u32 payload {};
+
+	if (ranking.Winner(record.m_History, moves) == record.m_Winner) {
+		if (ranking.Rank(record.m_History, moves, payload)) {
+			kind = KIND_COMPLETE;
+		}
+		else if (record.m_Winner == Utility::T and
+				 ranking.RankPrefix(record.m_History, moves, payload)) {
+			kind = KIND_PREFIX;
+		}
+	}
+
+	if (kind == KIND_RAW) {
+		payload = static_cast<u32>(record.m_Winner + 1) | moves << 2;
+	}
+
+	const u32 word = kind | (record.m_Mode == MULTI_P ? 1u : 0u) << 2 |
+					 std::min(record.m_EngineDepth, PerfectDepth) << 3 | payload << 7;
+	m_Buffer.push_back(static_cast<unsigned char>(word));
+	m_Buffer.push_back(static_cast<unsigned char>(word >> 8));
+	m_Buffer.push_back(static_cast<unsigned char>(word >> 16));
+	m_Buffer.push_back(static_cast<unsigned char>(word >> 24));
+
+	if (kind == KIND_RAW) {
+		for (u32 i = 0; i < moves; i += 2) {
+			const u32 high = i + 1 < moves ? record.m_History[i + 1] & 0xF : 0;
+			m_Buffer.push_back(static_cast<unsigned char>((record.m_History[i] & 0xF) | high << 4));
+		}
+	}
+
+	++m_Records;
+
+	return m_Buffer.size() < BufferSize or Flush();
+}
+
+bool ArchiveWriter::Close()
+{
+	if (m_File == -1) {
+		return !m_Failed;
+	}
+
+	Flush();
+	close(m_File);
+	m_File = -1;
+
+	return !m_Failed;
+}
+
+u64 ArchiveWriter::Records() const
+{
+	return m_Records;
+}
+
+u64 ArchiveWriter::Bytes() const
+{
+	return m_Bytes + m_Buffer.size();
+}
+
+bool ArchiveWriter::Flush()
+{
+	if (!WriteAll(m_File, m_Buffer.data(), m_Buffer.size(), "Archive")) {
+		m_Failed = true;
+	}
+
+	m_Bytes += m_Buffer.size();
+	m_Buffer.clear();
+
+	return !m_Failed;
+}
+
+ArchiveReader::ArchiveReader() :
+	m_File { -1 },
+	m_Failed { false },
+	m_End { false },
+	m_Offset {},
+	m_Size {},
+	m_Time {},
+	m_GameId {}
+{
+}
+
+ArchiveReader::~ArchiveReader()
+{
+	if (m_File != -1) {
+		close(m_File);
+	}
+}
+
+bool ArchiveReader::Open(const char* path)
+{
+	m_File = open(path, O_RDONLY | O_CLOEXEC);
+	if (m_File == -1) {
+		std::cerr << "Archive: cannot open " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		return false;
+	}
+
+	posix_fadvise(m_File, 0, 0, POSIX_FADV_SEQUENTIAL);
+	m_Buffer.resize(ArchiveWriter::BufferSize);
+
+	if (!Fill() or m_Size < sizeof(Magic) or
+		std::memcmp(m_Buffer.data(), Magic, sizeof(Magic)) != 0) {
+		std::cerr << "Archive: " << path << " is not a game archive" << std::endl;
+		m_Failed = true;
+		return false;
+	}
+
+	m_Offset = sizeof(Magic);
+	return true;
+}
+
+bool ArchiveReader::Next(GameRecord& record)
+{
+	if (m_Failed) {
+		return false;
+	}
+
+	if (m_Size - m_Offset < MaxRecordSize and !m_End and !Fill()) {
+		return false;
+	}
+	if (m_Offset == m_Size) {
+		return false;
+	}
+
+	const unsigned char* data = m_Buffer.data();
+	u64                  time {};
+	u64                  gameId {};
+
+	if (!ReadVarint(data, m_Size, m_Offset, time) or
+		!ReadVarint(data, m_Size, m_Offset, gameId) or m_Size - m_Offset < 4) {
+		m_Failed = true;
+		return false;
+	}
+
+	const u32 word = static_cast<u32>(data[m_Offset]) | data[m_Offset + 1] << 8 |
+					 data[m_Offset + 2] << 16 | static_cast<u32>(data[m_Offset + 3]) << 24;
+	m_Offset += 4;
+
+	m_Time += static_cast<u64>(UnZigZag(time));
+	m_GameId += static_cast<u64>(UnZigZag(gameId));
+
+	record               = GameRecord {};
+	record.m_Time        = m_Time;
+	record.m_GameId      = m_GameId;
+	record.m_Mode        = word & 4 ? MULTI_P : SINGLE_P;
+	record.m_EngineDepth = word >> 3 & 0xF;
+
+	const GameRanking& ranking = GameRanking::Get();
+	const u32          payload = word >> 7;
+
+	switch (word & 3) {
+	case KIND_COMPLETE:
+		record.m_Moves  = ranking.Unrank(payload, record.m_History);
+		record.m_Winner = ranking.Winner(record.m_History, record.m_Moves);
+		break;
+	case KIND_PREFIX:
+		record.m_Moves  = ranking.UnrankPrefix(payload, record.m_History);
+		record.m_Winner = Utility::T;
+		break;
+	case KIND_RAW:
+		record.m_Winner = static_cast<Utility>(static_cast<i32>(payload & 3) - 1);
+		record.m_Moves  = payload >> 2;
+
+		if (record.m_Moves > 9 or m_Size - m_Offset < (record.m_Moves + 1) / 2) {
+			m_Failed = true;
+			return false;
+		}
+
+		for (u32 i = 0; i < record.m_Moves; ++i) {
+			record.m_History[i] = (data[m_Offset + i / 2] >> (i % 2 * 4)) & 0xF;
+		}
+		m_Offset += (record.m_Moves + 1) / 2;
+		break;
+	default:
+		m_Failed = true;
+		return false;
+	}
+
+	return true;
+}
+
+bool ArchiveReader::Failed() const
+{
+	return m_Failed;
+}
+
+// Moves the unread tail to the front and reads until the buffer is full or
+// the file ends.
+bool ArchiveReader::Fill()
+{
+	std::memmove(m_Buffer.data(), m_Buffer.data() + m_Offset, m_Size - m_Offset);
+	m_Size -= m_Offset;
+	m_Offset = 0;
+
+	while (m_Size < m_Buffer.size()) {
+		const ssize_t size = read(m_File, m_Buffer.data() + m_Size, m_Buffer.size() - m_Size);
+		if (size == -1 and errno == EINTR) {
+			continue;
+		}
+		if (size == -1) {
+			std::cerr << "Archive: read failed: " << std::strerror(errno) << std::endl;
+			m_Failed = true;
+			return false;
+		}
+		if (size == 0) {
+			m_End = true;
+			break;
+		}
+		m_Size += static_cast<u64>(size);
+	}
+
+	return true;
+}
+
+i64 PackJournal(const char* journal, const char* archive)
+{
+	ArchiveWriter writer {};
+	if (!writer.Open(archive)) {
+		return -1;
+	}
+
+	const i64 scanned = GameJournal::Scan(journal, [&writer](const GameRecord& record) {
+		writer.Write(record);
+	});
+
+	if (!writer.Close() or scanned == -1) {
+		return -1;
+	}
+
+	return static_cast<i64>(writer.Records());
+}
@@ -0,0 +1,85 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <vector>
+
+#include "journal.h"
+
+
+// Long-term store for GameRecords, about a third of the journal's size.
+// After an 8 byte magic every record is
+//
+//     varint zigzag time delta, varint zigzag game ID delta,
+//     4 byte word: kind (2 bits), mode (1 bit), engine depth (4 bits),
+//                  payload (21 bits)
+//
+// A complete legal game is stored as its GameRanking rank and an unfinished
+// one as its prefix rank, with the winner implied by the moves. Anything
+// else (a record whose moves do not add up to its result) keeps the winner
+// and move count in the payload and its moves in nibbles after the word.
+// Readers and writers stream through a fixed buffer, so archives of any
+// size are scanned at disk speed.
+class ArchiveWriter {
+public:
+	static constexpr u64 BufferSize = 1 << 20;
+
+	ArchiveWriter();
+	~ArchiveWriter();
+
+	ArchiveWriter(const ArchiveWriter&)            = delete;
+	ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+	bool Open(const char* path);
+	bool Write(const GameRecord& record);
+
+	// Flushes the buffer, false if any write failed.
+	bool Close();
+
+	u64 Records() const;
+	u64 Bytes() const;
+
+private:
+	int                        m_File;
+	bool                       m_Failed;
+	std::vector<unsigned char> m_Buffer;
+	u64                        m_Time;
+	u64                        m_GameId;
+	u64                        m_Records;
+	u64                        m_Bytes;
+
+	bool Flush();
+};
+
+class ArchiveReader {
+public:
+	ArchiveReader();
+	~ArchiveReader();
+
+	ArchiveReader(const ArchiveReader&)            = delete;
+	ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+	bool Open(const char* path);
+
+	// False at the end of the archive or at a malformed record, Failed()
+	// tells the two apart.
+	bool Next(GameRecord& record);
+	bool Failed() const;
+
+private:
+	int                        m_File;
+	bool                       m_Failed;
+	bool                       m_End;
+	std::vector<unsigned char> m_Buffer;
+	u64                        m_Offset;
+	u64                        m_Size;
+	u64                        m_Time;
+	u64                        m_GameId;
+
+	bool Fill();
+};
+
+// Streams every intact record of a journal into a new archive. Returns the
+// number of records, -1 on failure.
+i64 PackJournal(const char* journal, const char* archive);
+
+#endif
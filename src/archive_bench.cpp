@@ -0,0 +1,207 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "archive.h"
+#include "game_codec.h"
+
+
+// Plays a random legal game, stopping early with the given chance per move
+// to stand in for abandoned games.
+static GameRecord RandomGame(std::mt19937_64& random, u64 time, u64 gameId)
+{
+	GameRecord record {};
+	record.m_Time        = time;
+	record.m_GameId      = gameId;
+	record.m_Mode        = random() % 2 ? MULTI_P : SINGLE_P;
+	record.m_EngineDepth = random() % (PerfectDepth + 1);
+
+	const GameRanking& ranking = GameRanking::Get();
+	bool               taken[9] {};
+
+	while (record.m_Moves < 9 and ranking.Winner(record.m_History, record.m_Moves) == Utility::T) {
+		if (record.m_Moves > 0 and random() % 20 == 0) {
+			break;
+		}
+
+		u32 cell = random() % 9;
+		while (taken[cell]) {
+			cell = (cell + 1) % 9;
+		}
+		taken[cell]                          = true;
+		record.m_History[record.m_Moves++] = static_cast<unsigned char>(cell);
+	}
+
+	record.m_Winner = ranking.Winner(record.m_History, record.m_Moves);
+	return record;
+}
+
+static bool SameRecord(const GameRecord& a, const GameRecord& b)
+{
+	return a.m_Time == b.m_Time and a.m_GameId == b.m_GameId and a.m_Mode == b.m_Mode and
+		   a.m_EngineDepth == b.m_EngineDepth and a.m_Winner == b.m_Winner and a.m_Moves == b.m_Moves and
+		   std::memcmp(a.m_History, b.m_History, a.m_Moves) == 0;
+}
+
+// Checks that every complete game and every legal prefix survives a rank
+// round trip, times both directions, then packs a journal of random games
+// into an archive and reads it back.
+//
+//     ArchiveBench [records] [path]
+int main(int argc, char* argv[])
+{
+	const u64   records = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+	const char* path    = argc > 2 ? argv[2] : "archive-bench";
+
+	if (records == 0) {
+		std::cerr << "Usage: ArchiveBench [records] [path]" << std::endl;
+		return -1;
+	}
+
+	u64                start   = NowNanoseconds();
+	const GameRanking& ranking = GameRanking::Get();
+	std::cout << "Tables built in " << (NowNanoseconds() - start) / 1'000 << " us" << std::endl;
+
+	unsigned char moves[9] {};
+	u64           checksum {};
+
+	start = NowNanoseconds();
+	for (u32 rank = 0; rank < GameRanking::CompleteGames; ++rank) {
+		checksum += ranking.Unrank(rank, moves);
+	}
+	const u64 unranked = NowNanoseconds() - start;
+
+	std::vector<unsigned char> games(GameRanking::CompleteGames * 9);
+	std::vector<u32>           counts(GameRanking::CompleteGames);
+	for (u32 rank = 0; rank < GameRanking::CompleteGames; ++rank) {
+		counts[rank] = ranking.Unrank(rank, &games[rank * 9]);
+	}
+
+	u32 failures {};
+
+	start = NowNanoseconds();
+	for (u32 rank = 0; rank < GameRanking::CompleteGames; ++rank) {
+		u32 back {};
+		if (!ranking.Rank(&games[rank * 9], counts[rank], back) or back != rank) {
+			++failures;
+		}
+	}
+	const u64 ranked = NowNanoseconds() - start;
+
+	for (u32 rank = 0; rank < GameRanking::LegalSequences; ++rank) {
+		u32       back {};
+		const u32 count = ranking.UnrankPrefix(rank, moves);
+		if (!ranking.RankPrefix(moves, count, back) or back != rank) {
+			++failures;
+		}
+	}
+
+	std::cout << GameRanking::CompleteGames << " games: rank "
+			  << static_cast<double>(ranked) / GameRanking::CompleteGames << " ns, unrank "
+			  << static_cast<double>(unranked) / GameRanking::CompleteGames << " ns ("
+			  << checksum << " moves), " << failures << " round trip failures" << std::endl;
+
+	// Larger boards: random 15x15 games through the general codec.
+	std::mt19937_64            random { 1 };
+	std::vector<unsigned char> encoded {};
+	std::vector<u32>           decoded {};
+	u64                        boardMoves {};
+
+	for (u32 game = 0; game < 1'000; ++game) {
+		std::vector<u32> cells(225);
+		for (u32 i = 0; i < cells.size(); ++i) {
+			cells[i] = i;
+		}
+		std::shuffle(cells.begin(), cells.end(), random);
+		cells.resize(20 + random() % 120);
+		boardMoves += cells.size();
+
+		const u64 offset = encoded.size();
+		EncodeMoveSequence(225, cells.data(), static_cast<u32>(cells.size()), encoded);
+
+		if (DecodeMoveSequence(225, encoded.data() + offset, encoded.size() - offset, decoded) !=
+				encoded.size() - offset or
+			decoded != cells) {
+			++failures;
+		}
+	}
+
+	std::cout << "15x15: " << static_cast<double>(encoded.size()) / static_cast<double>(boardMoves)
+			  << " bytes per move" << std::endl;
+
+	// Journal to archive and back.
+	const std::string journalPath = std::string { path } + ".journal";
+	const std::string archivePath = std::string { path } + ".archive";
+	unlink(journalPath.c_str());
+
+	std::vector<GameRecord> written {};
+	written.reserve(records);
+
+	GameJournal journal {};
+	if (!journal.Open(journalPath.c_str())) {
+		return -1;
+	}
+
+	u64 time = UnixNanoseconds();
+	for (u64 i = 0; i < records; ++i) {
+		time += random() % 2'000'000'000;
+		written.push_back(RandomGame(random, time, i + 1));
+		journal.Append(written.back());
+	}
+
+	journal.Sync();
+	const u64 journalBytes = journal.Stats().m_Bytes;
+	journal.Close();
+
+	start              = NowNanoseconds();
+	const i64 packed   = PackJournal(journalPath.c_str(), archivePath.c_str());
+	const u64 packTime = NowNanoseconds() - start;
+
+	ArchiveReader reader {};
+	GameRecord    record {};
+	u64           read {};
+
+	start = NowNanoseconds();
+	if (reader.Open(archivePath.c_str())) {
+		while (reader.Next(record)) {
+			if (read >= written.size() or !SameRecord(record, written[read])) {
+				++failures;
+			}
+			++read;
+		}
+	}
+	const u64 readTime = NowNanoseconds() - start;
+
+	u64 archiveBytes {};
+	if (FILE* file = std::fopen(archivePath.c_str(), "rb"); file != nullptr) {
+		std::fseek(file, 0, SEEK_END);
+		archiveBytes = static_cast<u64>(std::ftell(file));
+		std::fclose(file);
+	}
+
+	std::cout << "Journal " << journalBytes << " bytes ("
+			  << static_cast<double>(journalBytes) / static_cast<double>(records)
+			  << " per game), archive " << archiveBytes << " bytes ("
+			  << static_cast<double>(archiveBytes) / static_cast<double>(records)
+			  << " per game)\n"
+			  << "Packed " << packed << " in " << packTime / 1'000'000 << " ms, read " << read
+			  << " back in " << readTime / 1'000'000 << " ms ("
+			  << static_cast<double>(read) * 1e9 / static_cast<double>(readTime) << " records/s)"
+			  << std::endl;
+
+	unlink(journalPath.c_str());
+	unlink(archivePath.c_str());
+
+	if (reader.Failed() or read != records or static_cast<u64>(packed) != records) {
+		++failures;
+	}
+
+	return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,64 @@
+#include <cstring>
+#include <iostream>
+
+#include "archive.h"
+
+
+static i64 Unpack(const char* archive, const char* journal)
+{
+	ArchiveReader reader {};
+	if (!reader.Open(archive)) {
+		return -1;
+	}
+
+	GameJournal out {};
+	if (!out.Open(journal)) {
+		return -1;
+	}
+
+	GameRecord record {};
+	i64        records {};
+	while (reader.Next(record)) {
+		out.Append(record);
+		++records;
+	}
+
+	const bool durable = out.Sync();
+	out.Close();
+
+	if (reader.Failed()) {
+		std::cerr << "Archive: " << archive << " is damaged after " << records << " records"
+				  << std::endl;
+		return -1;
+	}
+
+	return durable ? records : -1;
+}
+
+//     TicTacToeArchive pack JOURNAL ARCHIVE
+//     TicTacToeArchive unpack ARCHIVE JOURNAL
+//
+// Converts between the server's game journal and the compact archive format.
+// Unpacking appends to JOURNAL if it already exists.
+int main(int argc, char* argv[])
+{
+	if (argc != 4 or (std::strcmp(argv[1], "pack") != 0 and std::strcmp(argv[1], "unpack") != 0)) {
+		std::cerr << "Usage: TicTacToeArchive pack JOURNAL ARCHIVE\n"
+					 "       TicTacToeArchive unpack ARCHIVE JOURNAL"
+				  << std::endl;
+		return -1;
+	}
+
+	const bool pack    = std::strcmp(argv[1], "pack") == 0;
+	const u64  start   = NowNanoseconds();
+	const i64  records = pack ? PackJournal(argv[2], argv[3]) : Unpack(argv[2], argv[3]);
+
+	if (records == -1) {
+		return -1;
+	}
+
+	std::cout << (pack ? "Packed " : "Unpacked ") << records << " games in "
+			  << (NowNanoseconds() - start) / 1'000'000 << " ms" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "assets.h"
+
+
+// C++ string literal pieces, one per source line.
+static void WriteString(std::ostream& out, const std::string& text)
+{
+	out << "\t\"";
+	for (const char c : text) {
+		switch (c) {
+		case '\n':
+			out << "\\n\"\n\t\"";
+			break;
+		case '\t':
+			out << "\\t";
+			break;
+		case '\r':
+			break;
+		case '"':
+		case '\\':
+			out << '\\' << c;
+			break;
+		default:
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+static std::string Identifier(u32 index, const char* kind)
+{
+	return std::string { kind } + std::to_string(index);
+}
+
+//     TicTacToeAssets OUTPUT FILE...
+//
+// Writes OUTPUT, a C++ source defining the EmbeddedShaders of assets.h, one
+// per FILE, named by file name.
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cerr << "Usage: TicTacToeAssets OUTPUT FILE..." << std::endl;
+		return -1;
+	}
+
+	std::ofstream out { argv[1], std::ios::trunc };
+	if (!out) {
+		std::cerr << "TicTacToeAssets: cannot write " << argv[1] << std::endl;
+		return -1;
+	}
+
+	out << "// Generated by TicTacToeAssets, do not edit.\n\n#include \"assets.h\"\n\n";
+
+	std::vector<std::string> shaders;
+
+	for (int i = 2; i < argc; ++i) {
+		const std::filesystem::path path { argv[i] };
+
+		std::ifstream     file { path, std::ios::binary };
+		const std::string source { std::istreambuf_iterator<char> { file }, {} };
+		if (!file) {
+			std::cerr << "TicTacToeAssets: cannot read " << path << std::endl;
+			return -1;
+		}
+
+		out << "static const char " << Identifier(static_cast<u32>(shaders.size()), "Shader") << "[] =\n";
+		WriteString(out, source);
+		out << ";\n\n";
+
+		shaders.push_back(path.filename().string());
+	}
+
+	out << "const ShaderAsset EmbeddedShaders[] = {\n";
+	for (u32 i = 0; i < shaders.size(); ++i) {
+		out << "\t{ \"" << shaders[i] << "\", { " << Identifier(i, "Shader") << ", sizeof("
+			<< Identifier(i, "Shader") << ") - 1 } },\n";
+	}
+	out << "\t{ \"\", {} }\n};\n\n";
+	out << "const u32 EmbeddedShaderCount = " << shaders.size() << ";\n";
+
+	if (!out.flush()) {
+		std::cerr << "TicTacToeAssets: cannot write " << argv[1] << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,35 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "assets.h"
+
+
+void AssetStore::SetOverride(const char* directory)
+{
+	m_Override = directory;
+}
+
+std::string_view AssetStore::Shader(const char* name)
+{
+	if (!m_Override.empty()) {
+		std::ifstream file { m_Override / name, std::ios::binary | std::ios::ate };
+		if (file) {
+			auto source = std::make_unique<std::string>(static_cast<u64>(file.tellg()), '\0');
+			file.seekg(0);
+			if (file.read(source->data(), static_cast<std::streamsize>(source->size()))) {
+				m_Sources.push_back(std::move(source));
+				return *m_Sources.back();
+			}
+		}
+	}
+
+	for (u32 i = 0; i < EmbeddedShaderCount; ++i) {
+		if (std::strcmp(EmbeddedShaders[i].m_Name, name) == 0) {
+			return EmbeddedShaders[i].m_Source;
+		}
+	}
+
+	std::cout << "Error: No shader called " << name << std::endl;
+	return {};
+}
@@ -0,0 +1,38 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rules.h"
+
+
+struct ShaderAsset {
+	const char*      m_Name;
+	std::string_view m_Source;
+};
+
+// Written by TicTacToeAssets into embedded_assets.cpp at build time.
+extern const ShaderAsset EmbeddedShaders[];
+extern const u32         EmbeddedShaderCount;
+
+// Shaders by file name. They come from the copies compiled into the binary,
+// so starting the game reads no files, unless an override directory is set:
+// files found there replace the embedded ones, for editing shaders without
+// rebuilding.
+class AssetStore {
+public:
+	void SetOverride(const char* directory);
+
+	// Empty when there is no such shader.
+	std::string_view Shader(const char* name);
+
+private:
+	std::filesystem::path                     m_Override;
+	std::vector<std::unique_ptr<std::string>> m_Sources;
+};
+
+#endif
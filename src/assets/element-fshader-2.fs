@@ -2,12 +2,40 @@
 
 out vec4 fragColor;
 
-in vec3 outColor;
-in vec2 texCoord;
+// From the center of the mark in cells, y up.
+in vec2 local;
+flat in uint mark;
+flat in vec4 color;
 
-uniform sampler2D outTexture;
+float Segment(vec2 p, vec2 a, vec2 b)
+{
+	vec2  pa = p - a;
+	vec2  ba = b - a;
+	float h  = clamp(dot(pa, ba) / dot(ba, ba), 0.0, 1.0);
+	return length(pa - ba * h);
+}
 
 void main()
 {
-	fragColor = texture(outTexture, texCoord);
+	float distance;
+
+	if (mark == 1u) {
+		// Both strokes of the X fold onto one.
+		distance = Segment(abs(local), vec2(0.0), vec2(0.389)) - 0.098;
+	}
+	else if (mark == 2u) {
+		distance = abs(length(local) - 0.41) - 0.062;
+	}
+	else {
+		// Row, column, diagonal and antidiagonal win lines.
+		vec2 end = mark == 3u ? vec2(1.35, 0.0)
+				 : mark == 4u ? vec2(0.0, 1.35)
+				 : mark == 5u ? vec2(1.25, -1.25)
+				 :              vec2(1.25, 1.25);
+		distance = Segment(local, -end, end) - 0.05;
+	}
+
+	// Edges a pixel wide at any window size.
+	float pixel = max(fwidth(distance), 1e-5);
+	fragColor = vec4(color.rgb, color.a * clamp(0.5 - distance / pixel, 0.0, 1.0));
 }
@@ -1,18 +1,35 @@
 #version 330 core
 
 layout (location = 0) in vec2 aPos;
-layout (location = 1) in vec3 aColor;
-layout (location = 2) in vec2 aTexCoord;
+layout (location = 1) in vec2 aCell;
+layout (location = 2) in uint aMark;
 
-out vec3 outColor;
-out vec2 texCoord;
+out vec2 local;
+flat out uint mark;
+flat out vec4 color;
 
-uniform float deltaX;
-uniform float deltaY;
+layout (std140) uniform Frame {
+	vec2 cells;
+	vec2 resolution;
+};
+
+// By mark: 1 X, 2 O, 3 every win line.
+layout (std140) uniform Marks {
+	vec4 colors[4];
+};
 
 void main()
 {
-	gl_Position = vec4(aPos.x + 2 * (deltaX - 1) / 3, aPos.y + 2 * (1 - deltaY) / 3, 0.0, 1.0);
-	outColor = aColor;
-	texCoord = aTexCoord;
+	// A win line covers the three cells around its middle one.
+	float span = aMark >= 3u ? 3.0 : 1.0;
+	vec2  size = 2.0 / cells;
+
+	gl_Position = vec4(
+		(aCell.x + 0.5 + aPos.x * span) * size.x - 1.0,
+		1.0 - (aCell.y + 0.5 - aPos.y * span) * size.y,
+		0.0,
+		1.0);
+	local = aPos * span;
+	mark = aMark;
+	color = colors[min(aMark, 3u)];
 }
@@ -2,7 +2,30 @@
 
 out vec4 fragColor;
 
+layout (std140) uniform Frame {
+	vec2 cells;
+	vec2 resolution;
+};
+
+const float lineWidth = 1.0;    // pixels
+
 void main()
 {
-	fragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);
+	vec2 cellSize = resolution / cells;
+	vec2 position = gl_FragCoord.xy / cellSize;
+
+	// Pixels to the nearest line between two cells in each direction. The
+	// outer border is not drawn.
+	vec2 line     = clamp(round(position), vec2(1.0), cells - 1.0);
+	vec2 distance = abs(position - line) * cellSize;
+	if (cells.x < 2.0) {
+		distance.x = lineWidth;
+	}
+	if (cells.y < 2.0) {
+		distance.y = lineWidth;
+	}
+
+	// How much of this pixel the nearest line covers.
+	float coverage = clamp(lineWidth * 0.5 + 0.5 - min(distance.x, distance.y), 0.0, 1.0);
+	fragColor = vec4(1.0, 0.5, 0.2, coverage);
 }
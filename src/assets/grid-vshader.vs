@@ -1,13 +1,9 @@
 #version 330 core
 
-layout (location = 0) in vec3 posA;
-layout (location = 1) in vec3 tempColor;
-
-out vec3 newColor;
-uniform float alpha;
-
+// One triangle covering the whole viewport, made from the vertex index, so
+// the grid needs no vertex buffer and the same three vertices for any size.
 void main()
 {
-	gl_Position = vec4(posA, 1.0);
-	newColor = tempColor;
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
 }
@@ -0,0 +1,340 @@
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <new>
+
+#include "engine_host.h"
+#include "histogram.h"
+
+
+// Not FUTEX_PRIVATE_FLAG: the word is shared with another process.
+static void FutexWait(std::atomic<u32>& word, u32 expected, u64 timeout)
+{
+	timespec relative {};
+	relative.tv_sec  = static_cast<time_t>(timeout / 1'000'000'000);
+	relative.tv_nsec = static_cast<long>(timeout % 1'000'000'000);
+
+	syscall(SYS_futex, reinterpret_cast<u32*>(&word), FUTEX_WAIT, expected, &relative,
+			nullptr, 0);
+}
+
+static void FutexWake(std::atomic<u32>& word)
+{
+	syscall(SYS_futex, reinterpret_cast<u32*>(&word), FUTEX_WAKE, INT_MAX, nullptr,
+			nullptr, 0);
+}
+
+template <typename T, u32 Capacity>
+void SharedRing<T, Capacity>::Reset()
+{
+	m_Head.store(0);
+	m_Tail.store(0);
+}
+
+template <typename T, u32 Capacity>
+bool SharedRing<T, Capacity>::Push(const T& value)
+{
+	const u32 tail = m_Tail.load(std::memory_order_relaxed);
+	if (tail - m_Head.load(std::memory_order_acquire) == Capacity) {
+		return false;
+	}
+
+	m_Cells[tail & (Capacity - 1)] = value;
+	m_Tail.store(tail + 1);
+
+	Wake();
+	return true;
+}
+
+template <typename T, u32 Capacity>
+bool SharedRing<T, Capacity>::Pop(T& value)
+{
+	const u32 head = m_Head.load(std::memory_order_relaxed);
+	if (head == m_Tail.load(std::memory_order_acquire)) {
+		return false;
+	}
+
+	value = m_Cells[head & (Capacity - 1)];
+	m_Head.store(head + 1, std::memory_order_release);
+
+	return true;
+}
+
+template <typename T, u32 Capacity>
+u32 SharedRing<T, Capacity>::Signal() const
+{
+	return m_Signal.load();
+}
+
+template <typename T, u32 Capacity>
+void SharedRing<T, Capacity>::Wake()
+{
+	// The sleeper registers before its last emptiness check and we bump the
+	// signal before looking for sleepers, so one of the two always notices.
+	m_Signal.fetch_add(1);
+	if (m_Sleepers.load() != 0) {
+		FutexWake(m_Signal);
+	}
+}
+
+template <typename T, u32 Capacity>
+void SharedRing<T, Capacity>::Wait(u64 timeout)
+{
+	// With a single core the other side cannot run while we spin.
+	static const u32 spins = std::thread::hardware_concurrency() > 1 ? SpinCount : 0;
+
+	for (u32 i = 0; i < spins; ++i) {
+		if (m_Head.load(std::memory_order_relaxed) != m_Tail.load(std::memory_order_acquire)) {
+			return;
+		}
+	}
+
+	const u32 seen = m_Signal.load();
+
+	m_Sleepers.fetch_add(1);
+	if (m_Head.load() == m_Tail.load()) {
+		FutexWait(m_Signal, seen, timeout);
+	}
+	m_Sleepers.fetch_sub(1);
+}
+
+template <typename T, u32 Capacity>
+void SharedRing<T, Capacity>::WaitForSignal(u32 seen, u64 timeout)
+{
+	m_Sleepers.fetch_add(1);
+	if (m_Signal.load() == seen) {
+		FutexWait(m_Signal, seen, timeout);
+	}
+	m_Sleepers.fetch_sub(1);
+}
+
+EngineHost::EngineHost() :
+	m_Shared { nullptr },
+	m_Engine { -1 },
+	m_NextId { 1 },
+	m_Restarts {},
+	m_Notify { nullptr },
+	m_Waiting { false },
+	m_Running { false }
+{
+}
+
+EngineHost::~EngineHost()
+{
+	Stop();
+}
+
+bool EngineHost::Start(Notify notify)
+{
+	void* memory = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		std::cerr << "EngineHost: mmap failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	m_Shared = new (memory) Shared {};
+
+	if (!Spawn()) {
+		munmap(m_Shared, sizeof(Shared));
+		m_Shared = nullptr;
+		return false;
+	}
+
+	m_Notify  = notify;
+	m_Running = true;
+	if (m_Notify != nullptr) {
+		m_Notifier = std::thread { &EngineHost::RunNotifier, this };
+	}
+
+	return true;
+}
+
+void EngineHost::Stop()
+{
+	if (m_Shared == nullptr) {
+		return;
+	}
+
+	m_Running = false;
+	m_Shared->m_Replies.Wake();
+	if (m_Notifier.joinable()) {
+		m_Notifier.join();
+	}
+
+	if (m_Engine != -1) {
+		kill(m_Engine, SIGKILL);
+		waitpid(m_Engine, nullptr, 0);
+		m_Engine = -1;
+	}
+
+	munmap(m_Shared, sizeof(Shared));
+	m_Shared = nullptr;
+}
+
+u64 EngineHost::Request(const i32 board[3][3], i32 mark, u32 depth)
+{
+	EngineRequest request {};
+	request.m_Id    = m_NextId;
+	request.m_Mark  = mark;
+	request.m_Depth = depth;
+	std::memcpy(request.m_Cells, board, sizeof(request.m_Cells));
+
+	if (!m_Shared->m_Requests.Push(request)) {
+		return 0;
+	}
+
+	m_Outstanding.push_back(request);
+	m_Waiting = true;
+
+	return m_NextId++;
+}
+
+bool EngineHost::Poll(EngineReply& reply)
+{
+	while (m_Shared->m_Replies.Pop(reply)) {
+		const auto request =
+			std::find_if(m_Outstanding.begin(), m_Outstanding.end(),
+						 [&reply](const EngineRequest& r) { return r.m_Id == reply.m_Id; });
+
+		// A reply to a request resent after a restart can arrive twice.
+		if (request == m_Outstanding.end()) {
+			continue;
+		}
+
+		m_Outstanding.erase(request);
+		m_Waiting = !m_Outstanding.empty();
+		return true;
+	}
+
+	if (!m_Outstanding.empty()) {
+		Recover();
+	}
+
+	return false;
+}
+
+bool EngineHost::Wait(EngineReply& reply, u64 timeout)
+{
+	const u64 deadline = NowNanoseconds() + timeout;
+
+	while (!Poll(reply)) {
+		const u64 now = NowNanoseconds();
+		if (now >= deadline) {
+			return false;
+		}
+		m_Shared->m_Replies.Wait(std::min(deadline - now, CheckInterval));
+	}
+
+	return true;
+}
+
+u64 EngineHost::Restarts() const
+{
+	return m_Restarts;
+}
+
+bool EngineHost::Spawn()
+{
+	const pid_t parent = getpid();
+
+	const pid_t pid = fork();
+	if (pid == -1) {
+		std::cerr << "EngineHost: fork failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	if (pid == 0) {
+		prctl(PR_SET_PDEATHSIG, SIGKILL);
+		if (getppid() != parent) {
+			_exit(0);
+		}
+		signal(SIGTERM, SIG_DFL);
+		signal(SIGINT, SIG_IGN);
+
+		Serve(*m_Shared);
+		_exit(0);
+	}
+
+	m_Engine = pid;
+	return true;
+}
+
+void EngineHost::Recover()
+{
+	int status {};
+	if (waitpid(m_Engine, &status, WNOHANG) != m_Engine) {
+		return;
+	}
+
+	std::cerr << "EngineHost: engine process died, restarting" << std::endl;
+	++m_Restarts;
+	m_Engine = -1;
+
+	// Nobody else touches the rings while the engine is down, so start them
+	// over and queue everything still unanswered.
+	m_Shared->m_Requests.Reset();
+	m_Shared->m_Replies.Reset();
+
+	if (!Spawn()) {
+		return;
+	}
+
+	for (const EngineRequest& request : m_Outstanding) {
+		m_Shared->m_Requests.Push(request);
+	}
+}
+
+void EngineHost::RunNotifier()
+{
+	u32 seen = m_Shared->m_Replies.Signal();
+
+	while (m_Running) {
+		m_Shared->m_Replies.WaitForSignal(seen, CheckInterval);
+		if (!m_Running) {
+			return;
+		}
+
+		// Ticks with requests outstanding too, so a dead engine gets noticed.
+		const u32 signal = m_Shared->m_Replies.Signal();
+		if (signal != seen or m_Waiting) {
+			m_Notify();
+		}
+		seen = signal;
+	}
+}
+
+void EngineHost::Serve(Shared& shared)
+{
+	EngineRequest request {};
+
+	while (true) {
+		if (!shared.m_Requests.Pop(request)) {
+			shared.m_Requests.Wait(CheckInterval);
+			continue;
+		}
+
+		const auto move = FindBestMove(request.m_Cells, request.m_Mark, request.m_Depth);
+
+		EngineReply reply {};
+		reply.m_Id  = request.m_Id;
+		reply.m_Row = move.first;
+		reply.m_Col = move.second;
+
+		while (!shared.m_Replies.Push(reply)) {
+			sched_yield();
+		}
+	}
+}
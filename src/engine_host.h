@@ -0,0 +1,114 @@
+#ifndef ENGINE_HOST_H
+#define ENGINE_HOST_H
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "rules.h"
+
+
+struct EngineRequest {
+	u64 m_Id {};
+	i32 m_Cells[3][3] {};
+	i32 m_Mark {};
+	u32 m_Depth {};
+};
+
+struct EngineReply {
+	u64 m_Id {};
+	i32 m_Row { -1 };
+	i32 m_Col { -1 };
+};
+
+// Single-producer single-consumer ring that lives in memory shared between
+// two processes. Each side only writes its own index, and the consumer sleeps
+// on a futex once a short spin finds the ring empty, so the producer only
+// pays for a syscall when the other side is actually asleep.
+template <typename T, u32 Capacity>
+class SharedRing {
+public:
+	static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+	static_assert(std::atomic<u32>::is_always_lock_free);
+
+	void Reset();
+	bool Push(const T& value);
+	bool Pop(T& value);
+
+	// Bumped on every push, so a waiter can sleep until it moves past a value
+	// it has seen. Wake() bumps it without pushing.
+	u32  Signal() const;
+	void Wake();
+
+	// Returns once the ring is not empty or timeout ns have passed.
+	void Wait(u64 timeout);
+	void WaitForSignal(u32 seen, u64 timeout);
+
+private:
+	static constexpr u32 SpinCount = 2000;    // only with more than one core
+
+	alignas(64) std::atomic<u32> m_Head;
+	alignas(64) std::atomic<u32> m_Tail;
+	alignas(64) std::atomic<u32> m_Signal;
+	std::atomic<u32> m_Sleepers;
+	alignas(64) T m_Cells[Capacity];
+};
+
+// Runs the engine in a separate process so a crash or a deep search never
+// stalls the window. Requests and replies travel through two SharedRings in
+// an anonymous shared mapping, and a crashed engine is forked again with the
+// outstanding requests sent once more.
+class EngineHost {
+public:
+	using Notify = void (*)();
+
+	static constexpr u32 RingSize      = 64;
+	static constexpr u64 CheckInterval = 50'000'000;
+
+	EngineHost();
+	~EngineHost();
+
+	EngineHost(const EngineHost&)            = delete;
+	EngineHost& operator=(const EngineHost&) = delete;
+
+	// notify runs on a helper thread whenever a reply arrives, or the engine
+	// needs restarting, so an event loop blocked elsewhere can call Poll().
+	bool Start(Notify notify = nullptr);
+	void Stop();
+
+	// Queues a search and returns its ID, 0 when the ring is full.
+	u64 Request(const i32 board[3][3], i32 mark, u32 depth);
+
+	// Non-blocking. Only returns replies to requests still outstanding.
+	bool Poll(EngineReply& reply);
+	bool Wait(EngineReply& reply, u64 timeout);
+
+	u64 Restarts() const;
+
+private:
+	struct Shared {
+		SharedRing<EngineRequest, RingSize> m_Requests;
+		SharedRing<EngineReply, RingSize>   m_Replies;
+	};
+
+	Shared* m_Shared;
+	pid_t   m_Engine;
+	u64     m_NextId;
+	u64     m_Restarts;
+	Notify  m_Notify;
+
+	std::vector<EngineRequest> m_Outstanding;
+	std::atomic<bool>          m_Waiting;
+	std::atomic<bool>          m_Running;
+	std::thread                m_Notifier;
+
+	bool Spawn();
+	void Recover();
+	void RunNotifier();
+
+	static void Serve(Shared& shared);
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include "engine_host.h"
+#include "histogram.h"
+
+
+// Round trip through the engine process: one request in flight at a time,
+// compared with running the same search in-process, so the difference is
+// the cost of the shared-memory transport.
+//
+//     EngineHostBench [requests] [depth]
+int main(int argc, char* argv[])
+{
+	const u64 requests = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+	const u32 depth    = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1;
+
+	if (requests == 0) {
+		std::cerr << "Usage: EngineHostBench [requests] [depth]" << std::endl;
+		return -1;
+	}
+
+	EngineHost engine {};
+	if (!engine.Start()) {
+		return -1;
+	}
+
+	std::mt19937_64  random { 1 };
+	LatencyHistogram local {};
+	LatencyHistogram remote {};
+
+	for (u64 i = 0; i < requests; ++i) {
+		Board board {};
+		for (u32 move = 0; move < 4; ++move) {
+			u32 cell = random() % 9;
+			while (board.m_Cells[cell / 3][cell % 3] != 0) {
+				cell = (cell + 1) % 9;
+			}
+			board.Play(cell / 3, cell % 3);
+		}
+
+		const u64 searchStart = NowNanoseconds();
+		const auto move       = FindBestMove(board.m_Cells, 1, depth);
+		local.Record(NowNanoseconds() - searchStart);
+
+		const u64 start = NowNanoseconds();
+
+		EngineReply reply {};
+		if (engine.Request(board.m_Cells, 1, depth) == 0 or
+			!engine.Wait(reply, 1'000'000'000)) {
+			std::cerr << "No reply to request " << i << std::endl;
+			return -1;
+		}
+		remote.Record(NowNanoseconds() - start);
+
+		if (reply.m_Row != move.first or reply.m_Col != move.second) {
+			std::cerr << "Engine process disagrees on request " << i << std::endl;
+			return -1;
+		}
+	}
+
+	std::cout << "Requests: " << requests << " at depth " << depth << std::endl;
+	local.Print(std::cout, "in-process");
+	remote.Print(std::cout, "round trip");
+
+	return 0;
+}
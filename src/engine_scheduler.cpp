@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "engine_scheduler.h"
+
+
+namespace {
+
+	bool LaterDeadline(
+		const EngineScheduler::SearchAwaiter* a,
+		const EngineScheduler::SearchAwaiter* b)
+	{
+		return a->m_Deadline > b->m_Deadline;
+	}
+
+}    // namespace
+
+EngineScheduler::EngineScheduler(Scheduler& scheduler, u32 threads) :
+	m_Scheduler { scheduler },
+	m_Stopping { false },
+	m_QueuedNodes {},
+	m_NanosPerNode { 100.0 }
+{
+	// Solve the table up front rather than on the first overloaded request,
+	// and time a small search so admission starts from a measured node cost.
+	PerfectTable::Get();
+
+	const i32       empty[3][3] {};
+	ResumableSearch probe {};
+	probe.Start(empty, 1, 5);
+
+	const u64 start = NowNanoseconds();
+	probe.Step(std::numeric_limits<u64>::max());
+	if (probe.Nodes() > 0) {
+		m_NanosPerNode = static_cast<double>(NowNanoseconds() - start)
+					   / static_cast<double>(probe.Nodes());
+	}
+
+	for (u32 i = 0; i < (threads == 0 ? 1 : threads); ++i) {
+		m_Threads.emplace_back(&EngineScheduler::Work, this);
+	}
+}
+
+EngineScheduler::~EngineScheduler()
+{
+	{
+		std::lock_guard lock { m_Mutex };
+		m_Stopping = true;
+	}
+	m_Signal.notify_all();
+
+	for (auto& thread : m_Threads) {
+		thread.join();
+	}
+}
+
+EngineScheduler::SearchAwaiter EngineScheduler::Search(
+	const i32 cells[3][3],
+	i32       mark,
+	u32       depth,
+	u32       tenant,
+	u64       deadline)
+{
+	SearchAwaiter awaiter {};
+	awaiter.m_Engine   = this;
+	awaiter.m_Mark     = mark;
+	awaiter.m_Depth    = depth;
+	awaiter.m_Tenant   = tenant;
+	awaiter.m_Deadline = deadline;
+	awaiter.m_Level    = LEVEL_FULL;
+	awaiter.m_Move     = { -1, -1 };
+	std::memcpy(awaiter.m_Cells, cells, sizeof(awaiter.m_Cells));
+
+	return awaiter;
+}
+
+bool EngineScheduler::SearchAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	m_Handle    = handle;
+	m_Submitted = NowNanoseconds();
+
+	EngineScheduler& engine = *m_Engine;
+	Level            level {};
+
+	{
+		std::lock_guard lock { engine.m_Mutex };
+
+		level = m_Level = engine.Admit(*this, m_Submitted);
+
+		if (m_Level == LEVEL_TABLE) {
+			++engine.m_Metrics.m_TableLookups;
+			++engine.m_Metrics.m_Completed;
+		}
+		else {
+			m_Search.Start(m_Cells, m_Mark, m_Depth);
+			engine.m_Metrics.m_Reduced += m_Level == LEVEL_REDUCED ? 1 : 0;
+			engine.Push(this);
+		}
+	}
+
+	if (level == LEVEL_TABLE) {
+		// Answered on the spot, the coroutine carries on without suspending.
+		m_Move = PerfectTable::Get().BestMove(m_Cells, m_Mark);
+
+		std::lock_guard lock { engine.m_Mutex };
+		engine.m_Metrics.m_Latency.Record(NowNanoseconds() - m_Submitted);
+		return false;
+	}
+
+	engine.m_Signal.notify_one();
+	return true;
+}
+
+EngineMetrics EngineScheduler::Metrics() const
+{
+	std::lock_guard lock { m_Mutex };
+	return m_Metrics;
+}
+
+EngineScheduler::Level EngineScheduler::Admit(SearchAwaiter& job, u64 now) const
+{
+	// Work ahead of this job is shared by all workers; its own search runs on
+	// one of them.
+	const double workers = static_cast<double>(m_Threads.size());
+	const double wait    = static_cast<double>(m_QueuedNodes) * m_NanosPerNode / workers;
+
+	// Depth 0 only looks one move ahead and is always cheap.
+	if (job.m_Depth == 0) {
+		job.m_Estimate = EstimateNodes(job.m_Cells, 1);
+		return LEVEL_FULL;
+	}
+
+	// The deepest search that still fits, down to one ply.
+	for (u32 depth = job.m_Depth; depth > 0; --depth) {
+		job.m_Estimate = EstimateNodes(job.m_Cells, depth);
+
+		const double finish = static_cast<double>(now) + wait
+							+ static_cast<double>(job.m_Estimate) * m_NanosPerNode;
+		if (finish <= static_cast<double>(job.m_Deadline)) {
+			const Level level = depth == job.m_Depth ? LEVEL_FULL : LEVEL_REDUCED;
+			job.m_Depth       = depth;
+			return level;
+		}
+	}
+
+	return LEVEL_TABLE;
+}
+
+void EngineScheduler::Push(SearchAwaiter* job)
+{
+	Tenant& tenant = m_Tenants[job->m_Tenant];
+
+	// A tenant coming back from idle starts level with the least served
+	// active tenant instead of spending credit it banked while away.
+	if (tenant.m_Jobs.empty()) {
+		u64 least = std::numeric_limits<u64>::max();
+		for (const auto& [id, other] : m_Tenants) {
+			if (!other.m_Jobs.empty()) {
+				least = std::min(least, other.m_Used);
+			}
+		}
+		if (least != std::numeric_limits<u64>::max()) {
+			tenant.m_Used = std::max(tenant.m_Used, least);
+		}
+	}
+
+	tenant.m_Jobs.push_back(job);
+	std::push_heap(tenant.m_Jobs.begin(), tenant.m_Jobs.end(), LaterDeadline);
+
+	m_QueuedNodes += job->m_Estimate;
+	++m_Metrics.m_QueueDepth;
+	m_Metrics.m_MaxQueueDepth =
+		std::max(m_Metrics.m_MaxQueueDepth, m_Metrics.m_QueueDepth);
+}
+
+EngineScheduler::SearchAwaiter* EngineScheduler::Pick()
+{
+	u64 least = std::numeric_limits<u64>::max();
+	for (const auto& [id, tenant] : m_Tenants) {
+		if (!tenant.m_Jobs.empty()) {
+			least = std::min(least, tenant.m_Used);
+		}
+	}
+
+	// Earliest deadline first, among tenants that are not too far ahead.
+	Tenant* chosen {};
+	for (auto& [id, tenant] : m_Tenants) {
+		if (tenant.m_Jobs.empty() or tenant.m_Used > least + FairnessSlack) {
+			continue;
+		}
+		if (!chosen or tenant.m_Jobs.front()->m_Deadline < chosen->m_Jobs.front()->m_Deadline) {
+			chosen = &tenant;
+		}
+	}
+
+	if (!chosen) {
+		return nullptr;
+	}
+
+	std::pop_heap(chosen->m_Jobs.begin(), chosen->m_Jobs.end(), LaterDeadline);
+	SearchAwaiter* job = chosen->m_Jobs.back();
+	chosen->m_Jobs.pop_back();
+
+	m_QueuedNodes -= std::min(m_QueuedNodes, job->m_Estimate);
+	--m_Metrics.m_QueueDepth;
+
+	return job;
+}
+
+void EngineScheduler::Finish(SearchAwaiter* job)
+{
+	const u64 now = NowNanoseconds();
+
+	{
+		std::lock_guard lock { m_Mutex };
+		++m_Metrics.m_Completed;
+		m_Metrics.m_DeadlineMisses += now > job->m_Deadline ? 1 : 0;
+		m_Metrics.m_Latency.Record(now - job->m_Submitted);
+	}
+
+	m_Scheduler.Post(&Scheduler::ResumeHandle, job->m_Handle.address(), 0);
+}
+
+void EngineScheduler::Work()
+{
+	while (true) {
+		SearchAwaiter* job {};
+
+		{
+			std::unique_lock lock { m_Mutex };
+			m_Signal.wait(lock, [this]() {
+				return m_Stopping or m_Metrics.m_QueueDepth > 0;
+			});
+
+			if (m_Stopping) {
+				return;
+			}
+
+			job = Pick();
+		}
+
+		// Too late to search: answer from the table so the game never stalls
+		// past its deadline by more than one slice.
+		if (NowNanoseconds() > job->m_Deadline) {
+			job->m_Move = PerfectTable::Get().BestMove(job->m_Cells, job->m_Mark);
+			{
+				std::lock_guard lock { m_Mutex };
+				++m_Metrics.m_TableLookups;
+			}
+			Finish(job);
+			continue;
+		}
+
+		const u64  before   = job->m_Search.Nodes();
+		const u64  start    = NowNanoseconds();
+		const bool finished = job->m_Search.Step(SliceNodes);
+		const u64  elapsed  = NowNanoseconds() - start;
+		const u64  nodes    = job->m_Search.Nodes() - before;
+
+		{
+			std::lock_guard lock { m_Mutex };
+
+			++m_Metrics.m_Slices;
+			m_Tenants[job->m_Tenant].m_Used += nodes;
+
+			if (nodes > 0) {
+				const double sample = static_cast<double>(elapsed) / static_cast<double>(nodes);
+				m_NanosPerNode      = m_NanosPerNode * 0.9 + sample * 0.1;
+			}
+
+			if (!finished) {
+				job->m_Estimate = job->m_Estimate > nodes ? job->m_Estimate - nodes : SliceNodes;
+				Push(job);
+			}
+		}
+
+		if (!finished) {
+			m_Signal.notify_one();
+			continue;
+		}
+
+		job->m_Move = job->m_Search.Result();
+		Finish(job);
+	}
+}
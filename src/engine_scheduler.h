@@ -0,0 +1,109 @@
+#ifndef ENGINE_SCHEDULER_H
+#define ENGINE_SCHEDULER_H
+
+#include <condition_variable>
+#include <coroutine>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "histogram.h"
+#include "runtime.h"
+#include "search.h"
+
+
+struct EngineMetrics {
+	u64 m_QueueDepth {};
+	u64 m_MaxQueueDepth {};
+	u64 m_Completed {};
+	u64 m_DeadlineMisses {};
+	u64 m_Reduced {};
+	u64 m_TableLookups {};
+	u64 m_Slices {};
+
+	LatencyHistogram m_Latency;    // submission to result
+};
+
+// Runs engine searches for many sessions on a few worker threads.
+//
+// Jobs carry a deadline and a tenant. Workers always take the earliest
+// deadline among tenants that are within FairnessSlack nodes of the least
+// served tenant, run it for one slice and put it back if unfinished, so a
+// deep search cannot hold a worker hostage. Admission control estimates the
+// queue's work against the deadline and degrades a job to a shallower search
+// or to a PerfectTable lookup when it could not finish in time.
+class EngineScheduler {
+public:
+	static constexpr u64 SliceNodes    = 20'000;
+	static constexpr u64 FairnessSlack = 4 * SliceNodes;
+
+	enum Level {
+		LEVEL_FULL,
+		LEVEL_REDUCED,
+		LEVEL_TABLE
+	};
+
+	EngineScheduler(Scheduler& scheduler, u32 threads);
+	~EngineScheduler();
+
+	EngineScheduler(const EngineScheduler&)            = delete;
+	EngineScheduler& operator=(const EngineScheduler&) = delete;
+
+	struct SearchAwaiter {
+		EngineScheduler*        m_Engine;
+		i32                     m_Cells[3][3];
+		i32                     m_Mark;
+		u32                     m_Depth;    // lowered by admission control
+		u32                     m_Tenant;
+		u64                     m_Deadline;
+		u64                     m_Submitted;
+		u64                     m_Estimate;
+		Level                   m_Level;
+		ResumableSearch         m_Search;
+		std::pair<i32, i32>     m_Move;
+		std::coroutine_handle<> m_Handle;
+
+		bool await_ready() noexcept
+		{
+			return false;
+		}
+		bool                await_suspend(std::coroutine_handle<> handle);
+		std::pair<i32, i32> await_resume() noexcept
+		{
+			return m_Move;
+		}
+	};
+
+	SearchAwaiter
+		Search(const i32 cells[3][3], i32 mark, u32 depth, u32 tenant, u64 deadline);
+
+	EngineMetrics Metrics() const;
+
+private:
+	struct Tenant {
+		std::vector<SearchAwaiter*> m_Jobs;    // min-heap on deadline
+		u64                         m_Used {};
+	};
+
+	Scheduler&              m_Scheduler;
+	mutable std::mutex      m_Mutex;
+	std::condition_variable m_Signal;
+	bool                    m_Stopping;
+
+	std::unordered_map<u32, Tenant> m_Tenants;
+	u64                             m_QueuedNodes;
+	double                          m_NanosPerNode;
+	EngineMetrics                   m_Metrics;
+
+	std::vector<std::thread> m_Threads;
+
+	Level          Admit(SearchAwaiter& job, u64 now) const;
+	void           Push(SearchAwaiter* job);
+	SearchAwaiter* Pick();
+	void           Finish(SearchAwaiter* job);
+	void           Work();
+};
+
+#endif
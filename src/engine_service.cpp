@@ -0,0 +1,491 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "engine_service.h"
+#include "net.h"
+#include "search.h"
+
+
+EngineService::EngineService(u32 threads, u64 window) :
+	m_Listener { -1 },
+	m_Window { window },
+	m_OwnCache(CacheEntries),
+	m_Cache { m_OwnCache.data() },
+	m_Filling { std::make_unique<Batch>() },
+	m_Timer {},
+	m_Stopping { false }
+{
+	// Solve the table before the first batch needs it.
+	PerfectTable::Get();
+
+	m_Scheduler.SetWritableCallback(&EngineService::OnWritable, this);
+
+	for (u32 i = 0; i < (threads == 0 ? 1 : threads); ++i) {
+		m_Workers.emplace_back(&EngineService::RunWorker, this);
+	}
+}
+
+EngineService::~EngineService()
+{
+	{
+		std::lock_guard lock { m_Mutex };
+		m_Stopping = true;
+	}
+	m_Signal.notify_all();
+
+	for (auto& worker : m_Workers) {
+		worker.join();
+	}
+
+	for (u64 fd = 0; fd < m_Clients.size(); ++fd) {
+		if (m_Clients[fd].m_Open) {
+			close(static_cast<int>(fd));
+		}
+	}
+
+	if (m_Listener != -1) {
+		close(m_Listener);
+	}
+}
+
+bool EngineService::Listen(const char* name)
+{
+	m_Listener = ListenLocal(name);
+	if (m_Listener == -1) {
+		return false;
+	}
+
+	return m_Scheduler.Watch(m_Listener);
+}
+
+bool EngineService::EnableSnapshot(const char* path)
+{
+	const SnapshotSection cache { SNAPSHOT_ENGINE_CACHE, 1, sizeof(CacheEntry), CacheEntries };
+
+	if (!m_Snapshot.Open(path, { cache })) {
+		return false;
+	}
+
+	m_Cache = m_Snapshot.Section<CacheEntry>(SNAPSHOT_ENGINE_CACHE);
+	m_OwnCache.clear();
+	m_OwnCache.shrink_to_fit();
+
+	return true;
+}
+
+void EngineService::Run()
+{
+	m_Scheduler.Spawn(AcceptClients());
+	m_Scheduler.Run();
+}
+
+void EngineService::Stop()
+{
+	m_Scheduler.Stop();
+}
+
+const EngineServiceStats& EngineService::Stats() const
+{
+	return m_Stats;
+}
+
+Task EngineService::AcceptClients()
+{
+	while (true) {
+		co_await m_Scheduler.Readable(m_Listener);
+
+		while (true) {
+			const int fd =
+				accept4(m_Listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd == -1) {
+				if (errno == EINTR or errno == ECONNABORTED) {
+					continue;
+				}
+				break;
+			}
+
+			if (static_cast<u64>(fd) >= m_Clients.size()) {
+				m_Clients.resize(static_cast<u64>(fd) * 2 + 1);
+			}
+
+			if (!m_Scheduler.Watch(fd)) {
+				close(fd);
+				continue;
+			}
+
+			Client&   client     = m_Clients[fd];
+			const u32 generation = client.m_Generation + 1;
+
+			client              = Client {};
+			client.m_Open       = true;
+			client.m_Generation = generation;
+
+			m_Scheduler.Spawn(ServeClient(fd, generation));
+		}
+	}
+}
+
+Task EngineService::ServeClient(int fd, u32 generation)
+{
+	EngineRequest requests[MaxMessage];
+
+	while (m_Clients[fd].m_Open and m_Clients[fd].m_Generation == generation) {
+		co_await m_Scheduler.Readable(fd);
+
+		while (m_Clients[fd].m_Open and m_Clients[fd].m_Generation == generation) {
+			const ssize_t size = recv(fd, requests, sizeof(requests), MSG_TRUNC);
+			if (size == -1 and errno == EINTR) {
+				continue;
+			}
+			if (size == -1 and errno == EAGAIN) {
+				break;
+			}
+			if (size <= 0 or static_cast<u64>(size) > sizeof(requests) or
+				size % sizeof(EngineRequest) != 0) {
+				Close(fd);
+				break;
+			}
+
+			for (u64 i = 0; i < size / sizeof(EngineRequest); ++i) {
+				Submit(fd, requests[i]);
+			}
+		}
+
+		// Cache hits and rejected requests are answered without a batch.
+		FlushTouched();
+	}
+}
+
+void EngineService::Submit(int fd, const EngineRequest& request)
+{
+	++m_Stats.m_Requests;
+
+	const Waiter waiter { fd, m_Clients[fd].m_Generation, request.m_Id, NowNanoseconds() };
+
+	const u64 key = Key(request);
+	if (key == 0) {
+		Answer(waiter, -1, -1);
+		return;
+	}
+
+	if (const CacheEntry& entry = m_Cache[CacheSlot(key)]; entry.m_Key == key) {
+		++m_Stats.m_CacheHits;
+		Answer(waiter, entry.m_Row, entry.m_Col);
+		return;
+	}
+
+	auto [waiting, inserted] = m_InFlight.try_emplace(key);
+	waiting->second.push_back(waiter);
+
+	if (!inserted) {
+		++m_Stats.m_Deduplicated;
+		return;
+	}
+
+	EngineRequest position = request;
+	position.m_Id          = key;
+	m_Filling->m_Requests.push_back(position);
+
+	if (m_Filling->m_Requests.size() >= BatchSize) {
+		Dispatch();
+	}
+	else if (m_Filling->m_Requests.size() == 1) {
+		m_Timer = m_Scheduler.AddTimer(
+			NowNanoseconds() + m_Window, &EngineService::OnWindow, this);
+	}
+}
+
+void EngineService::Answer(const Waiter& waiter, i32 row, i32 col)
+{
+	Client& client = m_Clients[waiter.m_Fd];
+	if (!client.m_Open or client.m_Generation != waiter.m_Generation) {
+		return;
+	}
+
+	client.m_Output.push_back(EngineReply { waiter.m_Id, row, col });
+	m_Stats.m_Latency.Record(NowNanoseconds() - waiter.m_Received);
+
+	if (!client.m_Queued) {
+		client.m_Queued = true;
+		m_Touched.push_back(waiter.m_Fd);
+	}
+}
+
+void EngineService::Dispatch()
+{
+	if (m_Timer != 0) {
+		m_Scheduler.CancelTimer(m_Timer);
+		m_Timer = 0;
+	}
+
+	if (m_Filling->m_Requests.empty()) {
+		return;
+	}
+
+	++m_Stats.m_Batches;
+
+	{
+		std::lock_guard lock { m_Mutex };
+		m_Queue.push_back(std::move(m_Filling));
+	}
+	m_Signal.notify_one();
+
+	m_Filling = std::make_unique<Batch>();
+}
+
+void EngineService::Finish(std::unique_ptr<Batch> batch)
+{
+	for (u64 i = 0; i < batch->m_Requests.size(); ++i) {
+		const u64          key   = batch->m_Requests[i].m_Id;
+		const EngineReply& reply = batch->m_Replies[i];
+
+		// The key goes last, so an entry torn by a crash reads as empty to
+		// the next process rather than as a wrong answer.
+		CacheEntry& entry = m_Cache[CacheSlot(key)];
+		std::atomic_ref { entry.m_Key }.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		entry.m_Row = reply.m_Row;
+		entry.m_Col = reply.m_Col;
+		std::atomic_ref { entry.m_Key }.store(key, std::memory_order_release);
+		++m_Stats.m_Evaluated;
+
+		const auto waiting = m_InFlight.find(key);
+		if (waiting == m_InFlight.end()) {
+			continue;
+		}
+
+		for (const Waiter& waiter : waiting->second) {
+			Answer(waiter, reply.m_Row, reply.m_Col);
+		}
+		m_InFlight.erase(waiting);
+	}
+}
+
+void EngineService::Flush(int fd)
+{
+	Client& client = m_Clients[fd];
+	u64     sent {};
+
+	while (sent < client.m_Output.size()) {
+		const u64 count =
+			std::min<u64>(client.m_Output.size() - sent, MaxMessage);
+
+		const ssize_t size = send(fd, client.m_Output.data() + sent,
+								  count * sizeof(EngineReply), MSG_NOSIGNAL);
+		if (size == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN) {
+				Close(fd);
+				return;
+			}
+			// OnWritable sends the rest once the client catches up.
+			break;
+		}
+
+		sent += count;
+	}
+
+	client.m_Output.erase(client.m_Output.begin(), client.m_Output.begin() + sent);
+}
+
+void EngineService::FlushTouched()
+{
+	for (const int fd : m_Touched) {
+		m_Clients[fd].m_Queued = false;
+		if (m_Clients[fd].m_Open) {
+			Flush(fd);
+		}
+	}
+	m_Touched.clear();
+}
+
+void EngineService::Close(int fd)
+{
+	Client& client = m_Clients[fd];
+	if (!client.m_Open) {
+		return;
+	}
+
+	m_Scheduler.Unwatch(fd);
+	close(fd);
+
+	// Searches it is waiting on still finish and fill the cache, their
+	// answers are dropped by the generation check.
+	const u32 generation = client.m_Generation;
+	const bool queued    = client.m_Queued;
+	client               = Client {};
+	client.m_Generation  = generation;
+	client.m_Queued      = queued;
+}
+
+void EngineService::RunWorker()
+{
+	while (true) {
+		std::unique_ptr<Batch> batch {};
+
+		{
+			std::unique_lock lock { m_Mutex };
+			m_Signal.wait(lock, [this]() { return m_Stopping or !m_Queue.empty(); });
+
+			if (m_Stopping) {
+				return;
+			}
+
+			batch = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+
+		Evaluate(*batch);
+		m_Scheduler.Post(
+			&EngineService::OnBatch, this, reinterpret_cast<u64>(batch.release()));
+	}
+}
+
+// Nonzero key for a valid request. A search at least as deep as the number
+// of empty cells sees the whole game, so such depths share one key.
+u64 EngineService::Key(const EngineRequest& request)
+{
+	if (request.m_Mark != 1 and request.m_Mark != 2) {
+		return 0;
+	}
+
+	u64 index {};
+	u32 empty {};
+
+	for (u32 i = 0; i < 3; ++i) {
+		for (u32 j = 0; j < 3; ++j) {
+			const i32 cell = request.m_Cells[i][j];
+			if (cell < 0 or cell > 2) {
+				return 0;
+			}
+			index = index * 3 + static_cast<u64>(cell);
+			empty += cell == 0 ? 1 : 0;
+		}
+	}
+
+	const u64 depth = std::min(request.m_Depth, std::max(empty, 1u));
+
+	return ((index * 2 + static_cast<u64>(request.m_Mark - 1)) * 16 + depth) + 1;
+}
+
+u64 EngineService::CacheSlot(u64 key)
+{
+	return (key * 0x9E3779B97F4A7C15ull) >> (64 - std::countr_zero(CacheEntries));
+}
+
+void EngineService::Evaluate(Batch& batch)
+{
+	const PerfectTable& table = PerfectTable::Get();
+
+	batch.m_Replies.resize(batch.m_Requests.size());
+
+	for (u64 i = 0; i < batch.m_Requests.size(); ++i) {
+		EngineRequest& request = batch.m_Requests[i];
+
+		u32 empty {};
+		for (u32 cell = 0; cell < 9; ++cell) {
+			empty += request.m_Cells[cell / 3][cell % 3] == 0 ? 1 : 0;
+		}
+
+		const auto move = request.m_Depth >= empty
+			? table.BestMove(request.m_Cells, request.m_Mark)
+			: FindBestMove(request.m_Cells, request.m_Mark, request.m_Depth);
+
+		batch.m_Replies[i] = EngineReply { request.m_Id, move.first, move.second };
+	}
+}
+
+void EngineService::OnWindow(void* context, u64)
+{
+	auto* service    = static_cast<EngineService*>(context);
+	service->m_Timer = 0;
+	service->Dispatch();
+}
+
+void EngineService::OnBatch(void* context, u64 batch)
+{
+	auto* service = static_cast<EngineService*>(context);
+	service->Finish(std::unique_ptr<Batch> { reinterpret_cast<Batch*>(batch) });
+	service->FlushTouched();
+}
+
+void EngineService::OnWritable(void* context, int fd)
+{
+	// The listener is watched too but has no entry.
+	auto* service = static_cast<EngineService*>(context);
+	if (static_cast<u64>(fd) < service->m_Clients.size() and
+		service->m_Clients[fd].m_Open) {
+		service->Flush(fd);
+	}
+}
+
+EngineClient::EngineClient() :
+	m_Socket { -1 }
+{
+}
+
+EngineClient::~EngineClient()
+{
+	if (m_Socket != -1) {
+		close(m_Socket);
+	}
+}
+
+bool EngineClient::Connect(const char* name)
+{
+	m_Socket = ConnectLocal(name);
+	return m_Socket != -1;
+}
+
+bool EngineClient::Evaluate(const EngineRequest* requests, u32 count, EngineReply* replies)
+{
+	if (count == 0 or count > EngineService::MaxMessage) {
+		return false;
+	}
+
+	// Ask with the index as ID so replies can land in any order.
+	EngineRequest message[EngineService::MaxMessage];
+	for (u32 i = 0; i < count; ++i) {
+		message[i]      = requests[i];
+		message[i].m_Id = i;
+	}
+
+	if (send(m_Socket, message, count * sizeof(EngineRequest), MSG_NOSIGNAL) == -1) {
+		std::cerr << "EngineClient: send failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	EngineReply received[EngineService::MaxMessage];
+	u32         answered {};
+
+	while (answered < count) {
+		const ssize_t size = recv(m_Socket, received, sizeof(received), 0);
+		if (size == -1 and errno == EINTR) {
+			continue;
+		}
+		if (size <= 0) {
+			std::cerr << "EngineClient: connection lost" << std::endl;
+			return false;
+		}
+
+		for (u64 i = 0; i < size / sizeof(EngineReply); ++i) {
+			const u64 index = received[i].m_Id;
+			if (index < count) {
+				replies[index]      = received[i];
+				replies[index].m_Id = requests[index].m_Id;
+				++answered;
+			}
+		}
+	}
+
+	return true;
+}
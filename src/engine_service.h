@@ -0,0 +1,150 @@
+#ifndef ENGINE_SERVICE_H
+#define ENGINE_SERVICE_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "engine_host.h"
+#include "runtime.h"
+#include "snapshot.h"
+
+
+struct EngineServiceStats {
+	u64              m_Requests {};
+	u64              m_CacheHits {};
+	u64              m_Deduplicated {};    // joined a search already in flight
+	u64              m_Evaluated {};
+	u64              m_Batches {};
+	LatencyHistogram m_Latency;            // received to answered
+};
+
+// Long-lived engine shared by every tool on the host, on a local
+// SOCK_SEQPACKET socket (see ListenLocal). A message is an array of up to
+// MaxMessage EngineRequests and is answered with EngineReplies carrying the
+// same IDs, possibly spread over several messages and in any order.
+//
+// Requests are gathered for up to the batch window, or until BatchSize
+// distinct positions are waiting, and searched together on a worker thread.
+// Identical positions share one search, and recent answers are served from
+// a cache without waiting for a batch.
+class EngineService {
+public:
+	static constexpr u32 MaxMessage   = 64;
+	static constexpr u32 BatchSize    = 256;
+	static constexpr u64 BatchWindow  = 200'000;
+	static constexpr u32 CacheEntries = 1 << 16;
+
+	EngineService(u32 threads = 1, u64 window = BatchWindow);
+	~EngineService();
+
+	EngineService(const EngineService&)            = delete;
+	EngineService& operator=(const EngineService&) = delete;
+
+	bool Listen(const char* name);
+
+	// Called before Run(). Keeps the answer cache in a SnapshotFile at path,
+	// so a restarted service answers from the cache it had before.
+	bool EnableSnapshot(const char* path);
+
+	// Runs the event loop on the calling thread until Stop().
+	void Run();
+
+	// Safe from any thread and from signal handlers.
+	void Stop();
+
+	// Only consistent once Run() has returned.
+	const EngineServiceStats& Stats() const;
+
+private:
+	struct Client {
+		bool                     m_Open {};
+		u32                      m_Generation {};
+		bool                     m_Queued {};    // in m_Touched
+		std::vector<EngineReply> m_Output;
+	};
+
+	struct Waiter {
+		int m_Fd;
+		u32 m_Generation;
+		u64 m_Id;
+		u64 m_Received;
+	};
+
+	struct Batch {
+		std::vector<EngineRequest> m_Requests;    // m_Id holds the position key
+		std::vector<EngineReply>   m_Replies;
+	};
+
+	struct CacheEntry {
+		u64 m_Key {};    // 0 when empty, keys are never 0
+		i32 m_Row {};
+		i32 m_Col {};
+	};
+
+	int m_Listener;
+	u64 m_Window;
+
+	Scheduler m_Scheduler;
+
+	std::vector<Client>                          m_Clients;
+	std::vector<int>                             m_Touched;
+	std::unordered_map<u64, std::vector<Waiter>> m_InFlight;
+	std::vector<CacheEntry>                      m_OwnCache;
+	CacheEntry*                                  m_Cache;    // m_OwnCache or the snapshot
+	SnapshotFile                                 m_Snapshot;
+	std::unique_ptr<Batch>                       m_Filling;
+	u64                                          m_Timer;
+	EngineServiceStats                           m_Stats;
+
+	std::mutex                          m_Mutex;
+	std::condition_variable             m_Signal;
+	std::deque<std::unique_ptr<Batch>>  m_Queue;
+	bool                                m_Stopping;
+	std::vector<std::thread>            m_Workers;
+
+	Task AcceptClients();
+	Task ServeClient(int fd, u32 generation);
+
+	void Submit(int fd, const EngineRequest& request);
+	void Answer(const Waiter& waiter, i32 row, i32 col);
+	void Dispatch();
+	void Finish(std::unique_ptr<Batch> batch);
+	void Flush(int fd);
+	void FlushTouched();
+	void Close(int fd);
+
+	void RunWorker();
+
+	static u64  Key(const EngineRequest& request);
+	static u64  CacheSlot(u64 key);
+	static void Evaluate(Batch& batch);
+
+	static void OnWindow(void* context, u64);
+	static void OnBatch(void* context, u64 batch);
+	static void OnWritable(void* context, int fd);
+};
+
+// Blocking client for tools that want answers from a running EngineService.
+class EngineClient {
+public:
+	EngineClient();
+	~EngineClient();
+
+	EngineClient(const EngineClient&)            = delete;
+	EngineClient& operator=(const EngineClient&) = delete;
+
+	bool Connect(const char* name);
+
+	// Fills replies[i] with the answer to requests[i], count <= MaxMessage.
+	bool Evaluate(const EngineRequest* requests, u32 count, EngineReply* replies);
+
+private:
+	int m_Socket;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "engine_service.h"
+#include "histogram.h"
+
+
+static Board RandomPosition(std::mt19937_64& random, u32 moves)
+{
+	Board board {};
+	for (u32 move = 0; move < moves; ++move) {
+		u32 cell = random() % 9;
+		while (board.m_Cells[cell / 3][cell % 3] != 0) {
+			cell = (cell + 1) % 9;
+		}
+		board.Play(cell / 3, cell % 3);
+	}
+	return board;
+}
+
+// Many clients asking for best moves, once through a shared EngineService
+// and once each solving on its own thread, over the same stream of random
+// positions a few moves into the game.
+//
+//     EngineServiceBench [clients] [seconds] [moves]
+int main(int argc, char* argv[])
+{
+	const u32 clients = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 32;
+	const u64 seconds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 3;
+	const u32 moves   = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 2;
+
+	if (clients == 0 or seconds == 0 or moves > 8) {
+		std::cerr << "Usage: EngineServiceBench [clients] [seconds] [moves]" << std::endl;
+		return -1;
+	}
+
+	// Every client gets the same seed in both runs, so both see the same
+	// positions.
+	const auto run = [&](const char* service, LatencyHistogram& latency) {
+		std::atomic<u64>         answered {};
+		std::vector<std::thread> threads {};
+		std::mutex               mutex {};
+
+		const u64 end = NowNanoseconds() + seconds * 1'000'000'000;
+
+		for (u32 c = 0; c < clients; ++c) {
+			threads.emplace_back([&, c]() {
+				std::mt19937_64  random { c + 1 };
+				LatencyHistogram local {};
+				EngineClient     client {};
+
+				if (service != nullptr and !client.Connect(service)) {
+					return;
+				}
+
+				while (NowNanoseconds() < end) {
+					Board board = RandomPosition(random, moves);
+					const i32 mark = board.m_Player1Turn ? 1 : 2;
+
+					const u64 start = NowNanoseconds();
+
+					if (service != nullptr) {
+						EngineRequest request {};
+						request.m_Mark  = mark;
+						request.m_Depth = PerfectDepth;
+						std::memcpy(request.m_Cells, board.m_Cells, sizeof(request.m_Cells));
+
+						EngineReply reply {};
+						if (!client.Evaluate(&request, 1, &reply)) {
+							return;
+						}
+					}
+					else {
+						FindBestMove(board.m_Cells, mark, PerfectDepth);
+					}
+
+					local.Record(NowNanoseconds() - start);
+					answered.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				std::lock_guard lock { mutex };
+				latency.Merge(local);
+			});
+		}
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		return answered.load();
+	};
+
+	LatencyHistogram solving {};
+	const u64        solved = run(nullptr, solving);
+
+	EngineService service {};
+	if (!service.Listen("engine-bench")) {
+		return -1;
+	}
+
+	std::thread serving { [&service]() {
+		service.Run();
+	} };
+
+	LatencyHistogram asking {};
+	const u64        asked = run("engine-bench", asking);
+
+	service.Stop();
+	serving.join();
+
+	const EngineServiceStats& stats = service.Stats();
+
+	std::cout << clients << " clients, " << moves << " moves in, " << seconds << " s\n"
+			  << "Solving locally: " << solved / seconds << " answers/s\n"
+			  << "Engine service:  " << asked / seconds << " answers/s ("
+			  << stats.m_CacheHits << " cache hits, " << stats.m_Deduplicated
+			  << " deduplicated, " << stats.m_Evaluated << " searched in "
+			  << stats.m_Batches << " batches)" << std::endl;
+	solving.Print(std::cout, "local");
+	asking.Print(std::cout, "service");
+
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "engine_service.h"
+
+
+static EngineService* s_Service {};
+
+static void OnSignal(int)
+{
+	if (s_Service != nullptr) {
+		s_Service->Stop();
+	}
+}
+
+//     TicTacToeEngine [--name NAME] [--threads N] [--window-us N] [--snapshot PATH]
+//
+// Serves EngineRequests on the local socket NAME (default "engine") until
+// SIGINT or SIGTERM, then prints batching and cache counters. With
+// --snapshot the answer cache survives restarts.
+int main(int argc, char* argv[])
+{
+	const char* name    = "engine";
+	u32         threads = 1;
+	u64         window  = EngineService::BatchWindow;
+	const char* snapshot {};
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		const u64 value = std::strtoull(argv[i + 1], nullptr, 10);
+
+		if (std::strcmp(argv[i], "--name") == 0) {
+			name = argv[i + 1];
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0) {
+			threads = static_cast<u32>(value);
+		}
+		else if (std::strcmp(argv[i], "--window-us") == 0) {
+			window = value * 1'000;
+		}
+		else if (std::strcmp(argv[i], "--snapshot") == 0) {
+			snapshot = argv[i + 1];
+		}
+		else {
+			std::cerr << "Usage: TicTacToeEngine [--name NAME] [--threads N] "
+						 "[--window-us N] [--snapshot PATH]"
+					  << std::endl;
+			return -1;
+		}
+	}
+
+	EngineService service { threads, window };
+	if (!service.Listen(name)) {
+		return -1;
+	}
+	if (snapshot != nullptr and !service.EnableSnapshot(snapshot)) {
+		return -1;
+	}
+
+	s_Service = &service;
+	std::signal(SIGINT, OnSignal);
+	std::signal(SIGTERM, OnSignal);
+
+	std::cout << "Engine serving on " << name << std::endl;
+	service.Run();
+
+	const EngineServiceStats& stats = service.Stats();
+
+	std::cout << "Requests: " << stats.m_Requests << ", cache hits: " << stats.m_CacheHits
+			  << ", deduplicated: " << stats.m_Deduplicated
+			  << ", searched: " << stats.m_Evaluated << " in " << stats.m_Batches
+			  << " batches" << std::endl;
+	stats.m_Latency.Print(std::cout, "answer");
+
+	return 0;
+}
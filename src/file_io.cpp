@@ -0,0 +1,60 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "file_io.h"
+
+
+bool WriteAll(int fd, const void* data, u64 size, const char* owner)
+{
+	const auto* bytes = static_cast<const unsigned char*>(data);
+
+	u64 done {};
+	while (done < size) {
+		const ssize_t written = write(fd, bytes + done, size - done);
+		if (written == -1 and errno == EINTR) {
+			continue;
+		}
+		if (written == -1) {
+			std::cerr << owner << ": write failed: " << std::strerror(errno) << std::endl;
+			return false;
+		}
+		done += static_cast<u64>(written);
+	}
+
+	return true;
+}
+
+int CreateTemporary(const std::string& path, const char* owner)
+{
+	const std::string temporary = path + ".tmp";
+
+	const int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		std::cerr << owner << ": cannot create " << temporary << ": " << std::strerror(errno)
+				  << std::endl;
+	}
+
+	return fd;
+}
+
+bool ReplaceWithTemporary(int fd, const std::string& path, bool ok, const char* owner)
+{
+	if (fd != -1) {
+		close(fd);
+	}
+
+	const std::string temporary = path + ".tmp";
+	if (!ok or std::rename(temporary.c_str(), path.c_str()) == -1) {
+		std::cerr << owner << ": cannot write " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		unlink(temporary.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,24 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <string>
+
+#include "rules.h"
+
+
+// File helpers shared by the journal, archive, index and stats writers.
+// Failures are printed to std::cerr after owner, the writer's name.
+
+// Writes all of data, retrying short and interrupted writes.
+bool WriteAll(int fd, const void* data, u64 size, const char* owner);
+
+// Files that readers map are written next to their final path as path.tmp
+// and renamed over it once complete, so a reader never maps a half-written
+// file. Returns the descriptor of path.tmp, -1 when it cannot be created.
+int CreateTemporary(const std::string& path, const char* owner);
+
+// Closes fd and renames path.tmp over path when ok, otherwise or when the
+// rename fails path.tmp is removed. True when path was replaced.
+bool ReplaceWithTemporary(int fd, const std::string& path, bool ok, const char* owner);
+
+#endif
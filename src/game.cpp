@@ -1,22 +1,78 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <stb_image.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <cmath>
 #include <limits>
 #include <utility>
 
 #include "game.h"
+#include "grid_renderer.h"
+#include "histogram.h"
+#include "mark_renderer.h"
 #include "shader.h"
 
+#ifdef TICTACTOE_NETWORKING
+	#include "engine_host.h"
+	#include "journal.h"
+	#include "snapshot.h"
+	#include "spectator.h"
+#endif
+
+
+// The Frame uniform block, std140.
+struct FrameUniforms {
+	float m_Cells[2] { 3.0f, 3.0f };
+	float m_Resolution[2] {};
+};
+
+// The Marks uniform block, std140: the colors of X, O and the win lines, at
+// their MarkShape, with every line using the first line entry.
+struct MarkUniforms {
+	float m_Colors[4][4];
+};
+
+static constexpr MarkUniforms MarkColors { {
+	{},
+	{ 78 / 255.0f, 203 / 255.0f, 169 / 255.0f, 1.0f },
+	{ 143 / 255.0f, 101 / 255.0f, 228 / 255.0f, 1.0f },
+	{ 0.9f, 0.9f, 0.9f, 1.0f },
+} };
+
+static constexpr u32 FrameBinding = 0;
+static constexpr u32 MarkBinding  = 1;
+
+static constexpr u32 FrameBlock = UniformName("Frame");
+static constexpr u32 MarkBlock  = UniformName("Marks");
+
+// Bumped to wake the logic thread. EngineHost can only notify through a
+// plain function, so it lives here rather than in Game.
+static std::atomic<u32> LogicWake {};
+
+static void WakeLogic()
+{
+	LogicWake.fetch_add(1, std::memory_order_release);
+	LogicWake.notify_one();
+}
 
-static void CursorPosCallback(GLFWwindow* window, double xPos, double yPos);
-static void
-	MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
-void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
-static void FrameBufferSizeCallback(GLFWwindow* window, int width, int height);
-static void ProcessInput(GLFWwindow* window);
+// The per-user cache, not the working directory, so the game reuses its
+// binaries wherever it is started from. Empty, and nothing is cached, when
+// there is no such directory.
+static std::string ShaderCacheDirectory()
+{
+	if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache != nullptr and *cache != '\0') {
+		return std::string { cache } + "/tictactoe/shaders";
+	}
+	if (const char* local = std::getenv("LOCALAPPDATA"); local != nullptr and *local != '\0') {
+		return std::string { local } + "/tictactoe/shaders";
+	}
+	if (const char* home = std::getenv("HOME"); home != nullptr and *home != '\0') {
+		return std::string { home } + "/.cache/tictactoe/shaders";
+	}
+	return {};
+}
 
 Game::Game() :
 	m_Board {},
@@ -52,242 +108,235 @@ int Game::Init()
 	}
 
 	glfwMakeContextCurrent(m_Window);
+	glfwSetWindowUserPointer(m_Window, this);
 	glfwSetFramebufferSizeCallback(m_Window, FrameBufferSizeCallback);
+	glfwSetWindowRefreshCallback(m_Window, WindowRefreshCallback);
 
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
 		std::cerr << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
 
-	glfwSetInputMode(m_Window, GLFW_STICKY_KEYS, GLFW_TRUE);
+	// Changes that arrive while a frame waits for vsync are drawn together
+	// in the next one.
+	glfwSwapInterval(1);
+
 	glfwSetMouseButtonCallback(m_Window, MouseButtonCallback);
 	glfwSetKeyCallback(m_Window, KeyCallback);
-	const int& resetCode = glfwGetKeyScancode(GLFW_KEY_SPACE);
-
-	Shader shader[2] {};
-	shader[0].Load(
-		"../../src/assets/grid-vshader.vs", "../../src/assets/grid-fshader-1.fs");
-
-	shader[1].Load(
-		"../../src/assets/element-vshader.vs",
-		"../../src/assets/element-fshader-2.fs");
-
-	float board[] = {
-		-(1.0f/3.0f),  1.0f, 0.0f,
-		-(1.0f/3.0f), -1.0f, 0.0f,
-		 (1.0f/3.0f),  1.0f, 0.0f,
-		 (1.0f/3.0f), -1.0f, 0.0f,
-		-1.0f, -(1.0f/3.0f), 0.0f,
-		 1.0f, -(1.0f/3.0f), 0.0f,
-		-1.0f,  (1.0f/3.0f), 0.0f,
-		 1.0f,  (1.0f/3.0f), 0.0f
-	};
-
-	float xo[] = {
-		 // vertices                    // colors         // texture coords
-		 (1.0f / 3.0f),  (1.0f / 3.0f), 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, // top right
-		 (1.0f / 3.0f), -(1.0f / 3.0f), 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, // bottom right
-		-(1.0f / 3.0f), -(1.0f / 3.0f), 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // bottom left
-		-(1.0f / 3.0f),  (1.0f / 3.0f), 1.0f, 0.0f, 1.0f, 0.0f, 1.0f  // top left
-	};
-
-	unsigned int indices[] = {
-		0, 1, 3,
-		1, 2, 3
-	};
-
-	unsigned int vao[2] {};
-	glGenVertexArrays(2, vao);
-
-	unsigned int vbo[2] {};
-	glGenBuffers(2, vbo);
-
-	glBindVertexArray(vao[0]);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(board), board, GL_STATIC_DRAW);
-	glVertexAttribPointer(
-		0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glBindVertexArray(vao[1]);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(xo), xo, GL_STATIC_DRAW);
-
-	unsigned int ebo {};
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(
-		GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	unsigned int elementTexture[2];
-	glGenTextures(2, elementTexture);
-	glBindTexture(GL_TEXTURE_2D, elementTexture[0]);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(
-		GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	int texWidth {};
-	int texHeight {};
-	int nrChannels {};
-
-	stbi_set_flip_vertically_on_load(true);
-
-	unsigned char* xData =
-		stbi_load("../../src/assets/x.png", &texWidth, &texHeight, &nrChannels, 0);
-
-	if (xData) {
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			GL_RGBA,
-			texWidth,
-			texHeight,
-			0,
-			GL_RGBA,
-			GL_UNSIGNED_BYTE,
-			xData);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else {
-		std::cout << "Failed to load the texture!" << std::endl;
-	}
-
-	stbi_image_free(xData);
-
-	glBindTexture(GL_TEXTURE_2D, elementTexture[1]);
-
-	unsigned char* oData =
-		stbi_load("../../src/assets/o.png", &texWidth, &texHeight, &nrChannels, 0);
-
-	if (oData) {
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			GL_RGBA,
-			texWidth,
-			texHeight,
-			0,
-			GL_RGBA,
-			GL_UNSIGNED_BYTE,
-			oData);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else {
-		std::cout << "Failed to load the texture!" << std::endl;
-	}
-
-	stbi_image_free(oData);
-
-	glVertexAttribPointer(
-		0, 2, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glVertexAttribPointer(
-		1,
-		3,
-		GL_FLOAT,
-		GL_FALSE,
-		7 * sizeof(float),
-		(void*)(2 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(
-		2,
-		2,
-		GL_FLOAT,
-		GL_FALSE,
-		7 * sizeof(float),
-		(void*)(5 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);    // Unbinding buffer
-	glBindVertexArray(0);
+
+	Shader        shader[2] {};
+	const std::string cache = ShaderCacheDirectory();
+	ShaderBuilder     shaders { cache.c_str() };
+
+	shaders.AddSources(
+		shader[0], m_Assets.Shader("grid-vshader.vs"), m_Assets.Shader("grid-fshader-1.fs"));
+
+	shaders.AddSources(
+		shader[1],
+		m_Assets.Shader("element-vshader.vs"),
+		m_Assets.Shader("element-fshader-2.fs"));
+
+	shaders.Build();
+
+	const ShaderBuildStats& shaderStats = shaders.Stats();
+	std::cout << "Shaders: " << shaderStats.m_Programs << " programs ready in "
+			  << shaderStats.m_Time / 1'000 << " us, " << shaderStats.m_Cached
+			  << " from the cache" << (shaderStats.m_Parallel ? ", compiled in parallel" : "")
+			  << std::endl;
+
+	GridRenderer grid {};
+	grid.Init();
+
+	MarkRenderer marks {};
+	marks.Init();
+
+	UniformBuffer markBuffer {};
+	markBuffer.Init(MarkBinding, sizeof(MarkUniforms));
+	markBuffer.Update(MarkColors);
+	if (!shader[1].BindBlock(MarkBlock, MarkBinding, sizeof(MarkUniforms))) {
+		std::cerr << "Mark shader has no usable Marks block" << std::endl;
+	}
+
+	UniformBuffer frameBuffer {};
+	frameBuffer.Init(FrameBinding, sizeof(FrameUniforms));
+	if (!shader[0].BindBlock(FrameBlock, FrameBinding, sizeof(FrameUniforms))) {
+		std::cerr << "Grid shader has no usable Frame block" << std::endl;
+	}
+	if (!shader[1].BindBlock(FrameBlock, FrameBinding, sizeof(FrameUniforms))) {
+		std::cerr << "Mark shader has no usable Frame block" << std::endl;
+	}
+
+	FrameUniforms frame {};
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	double xPos {};
-	double yPos {};
+	Publish();
+	m_Running.store(true);
+	m_Logic = std::thread { &Game::RunLogic, this };
 
 	while (!glfwWindowShouldClose(m_Window)) {
-		ProcessInput(m_Window);
+		const u64 start = NowNanoseconds();
+
+		if (m_Views.Update()) {
+			m_Dirty = true;
+		}
+
+		if (m_Dirty) {
+			m_Dirty = false;
+
+			glClearColor(0.102f, 0.102f, 0.102f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
 
-		glClearColor(0.102f, 0.102f, 0.102f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+			int framebufferWidth {};
+			int framebufferHeight {};
+			glfwGetFramebufferSize(m_Window, &framebufferWidth, &framebufferHeight);
 
-		shader[0].Use();
-		glBindVertexArray(vao[0]);
-		glDrawArrays(GL_LINES, 0, 8);
+			frame.m_Resolution[0] = static_cast<float>(framebufferWidth);
+			frame.m_Resolution[1] = static_cast<float>(framebufferHeight);
+			frameBuffer.Update(frame);
 
-		shader[1].Use();
+			shader[0].Use();
+			grid.Draw();
 
-		for (u32 i = 0; i < 3; ++i) {
-			for (u32 j = 0; j < 3; ++j) {
-				if (m_Board[i][j] == 0) {
-					continue;
-				}
+			shader[1].Use();
+			marks.SetBoard(m_Views.Front().m_Board);
+			marks.Draw();
 
-				glUniform1f(
-					glGetUniformLocation(shader[1].m_SID, "deltaX"),
-					static_cast<float>(j));
-				glUniform1f(
-					glGetUniformLocation(shader[1].m_SID, "deltaY"),
-					static_cast<float>(i));
+			glfwSwapBuffers(m_Window);
+			++m_Frames;
 
-				glBindTexture(GL_TEXTURE_2D, elementTexture[m_Board[i][j] - 1]);
-				glBindVertexArray(vao[1]);
-				glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+			// Every move this frame shows for the first time, timed from its
+			// input to the swap.
+			const GameView& view  = m_Views.Front();
+			const u64       now   = NowNanoseconds();
+			const u64       first = std::max(
+				m_Presented, view.m_Inputs - std::min<u64>(view.m_Inputs, GameView::InputHistory));
+			for (u64 i = first; i < view.m_Inputs; ++i) {
+				m_InputLatency.Record(now - view.m_InputTimes[i % GameView::InputHistory]);
 			}
+			m_Presented = view.m_Inputs;
 		}
 
-		if (m_CurrentState != GAME_OVER and m_GameMode == SINGLE_P and m_Player1Turn) {
-			MakeMove();
-			m_Player1Turn = !m_Player1Turn;
+		m_LongestIteration = std::max(m_LongestIteration, NowNanoseconds() - start);
+
+		// Nothing to draw: sleep until an event, cursor motion included, or
+		// until the logic thread posts one with a new view.
+		if (m_Dirty) {
+			glfwPollEvents();
 		}
+		else {
+			glfwWaitEvents();
+		}
+		++m_Wakeups;
+	}
 
-		glfwWaitEvents();
-
-		if (glfwGetMouseButton(m_Window, GLFW_MOUSE_BUTTON_LEFT)) {
-			glfwGetCursorPos(m_Window, &xPos, &yPos);
-			UpdateBoard(xPos, yPos);
-
-			if (m_CurrentState == GAME_OVER) {
-				if (m_Winner == 1) {
-					std::cout << "Player 1 won!" << std::endl;
-				}
-				else if (m_Winner == -1) {
-					std::cout << "Player 2 won!" << std::endl;
-				}
-				else {
-					std::cout << "Draw!" << std::endl;
-				}
-				// LogBoard();
-			}
+	m_Running.store(false);
+	WakeLogic();
+	m_Logic.join();
+
+	std::cout << "Drew " << m_Frames << " frames in " << m_Wakeups << " wakeups, longest "
+			  << m_LongestIteration / 1'000 << " us between two waits" << std::endl;
+	if (m_InputLatency.Count() > 0) {
+		m_InputLatency.Print(std::cout, "Input to present");
+	}
+
+	return 0;
+}
+
+void Game::RunLogic()
+{
+	while (m_Running.load()) {
+		const u32 wake = LogicWake.load(std::memory_order_acquire);
+
+		GameInput input {};
+		while (m_Inputs.Pop(input)) {
+			Apply(input);
 		}
 
-		if (glfwGetKey(m_Window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-			Reset();
+		// A move from input is published before the engine starts on its
+		// reply, so the search never delays the click showing up.
+		if (m_Changed) {
+			m_Changed = false;
+			Publish();
+			glfwPostEmptyEvent();
+			continue;
+		}
+
+		if (m_CurrentState != GAME_OVER and m_GameMode == SINGLE_P and m_Player1Turn) {
+			if (MakeMove()) {
+				m_Changed = true;
+				continue;
+			}
 		}
 
-		glfwSwapBuffers(m_Window);
+		// Until input arrives, the engine process answers or Init() stops us.
+		LogicWake.wait(wake, std::memory_order_acquire);
 	}
+}
 
-	return 0;
+void Game::Apply(const GameInput& input)
+{
+	if (input.m_Kind == INPUT_RESET) {
+		Reset();
+		return;
+	}
+
+	if (input.m_Kind == INPUT_RELEASE) {
+		m_ButtonDown = false;
+		return;
+	}
+
+	// Only the edge plays: a press GLFW repeats without a release, as after
+	// a focus change, is ignored.
+	if (m_ButtonDown) {
+		return;
+	}
+	m_ButtonDown = true;
+
+	if (input.m_Column < 0 or input.m_Row < 0) {
+		return;
+	}
+
+	const u32 moves = m_Moves;
+	UpdateBoard(static_cast<u32>(input.m_Column), static_cast<u32>(input.m_Row));
+
+	if (m_Moves != moves) {
+		m_InputTimes[m_InputMoves % GameView::InputHistory] = input.m_Time;
+		++m_InputMoves;
+	}
 }
 
-void Game::UpdateBoard(u32 x, u32 y)
+void Game::Publish()
 {
-	if (m_CurrentState == GAME_OVER) {
+	GameView& view = m_Views.Back();
+	std::copy(&m_Board[0][0], &m_Board[0][0] + 9, &view.m_Board[0][0]);
+	view.m_Moves  = m_Moves;
+	view.m_Winner = m_Winner;
+	view.m_State  = m_CurrentState;
+	view.m_Inputs = m_InputMoves;
+	std::copy(m_InputTimes, m_InputTimes + GameView::InputHistory, view.m_InputTimes);
+	m_Views.Publish();
+}
+
+void Game::Send(const GameInput& input)
+{
+	if (!m_Inputs.Push(input)) {
+		std::cerr << "Input dropped, the game is not keeping up" << std::endl;
 		return;
 	}
+	WakeLogic();
+}
 
-	x /= 300;
-	y /= 300;
+void Game::UpdateBoard(u32 x, u32 y)
+{
+	if (m_CurrentState == GAME_OVER or m_PendingMove != 0 or x > 2 or y > 2) {
+		return;
+	}
 
 	if (m_Board[y][x] == 0) {
+		m_History[m_Moves] = static_cast<unsigned char>(y * 3 + x);
+
 		if (m_Player1Turn) {
 			m_Board[y][x] = 1;
 			m_Player1Turn = !m_Player1Turn;
@@ -296,7 +345,9 @@ void Game::UpdateBoard(u32 x, u32 y)
 			m_Board[y][x] = 2;
 			m_Player1Turn = !m_Player1Turn;
 		}
-		++m_Moves;
+		m_Changed = true;
+		FinishMove();
+		return;
 	}
 
 	UpdateGameState();
@@ -315,58 +366,74 @@ void Game::UpdateGameState()
 		std::cout << m_Moves << '\n';
 		m_CurrentState = GAME_OVER;
 	}
-}
 
-Utility Game::CheckWinner()
-{
-	for (u32 i = 0; i < 3; ++i) {
-		if (m_Board[i][0] == 0 or m_Board[0][i] == 0) {
-			continue;
+	if (m_CurrentState == GAME_OVER) {
+		if (m_Winner == 1) {
+			std::cout << "Player 1 won!" << std::endl;
 		}
-
-		if (m_Board[i][0] == m_Board[i][1] and m_Board[i][0] == m_Board[i][2]) {
-			return m_Board[i][0] == 1 ? Utility::X : Utility::O;
+		else if (m_Winner == -1) {
+			std::cout << "Player 2 won!" << std::endl;
 		}
-		if (m_Board[0][i] == m_Board[1][i] and m_Board[0][i] == m_Board[2][i]) {
-			return m_Board[0][i] == 1 ? Utility::X : Utility::O;
+		else {
+			std::cout << "Draw!" << std::endl;
 		}
+		Record();
 	}
+}
 
-	if (m_Board[0][0] != 0 and m_Board[0][0] == m_Board[1][1] and
-		m_Board[0][0] == m_Board[2][2]) {
-		return m_Board[0][0] == 1 ? Utility::X : Utility::O;
-	}
-	if (m_Board[2][0] != 0 and m_Board[2][0] == m_Board[1][1] and
-		m_Board[2][0] == m_Board[0][2]) {
-		return m_Board[2][0] == 1 ? Utility::X : Utility::O;
-	}
+// After a mark is placed and the turn handed over. Spectators and the
+// snapshot only ever see the move together with the state it leads to.
+void Game::FinishMove()
+{
+	++m_Moves;
+	UpdateGameState();
+	Broadcast();
+	Save();
+}
 
-	return Utility::T;
+Utility Game::CheckWinner()
+{
+	return ::CheckWinner(m_Board);
 }
 
-void Game::MakeMove()
+// Returns false while the engine process is still searching.
+bool Game::MakeMove()
 {
-	i32 bestUtilVal = std::numeric_limits<i32>::min();
 	std::pair<i32, i32> currentMove {};
 
-	for (i32 i = 0; i < 3; ++i) {
-		for (i32 j = 0; j < 3; ++j) {
-			if (m_Board[i][j] == 0) {
-				m_Board[i][j] = 1;
-				const auto utilVal = Minimax(m_Board, 0, false);
-				m_Board[i][j] = 0;
-
-				if (utilVal > bestUtilVal) {
-					bestUtilVal = utilVal;
-					currentMove.first = i;
-					currentMove.second = j;
-				}
-			}
+#ifdef TICTACTOE_NETWORKING
+	if (m_Engine != nullptr) {
+		if (m_PendingMove == 0) {
+			m_PendingMove = m_Engine->Request(m_Board, 1, PerfectDepth);
+			return false;
 		}
+
+		EngineReply reply {};
+		do {
+			if (!m_Engine->Poll(reply)) {
+				return false;
+			}
+		} while (reply.m_Id != m_PendingMove);
+
+		m_PendingMove = 0;
+		currentMove   = { reply.m_Row, reply.m_Col };
+	}
+	else
+#endif
+	{
+		currentMove = FindBestMove(m_Board, 1, PerfectDepth);
+	}
+
+	if (currentMove.first == -1) {
+		m_Player1Turn = false;
+		return true;
 	}
 
 	m_Board[currentMove.first][currentMove.second] = 1;
-	++m_Moves;
+	m_History[m_Moves] = static_cast<unsigned char>(currentMove.first * 3 + currentMove.second);
+	m_Player1Turn = false;
+	FinishMove();
+	return true;
 }
 
 void Game::Reset()
@@ -382,43 +449,116 @@ void Game::Reset()
 	m_CurrentState = GAME_INPROGRESS;
 	m_GameMode = SINGLE_P;
 	m_Player1Turn = true;
+	m_PendingMove = 0;
+	m_Changed = true;
+	Broadcast();
+	Save();
 }
 
-i32 Game::Minimax(i32 board[3][3], const u32& depth, const bool& isMax)
+void Game::SetSpectators(SpectatorChannel* spectators)
 {
-	if (auto temp = CheckWinner(); temp != Utility::T) {
-		return temp;
-	}
-
-	i32 bestUtilVal {};
-	if (isMax) {
-		bestUtilVal = std::numeric_limits<i32>::min();
-		for (u32 i = 0; i < 3; ++i) {
-			for (u32 j = 0; j < 3; ++j) {
-				if (m_Board[i][j] == 0) {
-					m_Board[i][j] = 1;
-					const auto utilVal = Minimax(m_Board, depth + 1, false);
-					m_Board[i][j] = 0;
-					bestUtilVal = std::max(utilVal, bestUtilVal);
-				}
-			}
-		}
+	m_Spectators = spectators;
+}
+
+bool Game::SetEngineHost(EngineHost* engine)
+{
+#ifdef TICTACTOE_NETWORKING
+	if (!engine->Start(WakeLogic)) {
+		return false;
 	}
-	else {
-		bestUtilVal = std::numeric_limits<i32>::max();
-		for (u32 i = 0; i < 3; ++i) {
-			for (u32 j = 0; j < 3; ++j) {
-				if (m_Board[i][j] == 0) {
-					m_Board[i][j] = 2;
-					const auto utilVal = Minimax(m_Board, depth + 1, true);
-					m_Board[i][j] = 0;
-					bestUtilVal = std::min(utilVal, bestUtilVal);
-				}
-			}
-		}
+	m_Engine = engine;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Game::SetAssetDirectory(const char* directory)
+{
+	m_Assets.SetOverride(directory);
+}
+
+void Game::SetJournal(GameJournal* journal)
+{
+	m_Journal = journal;
+}
+
+bool Game::SetSnapshot(SnapshotFile* snapshot, const char* path)
+{
+#ifdef TICTACTOE_NETWORKING
+	const SnapshotSection game { SNAPSHOT_GAME, 1, sizeof(SnapshotSlot<SavedGame>), 1 };
+
+	if (!snapshot->Open(path, { game })) {
+		return false;
 	}
+	m_Saved = snapshot->Section<SnapshotSlot<SavedGame>>(SNAPSHOT_GAME);
+
+	// An engine move that was in flight is asked for again by the loop.
+	SavedGame saved {};
+	if (m_Saved->Load(saved)) {
+		std::copy(&saved.m_Board[0][0], &saved.m_Board[0][0] + 9, &m_Board[0][0]);
+		std::copy(saved.m_History, saved.m_History + 9, m_History);
+		m_Moves         = saved.m_Moves;
+		m_Winner        = saved.m_Winner;
+		m_CurrentState  = saved.m_CurrentState;
+		m_GameMode      = saved.m_GameMode;
+		m_Player1Turn   = saved.m_Player1Turn;
+		m_GamesFinished = saved.m_GamesFinished;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Game::Save()
+{
+#ifdef TICTACTOE_NETWORKING
+	if (m_Saved == nullptr) {
+		return;
+	}
+
+	SavedGame saved {};
+	std::copy(&m_Board[0][0], &m_Board[0][0] + 9, &saved.m_Board[0][0]);
+	std::copy(m_History, m_History + 9, saved.m_History);
+	saved.m_Moves         = m_Moves;
+	saved.m_Winner        = m_Winner;
+	saved.m_CurrentState  = m_CurrentState;
+	saved.m_GameMode      = m_GameMode;
+	saved.m_Player1Turn   = m_Player1Turn;
+	saved.m_GamesFinished = m_GamesFinished;
+
+	m_Saved->Store(saved);
+#endif
+}
+
+void Game::Record()
+{
+#ifdef TICTACTOE_NETWORKING
+	if (m_Journal == nullptr) {
+		return;
+	}
+
+	GameRecord record {};
+	record.m_Time   = UnixNanoseconds();
+	record.m_GameId = ++m_GamesFinished;
+	record.m_Mode   = m_GameMode;
+	record.m_Winner = m_Winner;
+	record.m_Moves  = m_Moves;
+	std::copy(m_History, m_History + m_Moves, record.m_History);
 
-	return bestUtilVal;
+	m_Journal->Append(record);
+#endif
+}
+
+void Game::Broadcast()
+{
+#ifdef TICTACTOE_NETWORKING
+	if (m_Spectators != nullptr) {
+		m_Spectators->Publish(EncodeBoardFrame(
+			m_Board, m_Moves, m_Player1Turn, m_Winner, m_CurrentState));
+	}
+#endif
 }
 
 void Game::LogBoard()
@@ -431,35 +571,65 @@ void Game::LogBoard()
 	}
 }
 
-static void ProcessInput(GLFWwindow* window)
-{
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-		glfwSetWindowShouldClose(window, true);
-	}
-}
-
-static void FrameBufferSizeCallback(
+void Game::FrameBufferSizeCallback(
 	GLFWwindow* window,
 	const int   width,
 	const int   height)
 {
 	glViewport(0, 0, width, height);
+	static_cast<Game*>(glfwGetWindowUserPointer(window))->m_Dirty = true;
+}
+
+void Game::WindowRefreshCallback(GLFWwindow* window)
+{
+	static_cast<Game*>(glfwGetWindowUserPointer(window))->m_Dirty = true;
 }
 
-static void
-	MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+void Game::MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 {
-	if (double xPos {}, yPos {};
-		button == GLFW_MOUSE_BUTTON_LEFT and action == GLFW_PRESS) {
-		glfwGetCursorPos(window, &xPos, &yPos);
-		std::cout << "Left mouse button at " << xPos << ',' << yPos
-				  << std::endl;
+	if (button != GLFW_MOUSE_BUTTON_LEFT) {
+		return;
 	}
+
+	const u64 time = NowNanoseconds();
+	auto*     game = static_cast<Game*>(glfwGetWindowUserPointer(window));
+
+	if (action == GLFW_RELEASE) {
+		game->Send(GameInput { INPUT_RELEASE, -1, -1, time });
+		return;
+	}
+
+	// The cell is found now, against the window as it is now, so a resize
+	// or cursor motion before the logic thread gets to it changes nothing.
+	double xPos {};
+	double yPos {};
+	glfwGetCursorPos(window, &xPos, &yPos);
+	std::cout << "Left mouse button at " << xPos << ',' << yPos << std::endl;
+
+	int width {};
+	int height {};
+	glfwGetWindowSize(window, &width, &height);
+
+	GameInput input { INPUT_PRESS, -1, -1, time };
+	if (xPos >= 0.0 and yPos >= 0.0 and xPos < width and yPos < height) {
+		input.m_Column = static_cast<i32>(xPos * 3.0 / width);
+		input.m_Row    = static_cast<i32>(yPos * 3.0 / height);
+	}
+	game->Send(input);
 }
 
-void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+void Game::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-	if (key == GLFW_KEY_SPACE and action == GLFW_PRESS) {
-		std::cout << "Reset!";
+	if (action != GLFW_PRESS) {
+		return;
+	}
+
+	if (key == GLFW_KEY_ESCAPE) {
+		glfwSetWindowShouldClose(window, true);
+	}
+	else if (key == GLFW_KEY_SPACE) {
+		std::cout << "Reset!" << std::endl;
+		static_cast<Game*>(glfwGetWindowUserPointer(window))
+			->Send(GameInput { INPUT_RESET, -1, -1, NowNanoseconds() });
 	}
 }
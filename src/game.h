@@ -2,34 +2,63 @@
 #define GAME_H
 
 
+#include <atomic>
 #include <cstdint>
 #include <limits>
+#include <thread>
 
+#include "assets.h"
+#include "histogram.h"
+#include "mpsc_queue.h"
+#include "rules.h"
+#include "triple_buffer.h"
 
-using i32 = std::int32_t;
-using u32 = std::uint32_t;
-using i64 = std::int64_t;
-using u64 = std::uint64_t;
 
 struct GLFWwindow;
-
-enum GameState {
-	GAME_MENU,
-	GAME_INPROGRESS,
-	GAME_OVER
+class SpectatorChannel;
+class EngineHost;
+class GameJournal;
+class SnapshotFile;
+
+template<typename T>
+struct SnapshotSlot;
+
+enum InputKind : u32 {
+	INPUT_PRESS,
+	INPUT_RELEASE,
+	INPUT_RESET
 };
 
-enum GameMode {
-	SINGLE_P,
-	MULTI_P
+// Sent by the window callbacks to the logic thread, stamped when GLFW
+// delivered it. Button events carry the cell under the cursor at that
+// moment, -1 when it was outside the board.
+struct GameInput {
+	InputKind m_Kind {};
+	i32       m_Column {};
+	i32       m_Row {};
+	u64       m_Time {};
 };
 
-enum Utility {
-	O = -1,
-	T,
-	X
+// Everything the render thread draws, published whole by the logic thread.
+struct GameView {
+	static constexpr u32 InputHistory = 8;
+
+	i32       m_Board[3][3] {};
+	u32       m_Moves {};
+	Utility   m_Winner {};
+	GameState m_State {};
+
+	// Moves made from input so far, and the input time of the latest ones
+	// by number modulo InputHistory, so the render thread can time every
+	// move up to the frame that first shows it, even when it skips views.
+	u64 m_Inputs {};
+	u64 m_InputTimes[InputHistory] {};
 };
 
+// The window, input and drawing stay on the thread that calls Init(). The
+// board, the rules and the engine run on a logic thread that takes input
+// through a queue and publishes a GameView after every change, so a slow
+// engine move never holds up a frame.
 class Game {
 public:
 	Game();
@@ -37,6 +66,22 @@ public:
 
 	int Init();
 
+	void SetSpectators(SpectatorChannel* spectators);
+
+	// Plays the engine's moves through a separate engine process instead of
+	// searching on the render thread. Starts the host.
+	bool SetEngineHost(EngineHost* engine);
+
+	// Records every finished game.
+	void SetJournal(GameJournal* journal);
+
+	// Keeps the game in a SnapshotFile opened at path and continues the one
+	// a previous run left there.
+	bool SetSnapshot(SnapshotFile* snapshot, const char* path);
+
+	// Shaders in directory replace the embedded ones.
+	void SetAssetDirectory(const char* directory);
+
 private:
 	i32         m_Board[3][3];
 	u32         m_Moves;
@@ -46,18 +91,75 @@ private:
 	GameMode    m_GameMode;
 	bool        m_Player1Turn {};
 
+	SpectatorChannel* m_Spectators {};
+	EngineHost*       m_Engine {};
+	u64               m_PendingMove {};
+	GameJournal*      m_Journal {};
+	u64               m_GamesFinished {};
+	unsigned char     m_History[9] {};
+
+	struct SavedGame {
+		i32           m_Board[3][3];
+		u32           m_Moves;
+		Utility       m_Winner;
+		GameState     m_CurrentState;
+		GameMode      m_GameMode;
+		bool          m_Player1Turn;
+		u64           m_GamesFinished;
+		unsigned char m_History[9];
+	};
+
+	SnapshotSlot<SavedGame>* m_Saved {};
+
+	AssetStore m_Assets;
+
+	// Render thread. Set by whatever changes the picture: a new GameView, a
+	// resize or an expose. The loop draws one frame for all changes since
+	// the last one and otherwise sleeps in glfwWaitEvents.
+	bool m_Dirty { true };
+	u64  m_Frames {};
+	u64  m_Wakeups {};
+	u64  m_LongestIteration {};
+
+	u64              m_Presented {};    // moves from input already shown
+	LatencyHistogram m_InputLatency;
+
+	// Logic thread. Once Init() starts it, it owns the game state above,
+	// from m_Board to m_Saved, except m_Window.
+	std::thread            m_Logic;
+	std::atomic<bool>      m_Running {};
+	MpscQueue<GameInput>   m_Inputs { 64 };
+	TripleBuffer<GameView> m_Views;
+	bool                   m_Changed {};
+	bool                   m_ButtonDown {};
+	u64                    m_InputMoves {};
+	u64                    m_InputTimes[GameView::InputHistory] {};
+
 	const u32   m_Width  = 900;
 	const u32   m_Height = 900;
 
 	void        UpdateBoard(u32 x, u32 y);
 	void        UpdateGameState();
+	void        FinishMove();
 	Utility     CheckWinner();
-	void        MakeMove();
-	i32         Minimax(i32 board[3][3], const u32& depth, const  bool& isMax);
+	bool        MakeMove();
 	void        Reset();
+	void        Broadcast();
+	void        Record();
+	void        Save();
 
 	void LogBoard();
 
+	void RunLogic();
+	void Apply(const GameInput& input);
+	void Publish();
+	void Send(const GameInput& input);
+
+	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	static void FrameBufferSizeCallback(GLFWwindow* window, int width, int height);
+	static void WindowRefreshCallback(GLFWwindow* window);
+
 };
 
 #endif
\ No newline at end of file
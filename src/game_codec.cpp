@@ -0,0 +1,372 @@
+#include <limits>
+
+#include "game_codec.h"
+
+
+const GameRanking& GameRanking::Get()
+{
+	static const GameRanking ranking {};
+	return ranking;
+}
+
+GameRanking::GameRanking()
+{
+	Count(0, 0);
+}
+
+// Fills the tables for every position reachable from index, moves being the
+// number of marks already on the board.
+void GameRanking::Count(u32 index, u32 moves)
+{
+	if (m_Outcome[index] != OUTCOME_NONE) {
+		return;
+	}
+
+	i32 cells[3][3] {};
+	for (u32 cell = 0; cell < 9; ++cell) {
+		cells[cell / 3][cell % 3] = static_cast<i32>(Cell(index, cell));
+	}
+
+	if (const Utility winner = CheckWinner(cells); winner != Utility::T) {
+		m_Outcome[index]  = winner == Utility::X ? OUTCOME_X : OUTCOME_O;
+		m_Complete[index] = 1;
+		m_Prefixes[index] = 1;
+		return;
+	}
+	if (moves == 9) {
+		m_Outcome[index]  = OUTCOME_DRAW;
+		m_Complete[index] = 1;
+		m_Prefixes[index] = 1;
+		return;
+	}
+
+	const u32 mark     = moves % 2 == 0 ? 1 : 2;
+	u32       complete {};
+	u32       prefixes = 1;
+
+	for (u32 cell = 0; cell < 9; ++cell) {
+		if (Cell(index, cell) != 0) {
+			continue;
+		}
+
+		const u32 child = index + mark * Powers[cell];
+		Count(child, moves + 1);
+
+		complete += m_Complete[child];
+		prefixes += m_Prefixes[child];
+	}
+
+	m_Outcome[index]  = OUTCOME_OPEN;
+	m_Complete[index] = complete;
+	m_Prefixes[index] = prefixes;
+}
+
+bool GameRanking::Terminal(u32 index) const
+{
+	return m_Outcome[index] != OUTCOME_OPEN;
+}
+
+u32 GameRanking::Cell(u32 index, u32 cell)
+{
+	return index / Powers[cell] % 3;
+}
+
+bool GameRanking::Rank(const unsigned char* moves, u32 count, u32& rank) const
+{
+	u32           index {};
+	unsigned char board[9] {};    // Cell() without the divisions
+	rank = 0;
+
+	for (u32 i = 0; i < count; ++i) {
+		const u32 cell = moves[i];
+		if (Terminal(index) or cell > 8 or board[cell] != 0) {
+			return false;
+		}
+
+		const u32 mark = i % 2 == 0 ? 1 : 2;
+		for (u32 before = 0; before < cell; ++before) {
+			if (board[before] == 0) {
+				rank += m_Complete[index + mark * Powers[before]];
+			}
+		}
+
+		index += mark * Powers[cell];
+		board[cell] = 1;
+	}
+
+	return Terminal(index);
+}
+
+u32 GameRanking::Unrank(u32 rank, unsigned char moves[9]) const
+{
+	u32           index {};
+	u32           count {};
+	unsigned char board[9] {};
+
+	rank %= CompleteGames;
+
+	while (!Terminal(index)) {
+		const u32 mark = count % 2 == 0 ? 1 : 2;
+
+		for (u32 cell = 0; cell < 9; ++cell) {
+			if (board[cell] != 0) {
+				continue;
+			}
+
+			const u32 child = index + mark * Powers[cell];
+			if (rank < m_Complete[child]) {
+				moves[count++] = static_cast<unsigned char>(cell);
+				index          = child;
+				board[cell]    = 1;
+				break;
+			}
+			rank -= m_Complete[child];
+		}
+	}
+
+	return count;
+}
+
+bool GameRanking::RankPrefix(const unsigned char* moves, u32 count, u32& rank) const
+{
+	u32           index {};
+	unsigned char board[9] {};
+	rank = 0;
+
+	for (u32 i = 0; i < count; ++i) {
+		const u32 cell = moves[i];
+		if (Terminal(index) or cell > 8 or board[cell] != 0) {
+			return false;
+		}
+
+		// The sequence stopping here comes first, then each earlier child's
+		// whole subtree.
+		rank += 1;
+
+		const u32 mark = i % 2 == 0 ? 1 : 2;
+		for (u32 before = 0; before < cell; ++before) {
+			if (board[before] == 0) {
+				rank += m_Prefixes[index + mark * Powers[before]];
+			}
+		}
+
+		index += mark * Powers[cell];
+		board[cell] = 1;
+	}
+
+	return true;
+}
+
+u32 GameRanking::UnrankPrefix(u32 rank, unsigned char moves[9]) const
+{
+	u32           index {};
+	u32           count {};
+	unsigned char board[9] {};
+
+	rank %= LegalSequences;
+
+	while (rank > 0 and !Terminal(index)) {
+		rank -= 1;
+
+		const u32 mark = count % 2 == 0 ? 1 : 2;
+
+		for (u32 cell = 0; cell < 9; ++cell) {
+			if (board[cell] != 0) {
+				continue;
+			}
+
+			const u32 child = index + mark * Powers[cell];
+			if (rank < m_Prefixes[child]) {
+				moves[count++] = static_cast<unsigned char>(cell);
+				index          = child;
+				board[cell]    = 1;
+				break;
+			}
+			rank -= m_Prefixes[child];
+		}
+	}
+
+	return count;
+}
+
+Utility GameRanking::Winner(const unsigned char* moves, u32 count) const
+{
+	u32 index {};
+	for (u32 i = 0; i < count and moves[i] < 9; ++i) {
+		index += (i % 2 == 0 ? 1 : 2) * Powers[moves[i]];
+	}
+
+	if (index >= Positions) {
+		return Utility::T;
+	}
+
+	switch (m_Outcome[index]) {
+	case OUTCOME_X:
+		return Utility::X;
+	case OUTCOME_O:
+		return Utility::O;
+	default:
+		return Utility::T;
+	}
+}
+
+void WriteVarint(u64 value, std::vector<unsigned char>& out)
+{
+	while (value >= 0x80) {
+		out.push_back(static_cast<unsigned char>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<unsigned char>(value));
+}
+
+bool ReadVarint(const unsigned char* data, u64 size, u64& offset, u64& value)
+{
+	value = 0;
+
+	for (u32 shift = 0; shift < 64 and offset < size; shift += 7) {
+		const unsigned char byte = data[offset++];
+		value |= static_cast<u64>(byte & 0x7F) << shift;
+
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Counts of free cells over a Fenwick tree, so both the index of a cell
+// among the free ones and the k-th free cell take O(log cells).
+class FreeCells {
+public:
+	explicit FreeCells(u32 cells) :
+		m_Tree(cells + 1),
+		m_Top { 1 }
+	{
+		while (m_Top * 2 <= cells) {
+			m_Top *= 2;
+		}
+
+		for (u32 i = 1; i <= cells; ++i) {
+			m_Tree[i] += 1;
+			if (const u32 parent = i + (i & (~i + 1)); parent <= cells) {
+				m_Tree[parent] += m_Tree[i];
+			}
+		}
+	}
+
+	// Free cells before cell.
+	u32 Before(u32 cell) const
+	{
+		u32 count {};
+		for (u32 i = cell; i > 0; i -= i & (~i + 1)) {
+			count += m_Tree[i];
+		}
+		return count;
+	}
+
+	u32 Nth(u32 n) const
+	{
+		u32 position {};
+		for (u32 step = m_Top; step > 0; step /= 2) {
+			if (position + step < m_Tree.size() and m_Tree[position + step] <= n) {
+				position += step;
+				n -= m_Tree[position];
+			}
+		}
+		return position;
+	}
+
+	void Take(u32 cell)
+	{
+		for (u32 i = cell + 1; i < m_Tree.size(); i += i & (~i + 1)) {
+			m_Tree[i] -= 1;
+		}
+	}
+
+	bool Free(u32 cell) const
+	{
+		return Before(cell + 1) != Before(cell);
+	}
+
+private:
+	std::vector<u32> m_Tree;
+	u32              m_Top;
+};
+
+bool EncodeMoveSequence(u32 cells, const u32* moves, u32 count, std::vector<unsigned char>& out)
+{
+	if (count > cells) {
+		return false;
+	}
+
+	FreeCells free { cells };
+
+	const u64 start = out.size();
+	WriteVarint(count, out);
+
+	u64 limb {};
+	u64 scale = 1;
+
+	for (u32 i = 0; i < count; ++i) {
+		if (moves[i] >= cells or !free.Free(moves[i])) {
+			out.resize(start);
+			return false;
+		}
+
+		const u64 radix = cells - i;
+		if (scale > std::numeric_limits<u64>::max() / radix) {
+			WriteVarint(limb, out);
+			limb  = 0;
+			scale = 1;
+		}
+
+		limb += free.Before(moves[i]) * scale;
+		scale *= radix;
+		free.Take(moves[i]);
+	}
+
+	if (count > 0) {
+		WriteVarint(limb, out);
+	}
+
+	return true;
+}
+
+u64 DecodeMoveSequence(u32 cells, const unsigned char* data, u64 size, std::vector<u32>& moves)
+{
+	u64 offset {};
+	u64 count {};
+	if (!ReadVarint(data, size, offset, count) or count > cells) {
+		return 0;
+	}
+
+	FreeCells free { cells };
+	moves.clear();
+
+	u64 limb {};
+	u64 scale = 1;
+
+	for (u32 i = 0; i < count; ++i) {
+		const u64 radix = cells - i;
+
+		// Same grouping as the encoder: a new limb starts where the previous
+		// one would have overflowed.
+		if (i == 0 or scale > std::numeric_limits<u64>::max() / radix) {
+			if (!ReadVarint(data, size, offset, limb)) {
+				return 0;
+			}
+			scale = 1;
+		}
+
+		const u64 digit = limb % radix;
+		limb /= radix;
+		scale *= radix;
+
+		const u32 cell = free.Nth(static_cast<u32>(digit));
+		free.Take(cell);
+		moves.push_back(cell);
+	}
+
+	return offset;
+}
@@ -0,0 +1,68 @@
+#ifndef GAME_CODEC_H
+#define GAME_CODEC_H
+
+#include <array>
+#include <vector>
+
+#include "rules.h"
+
+
+// Numbers every legal 3x3 move sequence densely. Moves are cell indices
+// (row * 3 + col), X moves first and a sequence ends at a win or a full
+// board. Ranks follow the order of a depth-first walk that tries cells in
+// ascending order, so neighbouring ranks share their opening.
+class GameRanking {
+public:
+	static constexpr u32 CompleteGames  = 255'168;    // fits in 18 bits
+	static constexpr u32 LegalSequences = 549'946;    // every prefix, 20 bits
+
+	static const GameRanking& Get();
+
+	// Complete games only, false for anything that is not one.
+	bool Rank(const unsigned char* moves, u32 count, u32& rank) const;
+	u32  Unrank(u32 rank, unsigned char moves[9]) const;
+
+	// Any legal sequence including unfinished ones and the empty game.
+	bool RankPrefix(const unsigned char* moves, u32 count, u32& rank) const;
+	u32  UnrankPrefix(u32 rank, unsigned char moves[9]) const;
+
+	// Result of the position a complete or partial sequence reaches.
+	Utility Winner(const unsigned char* moves, u32 count) const;
+
+private:
+	static constexpr u32                Positions = 19683;    // 3^9
+	static constexpr std::array<u32, 9> Powers { 1, 3, 9, 27, 81, 243, 729, 2187, 6561 };
+
+	enum Outcome : unsigned char {
+		OUTCOME_NONE,
+		OUTCOME_OPEN,
+		OUTCOME_X,
+		OUTCOME_O,
+		OUTCOME_DRAW
+	};
+
+	std::array<u32, Positions>     m_Complete {};    // complete games from here
+	std::array<u32, Positions>     m_Prefixes {};    // sequences from here
+	std::array<Outcome, Positions> m_Outcome {};     // OUTCOME_NONE if unreachable
+
+	GameRanking();
+
+	void Count(u32 index, u32 moves);
+	bool Terminal(u32 index) const;
+	static u32 Cell(u32 index, u32 cell);
+};
+
+// LEB128: seven bits per byte, high bit set on all but the last.
+void WriteVarint(u64 value, std::vector<unsigned char>& out);
+bool ReadVarint(const unsigned char* data, u64 size, u64& offset, u64& value);
+
+// Move sequences on boards of any size (m,n,k games on cells squares). Each
+// move is written as its index among the cells still free, and those digits
+// are packed in mixed radix into as few 64-bit varints as fit, after a
+// varint move count. A 15x15 board takes about one byte per move.
+bool EncodeMoveSequence(u32 cells, const u32* moves, u32 count, std::vector<unsigned char>& out);
+
+// Returns the number of bytes read, 0 when data does not hold a sequence.
+u64 DecodeMoveSequence(u32 cells, const unsigned char* data, u64 size, std::vector<u32>& moves);
+
+#endif
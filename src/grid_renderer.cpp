@@ -0,0 +1,27 @@
+#include <glad/glad.h>
+
+#include "grid_renderer.h"
+
+
+GridRenderer::GridRenderer() :
+	m_Vao {}
+{
+}
+
+GridRenderer::~GridRenderer()
+{
+	if (m_Vao != 0) {
+		glDeleteVertexArrays(1, &m_Vao);
+	}
+}
+
+void GridRenderer::Init()
+{
+	glGenVertexArrays(1, &m_Vao);
+}
+
+void GridRenderer::Draw() const
+{
+	glBindVertexArray(m_Vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
@@ -0,0 +1,27 @@
+#ifndef GRID_RENDERER_H
+#define GRID_RENDERER_H
+
+
+// Draws the lines between the cells of a board of any size as one
+// fullscreen triangle. grid-fshader-1.fs finds the nearest line for every
+// pixel from the cells and resolution of the Frame block, so a 15x15 board
+// costs the same three vertices as a 3x3 one.
+class GridRenderer {
+public:
+	GridRenderer();
+	~GridRenderer();
+
+	GridRenderer(const GridRenderer&)            = delete;
+	GridRenderer& operator=(const GridRenderer&) = delete;
+
+	// Needs a current GL context.
+	void Init();
+
+	// With the grid shader in use.
+	void Draw() const;
+
+private:
+	unsigned int m_Vao;    // empty, a core profile draws nothing without one
+};
+
+#endif
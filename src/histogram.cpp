@@ -0,0 +1,99 @@
+#include <bit>
+#include <iomanip>
+
+#include "histogram.h"
+
+
+void LatencyHistogram::Record(u64 value)
+{
+	++m_Counts[Index(value)];
+	++m_Total;
+	m_Sum += value;
+	m_Max = value > m_Max ? value : m_Max;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+	for (u32 i = 0; i < Buckets; ++i) {
+		m_Counts[i] += other.m_Counts[i];
+	}
+
+	m_Total += other.m_Total;
+	m_Sum += other.m_Sum;
+	m_Max = other.m_Max > m_Max ? other.m_Max : m_Max;
+}
+
+void LatencyHistogram::Clear()
+{
+	*this = LatencyHistogram {};
+}
+
+u64 LatencyHistogram::Count() const
+{
+	return m_Total;
+}
+
+u64 LatencyHistogram::Max() const
+{
+	return m_Max;
+}
+
+double LatencyHistogram::Mean() const
+{
+	return m_Total == 0 ? 0.0 : static_cast<double>(m_Sum / m_Total);
+}
+
+u64 LatencyHistogram::Percentile(double percentile) const
+{
+	if (m_Total == 0) {
+		return 0;
+	}
+
+	auto target = static_cast<u64>(percentile / 100.0 * m_Total + 0.5);
+	target      = target == 0 ? 1 : target;
+
+	u64 seen {};
+	for (u32 i = 0; i < Buckets; ++i) {
+		seen += m_Counts[i];
+		if (seen >= target) {
+			const u64 highest = Highest(i);
+			return highest < m_Max ? highest : m_Max;
+		}
+	}
+
+	return m_Max;
+}
+
+void LatencyHistogram::Print(std::ostream& out, const char* name) const
+{
+	out << std::fixed << std::setprecision(1) << name << ": n=" << m_Total
+		<< " mean=" << Mean() / 1000.0 << "us"
+		<< " p50=" << Percentile(50.0) / 1000.0 << "us"
+		<< " p90=" << Percentile(90.0) / 1000.0 << "us"
+		<< " p99=" << Percentile(99.0) / 1000.0 << "us"
+		<< " p99.9=" << Percentile(99.9) / 1000.0 << "us"
+		<< " max=" << m_Max / 1000.0 << "us" << std::endl;
+}
+
+u32 LatencyHistogram::Index(u64 value)
+{
+	const u32 magnitude = 63 - std::countl_zero(value | 1);
+	if (magnitude < SubBits) {
+		return static_cast<u32>(value);
+	}
+
+	const u32 shift = magnitude - SubBits + 1;
+	return shift * HalfCount + static_cast<u32>(value >> shift);
+}
+
+u64 LatencyHistogram::Highest(u32 index)
+{
+	if (index < 2 * HalfCount) {
+		return index;
+	}
+
+	const u32 shift = index / HalfCount - 1;
+	const u64 sub   = index - shift * HalfCount;
+
+	return ((sub + 1) << shift) - 1;
+}
@@ -0,0 +1,49 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <array>
+#include <chrono>
+#include <ostream>
+
+#include "rules.h"
+
+
+inline u64 NowNanoseconds()
+{
+	return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+								std::chrono::steady_clock::now().time_since_epoch())
+								.count());
+}
+
+// Log-linear histogram in the style of HdrHistogram: every power of two is
+// split into 64 linear buckets, so any recorded value is reported within
+// about 1.5% of its true size, from nanoseconds up to the full u64 range.
+class LatencyHistogram {
+public:
+	void Record(u64 value);
+	void Merge(const LatencyHistogram& other);
+	void Clear();
+
+	u64    Count() const;
+	u64    Max() const;
+	double Mean() const;
+	u64    Percentile(double percentile) const;
+
+	// One line summary in microseconds, e.g. for load test reports.
+	void Print(std::ostream& out, const char* name) const;
+
+private:
+	static constexpr u32 SubBits   = 7;
+	static constexpr u32 HalfCount = 1u << (SubBits - 1);
+	static constexpr u32 Buckets   = (64 - SubBits + 2) * HalfCount;
+
+	std::array<u64, Buckets> m_Counts {};
+	u64                      m_Total {};
+	u64                      m_Max {};
+	long double              m_Sum {};
+
+	static u32 Index(u64 value);
+	static u64 Highest(u32 index);
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "archive.h"
+#include "position_index.h"
+
+
+static int Build(int argc, char* argv[])
+{
+	bool        archive {};
+	u32         threads = 1;
+	const char* source {};
+	const char* path {};
+
+	for (int i = 2; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--archive") == 0) {
+			archive = true;
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 and i + 1 < argc) {
+			threads = static_cast<u32>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (source == nullptr) {
+			source = argv[i];
+		}
+		else {
+			path = argv[i];
+		}
+	}
+
+	if (source == nullptr or path == nullptr) {
+		std::cerr << "Usage: TicTacToeIndex build [--archive] [--threads N] SOURCE INDEX"
+				  << std::endl;
+		return -1;
+	}
+
+	const u64            start = NowNanoseconds();
+	PositionIndexBuilder builder { threads };
+	if (!builder.Open(path)) {
+		return -1;
+	}
+
+	if (archive) {
+		ArchiveReader reader {};
+		GameRecord    record {};
+		if (!reader.Open(source)) {
+			return -1;
+		}
+		while (reader.Next(record)) {
+			builder.Add(record);
+		}
+		if (reader.Failed()) {
+			return -1;
+		}
+	}
+	else if (GameJournal::Scan(source, [&builder](const GameRecord& record) {
+				 builder.Add(record);
+			 }) == -1) {
+		return -1;
+	}
+
+	if (!builder.Finish()) {
+		return -1;
+	}
+
+	std::cout << "Indexed " << builder.Games() << " games from " << builder.Runs()
+			  << " runs in " << (NowNanoseconds() - start) / 1'000'000 << " ms" << std::endl;
+
+	return 0;
+}
+
+static void PrintCounts(const PositionEntry* entry)
+{
+	if (entry == nullptr) {
+		std::cout << "no games\n";
+		return;
+	}
+
+	std::cout << entry->m_Games << " games, X " << entry->m_XWins << " / draw "
+			  << entry->m_Draws << " / O " << entry->m_OWins << "\n";
+}
+
+static int Query(int argc, char* argv[])
+{
+	if (argc < 3 or argc > 5) {
+		std::cerr << "Usage: TicTacToeIndex query INDEX [MOVES] [LIMIT]" << std::endl;
+		return -1;
+	}
+
+	PositionIndex index {};
+	if (!index.Open(argv[2])) {
+		return -1;
+	}
+
+	// Moves are cell digits (row * 3 + col), "40" being X centre, O corner.
+	const char* moves = argc > 3 ? argv[3] : "";
+	const u64   limit = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 10;
+
+	Board board {};
+	for (const char* move = moves; *move != '\0'; ++move) {
+		const u32 cell = static_cast<u32>(*move - '0');
+		if (cell > 8 or !board.Play(cell / 3, cell % 3)) {
+			std::cerr << "Illegal move sequence " << moves << std::endl;
+			return -1;
+		}
+	}
+
+	std::cout << "Position: ";
+	PrintCounts(index.Find(board.m_Cells));
+
+	// The opening explorer: every reply and how the games after it went.
+	// Replies that are mirror images of an earlier one are left out, they
+	// share its position and counts.
+	std::vector<u32> seen {};
+	for (u32 cell = 0; cell < 9; ++cell) {
+		Board     next = board;
+		const u32 key  = next.Play(cell / 3, cell % 3) ? CanonicalPosition(next.m_Cells) : 0;
+
+		if (key != 0 and std::find(seen.begin(), seen.end(), key) == seen.end()) {
+			seen.push_back(key);
+			std::cout << "  " << moves << cell << ": ";
+			PrintCounts(index.Find(key));
+		}
+	}
+
+	if (const PositionEntry* entry = index.Find(board.m_Cells); entry != nullptr) {
+		PostingList games = index.Games(*entry);
+		u64         gameId {};
+
+		std::cout << "Games:";
+		for (u64 i = 0; i < limit and games.Next(gameId); ++i) {
+			std::cout << " " << gameId;
+		}
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
+
+//     TicTacToeIndex build [--archive] [--threads N] SOURCE INDEX
+//     TicTacToeIndex query INDEX [MOVES] [LIMIT]
+//
+// Builds a position index from a game journal (or an archive), or looks up
+// the games that reached the position after MOVES together with the results
+// after each possible next move.
+int main(int argc, char* argv[])
+{
+	if (argc > 1 and std::strcmp(argv[1], "build") == 0) {
+		return Build(argc, argv);
+	}
+	if (argc > 1 and std::strcmp(argv[1], "query") == 0) {
+		return Query(argc, argv);
+	}
+
+	std::cerr << "Usage: TicTacToeIndex build [--archive] [--threads N] SOURCE INDEX\n"
+				 "       TicTacToeIndex query INDEX [MOVES] [LIMIT]"
+			  << std::endl;
+	return -1;
+}
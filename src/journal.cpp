@@ -0,0 +1,478 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "file_io.h"
+#include "journal.h"
+
+
+static constexpr unsigned char Magic[8] = { 'T', 'T', 'T', 'J', 'R', 'N', 'L', '1' };
+
+static constexpr u32 HeaderSize  = 4 + 1;
+static constexpr u32 FixedSize   = 8 + 8 + 1 + 1;
+static constexpr u64 BufferLimit = 1 << 20;    // bytes per write or read
+
+static std::array<u32, 256> MakeCrcTable()
+{
+	std::array<u32, 256> table {};
+
+	for (u32 i = 0; i < 256; ++i) {
+		u32 crc = i;
+		for (u32 bit = 0; bit < 8; ++bit) {
+			crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320u : 0);
+		}
+		table[i] = crc;
+	}
+
+	return table;
+}
+
+static u32 Crc32(const unsigned char* data, u64 size)
+{
+	static const std::array<u32, 256> table = MakeCrcTable();
+
+	u32 crc = 0xFFFFFFFFu;
+	for (u64 i = 0; i < size; ++i) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
+
+static void Encode(const GameRecord& record, std::vector<unsigned char>& out)
+{
+	const u32 moves = record.m_Moves > 9 ? 9 : record.m_Moves;
+	const u32 size  = FixedSize + (moves + 1) / 2;
+	const u64 start = out.size();
+
+	out.resize(start + HeaderSize + size);
+	unsigned char* data = out.data() + start;
+
+	data[4] = static_cast<unsigned char>(size);
+	std::memcpy(data + 5, &record.m_Time, 8);
+	std::memcpy(data + 13, &record.m_GameId, 8);
+	data[21] = static_cast<unsigned char>(
+		(record.m_Mode == MULTI_P ? 1 : 0) | (record.m_Winner + 1) << 1 |
+		std::min(record.m_EngineDepth, PerfectDepth) << 3);
+	data[22] = static_cast<unsigned char>(moves);
+
+	for (u32 i = 0; i < moves; ++i) {
+		data[23 + i / 2] |=
+			static_cast<unsigned char>((record.m_History[i] & 0xF) << (i % 2 * 4));
+	}
+
+	const u32 crc = Crc32(data + 4, 1 + size);
+	std::memcpy(data, &crc, 4);
+}
+
+// Returns the record size, or 0 when data does not start with an intact one.
+static u32 Decode(const unsigned char* data, u64 available, GameRecord& record)
+{
+	if (available < HeaderSize + FixedSize) {
+		return 0;
+	}
+
+	const u32 size = data[4];
+	if (size < FixedSize or size > GameJournal::MaxRecordSize - HeaderSize or
+		available < HeaderSize + size) {
+		return 0;
+	}
+
+	u32 crc {};
+	std::memcpy(&crc, data, 4);
+	if (crc != Crc32(data + 4, 1 + size)) {
+		return 0;
+	}
+
+	const u32 flags = data[21];
+	const u32 moves = data[22];
+	if (moves > 9 or size != FixedSize + (moves + 1) / 2 or (flags >> 1 & 3) > 2 or
+		(flags >> 3) > PerfectDepth) {
+		return 0;
+	}
+
+	record = GameRecord {};
+	std::memcpy(&record.m_Time, data + 5, 8);
+	std::memcpy(&record.m_GameId, data + 13, 8);
+	record.m_Mode        = flags & 1 ? MULTI_P : SINGLE_P;
+	record.m_EngineDepth = flags >> 3;
+	record.m_Winner      = static_cast<Utility>(static_cast<i32>(flags >> 1 & 3) - 1);
+	record.m_Moves       = moves;
+
+	for (u32 i = 0; i < moves; ++i) {
+		record.m_History[i] = (data[23 + i / 2] >> (i % 2 * 4)) & 0xF;
+	}
+
+	return HeaderSize + size;
+}
+
+GameJournal::GameJournal() :
+	m_File { -1 },
+	m_Interval { CommitInterval },
+	m_Queue { QueueSize },
+	m_Appended {},
+	m_Running { false },
+	m_Stopped { true }
+{
+}
+
+GameJournal::~GameJournal()
+{
+	Close();
+}
+
+bool GameJournal::Open(const char* path, u64 commitInterval)
+{
+	m_File = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (m_File == -1) {
+		std::cerr << "Journal: cannot open " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		return false;
+	}
+
+	u64       records {};
+	u64       size {};
+	const i64 intact = ScanFile(m_File, nullptr, records, size);
+	if (intact == -1) {
+		std::cerr << "Journal: " << path << " is not a game journal" << std::endl;
+		close(m_File);
+		m_File = -1;
+		return false;
+	}
+
+	u64 length = static_cast<u64>(intact);
+
+	if (size == 0) {
+		if (!Commit(Magic, sizeof(Magic))) {
+			close(m_File);
+			m_File = -1;
+			return false;
+		}
+		length = sizeof(Magic);
+	}
+
+	m_Stats.m_Recovered = records;
+	m_Stats.m_Truncated = size - std::min(size, length);
+
+	// Appends go to the end of the file, so the torn tail has to go before
+	// anything new is written.
+	if (length < size) {
+		std::cerr << "Journal: cutting " << m_Stats.m_Truncated << " torn bytes from "
+				  << path << std::endl;
+		if (ftruncate(m_File, static_cast<off_t>(length)) == -1 or fdatasync(m_File) == -1) {
+			std::cerr << "Journal: cannot truncate " << path << ": " << std::strerror(errno)
+					  << std::endl;
+			close(m_File);
+			m_File = -1;
+			return false;
+		}
+	}
+
+	m_Stats.m_Bytes = length;
+	m_Interval      = commitInterval;
+	m_Running       = true;
+	m_Stopped       = false;
+	m_Writer        = std::thread { &GameJournal::RunWriter, this };
+
+	return true;
+}
+
+void GameJournal::Close()
+{
+	if (m_Writer.joinable()) {
+		m_Running = false;
+		m_Writer.join();
+	}
+
+	if (m_File != -1) {
+		close(m_File);
+		m_File = -1;
+	}
+}
+
+void GameJournal::Append(const GameRecord& record)
+{
+	// Counted before the push, so a Sync() that sees this record counted
+	// also waits for everything queued ahead of it.
+	m_Appended.fetch_add(1);
+
+	while (!m_Queue.Push(record)) {
+		std::this_thread::yield();
+	}
+}
+
+bool GameJournal::Sync()
+{
+	const u64 target = m_Appended.load();
+
+	std::unique_lock lock { m_Mutex };
+	m_Durable.wait(lock, [this, target]() {
+		return m_Stats.m_Durable + m_Stats.m_Failed >= target or m_Stopped;
+	});
+
+	return m_Stats.m_Failed == 0 and m_Stats.m_Durable >= target;
+}
+
+JournalStats GameJournal::Stats() const
+{
+	std::lock_guard lock { m_Mutex };
+
+	JournalStats stats = m_Stats;
+	stats.m_Appended   = m_Appended.load();
+	return stats;
+}
+
+i64 GameJournal::Scan(const char* path, const std::function<void(const GameRecord&)>& visit)
+{
+	const int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		std::cerr << "Journal: cannot open " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		return -1;
+	}
+
+	u64       records {};
+	u64       size {};
+	const i64 intact = ScanFile(fd, visit, records, size);
+	close(fd);
+
+	if (intact == -1 or size == 0) {
+		std::cerr << "Journal: " << path << " is not a game journal" << std::endl;
+		return -1;
+	}
+
+	return intact;
+}
+
+void GameJournal::RunWriter()
+{
+	std::vector<unsigned char> buffer {};
+	GameRecord                 record {};
+	u64                        pending {};
+
+	const auto commit = [&]() {
+		const u64  start = NowNanoseconds();
+		const bool ok    = Commit(buffer.data(), buffer.size());
+
+		std::lock_guard lock { m_Mutex };
+		if (ok) {
+			m_Stats.m_Durable += pending;
+			m_Stats.m_Bytes += buffer.size();
+			++m_Stats.m_Commits;
+			m_Stats.m_Commit.Record(NowNanoseconds() - start);
+		}
+		else {
+			m_Stats.m_Failed += pending;
+		}
+		m_Durable.notify_all();
+
+		buffer.clear();
+		pending = 0;
+	};
+
+	while (true) {
+		// Read before draining, so everything appended before Close() is
+		// written by this pass at the latest.
+		const bool running = m_Running;
+		const u64  next    = NowNanoseconds() + m_Interval;
+
+		while (m_Queue.Pop(record)) {
+			Encode(record, buffer);
+			++pending;
+
+			if (buffer.size() >= BufferLimit) {
+				commit();
+			}
+		}
+
+		if (pending > 0) {
+			commit();
+		}
+
+		if (!running) {
+			std::lock_guard lock { m_Mutex };
+			m_Stopped = true;
+			m_Durable.notify_all();
+			return;
+		}
+
+		// Whatever arrives meanwhile waits for the next group.
+		const u64 now = NowNanoseconds();
+		if (now < next) {
+			std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+		}
+	}
+}
+
+bool GameJournal::Commit(const unsigned char* data, u64 size)
+{
+	if (!WriteAll(m_File, data, size, "Journal")) {
+		return false;
+	}
+
+	if (fdatasync(m_File) == -1) {
+		std::cerr << "Journal: fdatasync failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Streams fd from the start through a fixed buffer. Returns the length of
+// the intact prefix, 0 for an empty file and -1 when the file cannot be read
+// or does not start with the magic. Anything between the intact prefix and
+// size is a torn tail.
+i64 GameJournal::ScanFile(
+	int                                           fd,
+	const std::function<void(const GameRecord&)>& visit,
+	u64&                                          records,
+	u64&                                          size)
+{
+	struct stat status {};
+	if (fstat(fd, &status) == -1) {
+		return -1;
+	}
+	size = static_cast<u64>(status.st_size);
+
+	std::vector<unsigned char> buffer(BufferLimit);
+	u64                        start {};    // file offset of buffer[0]
+	u64                        filled {};
+	u64                        offset {};
+	bool                       end {};
+	GameRecord                 record {};
+
+	records = 0;
+
+	while (true) {
+		if (!end and filled - offset < MaxRecordSize) {
+			std::memmove(buffer.data(), buffer.data() + offset, filled - offset);
+			start += offset;
+			filled -= offset;
+			offset = 0;
+
+			while (filled < buffer.size()) {
+				const ssize_t read = pread(fd, buffer.data() + filled, buffer.size() - filled,
+										   static_cast<off_t>(start + filled));
+				if (read == -1 and errno == EINTR) {
+					continue;
+				}
+				if (read == -1) {
+					return -1;
+				}
+				if (read == 0) {
+					end = true;
+					break;
+				}
+				filled += static_cast<u64>(read);
+			}
+		}
+
+		if (start == 0 and offset == 0) {
+			if (filled == 0) {
+				return 0;
+			}
+			if (filled < sizeof(Magic) or std::memcmp(buffer.data(), Magic, sizeof(Magic)) != 0) {
+				return -1;
+			}
+			offset = sizeof(Magic);
+		}
+
+		const u32 length = Decode(buffer.data() + offset, filled - offset, record);
+		if (length == 0) {
+			break;
+		}
+
+		if (visit) {
+			visit(record);
+		}
+		offset += length;
+		++records;
+	}
+
+	return static_cast<i64>(start + offset);
+}
+
+JournalReader::JournalReader() :
+	m_Map { nullptr },
+	m_Size {},
+	m_Offset {}
+{
+}
+
+JournalReader::~JournalReader()
+{
+	if (m_Map != nullptr) {
+		munmap(const_cast<unsigned char*>(m_Map), m_Size);
+	}
+}
+
+bool JournalReader::Open(const char* path)
+{
+	const int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		std::cerr << "Journal: cannot open " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		return false;
+	}
+
+	struct stat status {};
+	if (fstat(fd, &status) == -1 or static_cast<u64>(status.st_size) < sizeof(Magic)) {
+		std::cerr << "Journal: " << path << " is not a game journal" << std::endl;
+		close(fd);
+		return false;
+	}
+
+	const u64 size   = static_cast<u64>(status.st_size);
+	void*     memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED) {
+		std::cerr << "Journal: mmap failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	madvise(memory, size, MADV_SEQUENTIAL);
+	m_Map    = static_cast<const unsigned char*>(memory);
+	m_Size   = size;
+	m_Offset = sizeof(Magic);
+
+	if (std::memcmp(m_Map, Magic, sizeof(Magic)) != 0) {
+		std::cerr << "Journal: " << path << " is not a game journal" << std::endl;
+		munmap(memory, size);
+		m_Map  = nullptr;
+		m_Size = 0;
+		return false;
+	}
+
+	return true;
+}
+
+bool JournalReader::Next(GameRecord& record)
+{
+	if (m_Map == nullptr) {
+		return false;
+	}
+
+	const u32 length = Decode(m_Map + m_Offset, m_Size - m_Offset, record);
+	m_Offset += length;
+
+	return length != 0;
+}
+
+u64 JournalReader::Offset() const
+{
+	return m_Offset;
+}
+
+u64 JournalReader::Size() const
+{
+	return m_Size;
+}
@@ -0,0 +1,137 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "histogram.h"
+#include "mpsc_queue.h"
+
+
+// Wall clock time, for GameRecord::m_Time.
+inline u64 UnixNanoseconds()
+{
+	return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+								std::chrono::system_clock::now().time_since_epoch())
+								.count());
+}
+
+// One finished game. Moves are cell indices (row * 3 + col) in the order
+// they were played.
+struct GameRecord {
+	u64           m_Time {};    // ns since the Unix epoch
+	u64           m_GameId {};
+	GameMode      m_Mode { SINGLE_P };
+	u32           m_EngineDepth { PerfectDepth };
+	Utility       m_Winner { Utility::T };
+	u32           m_Moves {};
+	unsigned char m_History[9] {};
+};
+
+struct JournalStats {
+	u64              m_Appended {};
+	u64              m_Durable {};
+	u64              m_Failed {};       // lost to a failed write or sync
+	u64              m_Commits {};
+	u64              m_Bytes {};
+	u64              m_Recovered {};    // intact records found by Open()
+	u64              m_Truncated {};    // torn tail bytes cut by Open()
+	LatencyHistogram m_Commit;          // write plus fdatasync
+};
+
+// Append-only file of GameRecords. Appends from any thread go through a
+// lock-free queue to a writer thread, which writes whatever has gathered
+// and makes it durable with one fdatasync per commit interval, so the cost
+// of a sync is shared by every record in the group.
+//
+// The file is an 8 byte magic followed by records of
+//
+//     u32 crc32, u8 size, size payload bytes
+//
+// where the payload is the time, game ID, a mode/winner/engine depth byte,
+// the move count and the moves packed two per byte. A crash can leave a torn record
+// at the end, Open() finds the last record whose checksum matches and cuts
+// the file there.
+class GameJournal {
+public:
+	static constexpr u64 CommitInterval = 2'000'000;
+	static constexpr u32 QueueSize      = 1 << 17;
+	static constexpr u32 MaxRecordSize  = 4 + 1 + 8 + 8 + 1 + 1 + 5;
+
+	GameJournal();
+	~GameJournal();
+
+	GameJournal(const GameJournal&)            = delete;
+	GameJournal& operator=(const GameJournal&) = delete;
+
+	bool Open(const char* path, u64 commitInterval = CommitInterval);
+
+	// Writes out everything appended so far and stops the writer.
+	void Close();
+
+	// Safe from any thread. Waits for room when the writer falls behind
+	// rather than dropping the record.
+	void Append(const GameRecord& record);
+
+	// Blocks until every record appended before the call is durable, false
+	// when a write or sync has failed.
+	bool Sync();
+
+	JournalStats Stats() const;
+
+	// Calls visit for every intact record in path. Returns the number of
+	// bytes they span including the magic, or -1 when path is not a journal.
+	static i64 Scan(const char* path, const std::function<void(const GameRecord&)>& visit);
+
+private:
+	int m_File;
+	u64 m_Interval;
+
+	MpscQueue<GameRecord> m_Queue;
+	std::atomic<u64>      m_Appended;
+	std::atomic<bool>     m_Running;
+	std::thread           m_Writer;
+
+	mutable std::mutex      m_Mutex;
+	std::condition_variable m_Durable;
+	JournalStats            m_Stats;
+	bool                    m_Stopped;    // writer has exited
+
+	void RunWriter();
+	bool Commit(const unsigned char* data, u64 size);
+
+	static i64 ScanFile(
+		int                                           fd,
+		const std::function<void(const GameRecord&)>& visit,
+		u64&                                          records,
+		u64&                                          size);
+};
+
+// Reads a journal in place through mmap, for tools that go through it once.
+// Stops at the end of the intact records, as Scan() does.
+class JournalReader {
+public:
+	JournalReader();
+	~JournalReader();
+
+	JournalReader(const JournalReader&)            = delete;
+	JournalReader& operator=(const JournalReader&) = delete;
+
+	bool Open(const char* path);
+	bool Next(GameRecord& record);
+
+	// Bytes consumed so far and the size of the file.
+	u64 Offset() const;
+	u64 Size() const;
+
+private:
+	const unsigned char* m_Map;
+	u64                  m_Size;
+	u64                  m_Offset;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "journal.h"
+
+
+// Appends random finished games from several threads as fast as the journal
+// takes them, then tears the last record off the file and checks that
+// reopening recovers everything before it.
+//
+//     JournalBench [records] [producers] [path]
+int main(int argc, char* argv[])
+{
+	const u64   records   = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+	const u32   producers = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+	const char* path      = argc > 3 ? argv[3] : "journal-bench.bin";
+
+	if (records == 0 or producers == 0) {
+		std::cerr << "Usage: JournalBench [records] [producers] [path]" << std::endl;
+		return -1;
+	}
+
+	unlink(path);
+
+	GameJournal journal {};
+	if (!journal.Open(path)) {
+		return -1;
+	}
+
+	std::vector<std::thread> threads {};
+	const u64                start = NowNanoseconds();
+
+	for (u32 p = 0; p < producers; ++p) {
+		threads.emplace_back([&, p]() {
+			std::mt19937_64 random { p + 1 };
+
+			for (u64 i = p; i < records; i += producers) {
+				GameRecord record {};
+				record.m_Time   = start + i;
+				record.m_GameId = i + 1;
+				record.m_Mode   = random() % 2 ? MULTI_P : SINGLE_P;
+				record.m_Winner = static_cast<Utility>(static_cast<i32>(random() % 3) - 1);
+				record.m_Moves  = 5 + random() % 5;
+				for (u32 move = 0; move < record.m_Moves; ++move) {
+					record.m_History[move] = static_cast<unsigned char>(random() % 9);
+				}
+
+				journal.Append(record);
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	const u64  appended = NowNanoseconds();
+	const bool durable  = journal.Sync();
+	const u64  synced   = NowNanoseconds();
+
+	const JournalStats stats = journal.Stats();
+	journal.Close();
+
+	std::cout << "Records: " << stats.m_Durable << "/" << records << " durable ("
+			  << stats.m_Bytes << " bytes, " << stats.m_Commits << " commits)\n"
+			  << "Appended in " << (appended - start) / 1'000'000 << " ms, durable after "
+			  << (synced - start) / 1'000'000 << " ms ("
+			  << static_cast<double>(records) * 1e9 / static_cast<double>(synced - start)
+			  << " records/s)" << std::endl;
+	stats.m_Commit.Print(std::cout, "commit");
+
+	if (!durable) {
+		return -1;
+	}
+
+	// A crash in the middle of the last write.
+	if (truncate(path, static_cast<off_t>(stats.m_Bytes - 3)) == -1) {
+		return -1;
+	}
+
+	GameJournal recovered {};
+	if (!recovered.Open(path)) {
+		return -1;
+	}
+
+	const JournalStats after = recovered.Stats();
+	recovered.Close();
+
+	u64 scanned {};
+	GameJournal::Scan(path, [&scanned](const GameRecord&) {
+		++scanned;
+	});
+
+	std::cout << "After tearing 3 bytes: " << after.m_Recovered << " records recovered, "
+			  << after.m_Truncated << " bytes cut, " << scanned << " readable" << std::endl;
+
+	unlink(path);
+
+	return after.m_Recovered == records - 1 and scanned == records - 1 ? 0 : -1;
+}
@@ -0,0 +1,641 @@
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "histogram.h"
+#include "net.h"
+#include "spectator.h"
+
+
+// Synthetic load for TicTacToeServer. Every bot is a real TCP client that
+// joins games and plays them to the end, or watches the newest game.
+//
+//     TicTacToeLoad [--port N] [--clients N] [--seconds N] [--threads N]
+//                   [--think-ms N] [--churn P] [--spectators P] [--single P]
+//                   [--engine P] [--depth N] [--tenants N]
+
+struct LoadConfig {
+	const char* m_Host       = "127.0.0.1";
+	u32         m_Port       = 7700;
+	u32         m_Clients    = 100;
+	u32         m_Seconds    = 10;
+	u32         m_Threads    = 1;
+	u32         m_ThinkMs    = 0;
+	double      m_Churn      = 0.05;    // chance to reconnect after a game
+	double      m_Spectators = 0.1;     // share of clients that only watch
+	double      m_Single     = 0.5;     // share of joins against the engine
+	double      m_Engine     = 0.5;     // share of bots playing engine moves
+	u32         m_Depth      = 3;       // search depth of those moves
+	u32         m_Tenants    = 1;       // engine fair-share groups to spread bots over
+};
+
+struct LoadStats {
+	LatencyHistogram m_Connect;
+	LatencyHistogram m_Match;
+	LatencyHistogram m_Move;
+
+	u64 m_Moves {};
+	u64 m_Games {};
+	u64 m_Frames {};
+	u64 m_Aborted {};
+	u64 m_ConnectErrors {};
+	u64 m_Disconnects {};
+	u64 m_ServerErrors {};
+	u64 m_Moved {};
+	u64 m_Resumed {};
+
+	void Merge(const LoadStats& other)
+	{
+		m_Connect.Merge(other.m_Connect);
+		m_Match.Merge(other.m_Match);
+		m_Move.Merge(other.m_Move);
+
+		m_Moves += other.m_Moves;
+		m_Games += other.m_Games;
+		m_Frames += other.m_Frames;
+		m_Aborted += other.m_Aborted;
+		m_ConnectErrors += other.m_ConnectErrors;
+		m_Disconnects += other.m_Disconnects;
+		m_ServerErrors += other.m_ServerErrors;
+		m_Moved += other.m_Moved;
+		m_Resumed += other.m_Resumed;
+	}
+};
+
+class LoadWorker {
+public:
+	LoadWorker(const LoadConfig& config, u32 clients, u32 seed);
+	~LoadWorker();
+
+	void Run(u64 end);
+
+	const LoadStats& Stats() const;
+
+private:
+	enum Action {
+		ACTION_NONE,
+		ACTION_CONNECT,
+		ACTION_JOIN,
+		ACTION_MOVE,
+		ACTION_SPECTATE,
+		ACTION_RESUME
+	};
+
+	struct Bot {
+		int         m_Fd { -1 };
+		bool        m_Spectator {};
+		bool        m_EngineMoves {};
+		bool        m_Playing {};
+		bool        m_Resume {};    // reconnecting after MOVED
+		u32         m_ResumeTries {};
+		u32         m_Seat {};
+		u32         m_GameId {};
+		u32         m_Token {};
+		i32         m_Cells[3][3] {};
+		std::string m_Input;
+
+		Action m_Action { ACTION_NONE };
+		u64    m_Timer {};
+		u64    m_JoinedAt {};
+		u64    m_MovedAt {};
+	};
+
+	using Timer = std::pair<u64, u32>;
+
+	const LoadConfig& m_Config;
+	int               m_Epoll;
+	std::vector<Bot>  m_Bots;
+	std::mt19937_64   m_Random;
+	LoadStats         m_Stats;
+
+	std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_Timers;
+
+	void Schedule(u32 bot, Action action, u64 delay);
+	void Fire(u32 bot);
+
+	void Connect(u32 bot);
+	void Disconnect(u32 bot, bool expected);
+	void Read(u32 bot);
+	void Send(u32 bot, std::string_view text);
+
+	void OnLine(u32 bot, std::string_view line);
+	void OnBoard(u32 bot, std::string_view board);
+	bool OnFrame(u32 bot);
+	void Move(u32 bot);
+
+	bool Chance(double probability);
+};
+
+LoadWorker::LoadWorker(const LoadConfig& config, u32 clients, u32 seed) :
+	m_Config { config },
+	m_Epoll { epoll_create1(EPOLL_CLOEXEC) },
+	m_Bots(clients),
+	m_Random { seed }
+{
+	for (u32 i = 0; i < clients; ++i) {
+		m_Bots[i].m_Spectator   = Chance(config.m_Spectators);
+		m_Bots[i].m_EngineMoves = Chance(config.m_Engine);
+		Schedule(i, ACTION_CONNECT, 0);
+	}
+}
+
+LoadWorker::~LoadWorker()
+{
+	for (const Bot& bot : m_Bots) {
+		if (bot.m_Fd != -1) {
+			close(bot.m_Fd);
+		}
+	}
+
+	close(m_Epoll);
+}
+
+void LoadWorker::Run(u64 end)
+{
+	epoll_event events[256];
+
+	while (true) {
+		const u64 now = NowNanoseconds();
+		if (now >= end) {
+			return;
+		}
+
+		while (!m_Timers.empty() and m_Timers.top().first <= now) {
+			const auto [deadline, bot] = m_Timers.top();
+			m_Timers.pop();
+
+			if (m_Bots[bot].m_Timer == deadline) {
+				Fire(bot);
+			}
+		}
+
+		u64 wait = end - now;
+		if (!m_Timers.empty()) {
+			const u64 next = m_Timers.top().first;
+			wait           = next > now ? std::min(wait, next - now) : 0;
+		}
+
+		const int count =
+			epoll_wait(m_Epoll, events, 256, static_cast<int>((wait + 999'999) / 1'000'000));
+
+		for (int i = 0; i < count; ++i) {
+			Read(events[i].data.u32);
+		}
+	}
+}
+
+const LoadStats& LoadWorker::Stats() const
+{
+	return m_Stats;
+}
+
+void LoadWorker::Schedule(u32 bot, Action action, u64 delay)
+{
+	// Timers are never cancelled, a stale entry is recognised because the
+	// bot's deadline moved on.
+	const u64 deadline    = NowNanoseconds() + delay;
+	m_Bots[bot].m_Action  = action;
+	m_Bots[bot].m_Timer   = deadline;
+	m_Timers.emplace(deadline, bot);
+}
+
+void LoadWorker::Fire(u32 index)
+{
+	Bot&         bot    = m_Bots[index];
+	const Action action = bot.m_Action;
+
+	bot.m_Action = ACTION_NONE;
+	bot.m_Timer  = 0;
+
+	switch (action) {
+	case ACTION_CONNECT: Connect(index); break;
+	case ACTION_MOVE: Move(index); break;
+	case ACTION_SPECTATE: Send(index, "SPECTATE 0\n"); break;
+	case ACTION_RESUME:
+		Send(
+			index,
+			"RESUME " + std::to_string(bot.m_GameId) + ' ' + std::to_string(bot.m_Token) +
+				'\n');
+		break;
+	case ACTION_JOIN: {
+		const u32 mode   = Chance(m_Config.m_Single) ? 0 : 1;
+		const u32 rating = static_cast<u32>(m_Random() % 3000);
+
+		bot.m_JoinedAt = NowNanoseconds();
+		Send(
+			index,
+			"JOIN " + std::to_string(mode) + ' ' + std::to_string(rating) + ' ' +
+				std::to_string(m_Random() % (PerfectDepth + 1)) + ' ' +
+				std::to_string(index % m_Config.m_Tenants) + '\n');
+		break;
+	}
+	case ACTION_NONE: break;
+	}
+}
+
+void LoadWorker::Connect(u32 index)
+{
+	Bot&      bot   = m_Bots[index];
+	const u64 start = NowNanoseconds();
+
+	bot.m_Fd = ConnectTcp(m_Config.m_Host, m_Config.m_Port);
+	if (bot.m_Fd == -1) {
+		++m_Stats.m_ConnectErrors;
+		Schedule(index, ACTION_CONNECT, 100'000'000);
+		return;
+	}
+
+	m_Stats.m_Connect.Record(NowNanoseconds() - start);
+	SetNonBlocking(bot.m_Fd);
+
+	epoll_event event {};
+	event.events   = EPOLLIN | EPOLLRDHUP;
+	event.data.u32 = index;
+	epoll_ctl(m_Epoll, EPOLL_CTL_ADD, bot.m_Fd, &event);
+
+	bot.m_Input.clear();
+	bot.m_Playing = false;
+
+	const Action first = bot.m_Spectator ? ACTION_SPECTATE
+					   : bot.m_Resume    ? ACTION_RESUME
+										 : ACTION_JOIN;
+	Schedule(index, first, 0);
+}
+
+void LoadWorker::Disconnect(u32 index, bool expected)
+{
+	Bot& bot = m_Bots[index];
+
+	if (!expected) {
+		++m_Stats.m_Disconnects;
+	}
+
+	epoll_ctl(m_Epoll, EPOLL_CTL_DEL, bot.m_Fd, nullptr);
+	close(bot.m_Fd);
+
+	bot.m_Fd      = -1;
+	bot.m_MovedAt = 0;
+	Schedule(index, ACTION_CONNECT, expected ? 0 : 100'000'000);
+}
+
+void LoadWorker::Read(u32 index)
+{
+	Bot& bot = m_Bots[index];
+	char buffer[4096];
+	bool closed {};
+
+	while (bot.m_Fd != -1) {
+		const ssize_t size = read(bot.m_Fd, buffer, sizeof(buffer));
+		if (size == 0 or (size == -1 and errno != EAGAIN and errno != EINTR)) {
+			// Whatever arrived before the end, like MOVED, is still handled.
+			closed = true;
+			break;
+		}
+		if (size == -1) {
+			break;
+		}
+
+		bot.m_Input.append(buffer, static_cast<u64>(size));
+	}
+
+	while (bot.m_Fd != -1 and !bot.m_Input.empty()) {
+		// Spectator frames are binary, everything else is a text line.
+		if (bot.m_Input[0] == 'T') {
+			if (!OnFrame(index)) {
+				break;
+			}
+			continue;
+		}
+
+		const u64 end = bot.m_Input.find('\n');
+		if (end == std::string::npos) {
+			break;
+		}
+
+		const std::string line = bot.m_Input.substr(0, end);
+		bot.m_Input.erase(0, end + 1);
+		OnLine(index, line);
+	}
+
+	if (closed and bot.m_Fd != -1) {
+		Disconnect(index, false);
+	}
+}
+
+void LoadWorker::Send(u32 index, std::string_view text)
+{
+	Bot& bot = m_Bots[index];
+	if (bot.m_Fd == -1) {
+		return;
+	}
+
+	// Requests are tiny, a short write would mean the server stopped reading.
+	if (write(bot.m_Fd, text.data(), text.size()) != static_cast<ssize_t>(text.size())) {
+		Disconnect(index, false);
+	}
+}
+
+void LoadWorker::OnLine(u32 index, std::string_view line)
+{
+	Bot& bot = m_Bots[index];
+
+	if (line.starts_with("GAME ")) {
+		// "GAME <id> <seat> <token>", sent again after a RESUME.
+		u32         fields[3] {};
+		const char* next = line.data() + 5;
+		const char* last = line.data() + line.size();
+		for (u32& field : fields) {
+			next = std::from_chars(next, last, field).ptr + 1;
+			if (next > last) {
+				break;
+			}
+		}
+
+		if (bot.m_Resume) {
+			++m_Stats.m_Resumed;
+		}
+		else {
+			m_Stats.m_Match.Record(NowNanoseconds() - bot.m_JoinedAt);
+		}
+
+		bot.m_Playing = true;
+		bot.m_Resume  = false;
+		bot.m_GameId  = fields[0];
+		bot.m_Seat    = fields[1];
+		bot.m_Token   = fields[2];
+	}
+	else if (line == "MOVED") {
+		// The server is draining: reconnect, the port now reaches the process
+		// the game moved to.
+		++m_Stats.m_Moved;
+		bot.m_Resume      = bot.m_Playing and !bot.m_Spectator;
+		bot.m_ResumeTries = 0;
+		Disconnect(index, true);
+	}
+	else if (line.starts_with("BOARD ")) {
+		OnBoard(index, line.substr(6));
+	}
+	else if (line == "ERR opponent left") {
+		++m_Stats.m_Aborted;
+		bot.m_Playing = false;
+		bot.m_MovedAt = 0;
+		Schedule(index, ACTION_JOIN, 0);
+	}
+	else if (line == "ERR no such game" and bot.m_Spectator) {
+		Schedule(index, ACTION_SPECTATE, 50'000'000);
+	}
+	else if (line == "ERR no such game" and bot.m_Resume and ++bot.m_ResumeTries < 50) {
+		// The snapshot may still be on its way to the new process.
+		Schedule(index, ACTION_RESUME, 10'000'000);
+	}
+	else {
+		++m_Stats.m_ServerErrors;
+		bot.m_Resume = false;
+		if (!bot.m_Playing) {
+			Schedule(
+				index, bot.m_Spectator ? ACTION_SPECTATE : ACTION_JOIN, 10'000'000);
+		}
+	}
+}
+
+void LoadWorker::OnBoard(u32 index, std::string_view board)
+{
+	Bot& bot = m_Bots[index];
+
+	// "<cells> <turn> <state> <winner>"
+	if (board.size() < 15) {
+		++m_Stats.m_ServerErrors;
+		return;
+	}
+
+	for (u32 i = 0; i < 9; ++i) {
+		bot.m_Cells[i / 3][i % 3] = board[i] - '0';
+	}
+
+	if (bot.m_MovedAt != 0) {
+		m_Stats.m_Move.Record(NowNanoseconds() - bot.m_MovedAt);
+		bot.m_MovedAt = 0;
+		++m_Stats.m_Moves;
+	}
+
+	const u32 turn  = static_cast<u32>(board[10] - '0');
+	const u32 state = static_cast<u32>(board[12] - '0');
+
+	if (state == GAME_OVER) {
+		++m_Stats.m_Games;
+		bot.m_Playing = false;
+
+		if (Chance(m_Config.m_Churn)) {
+			Disconnect(index, true);
+		}
+		else {
+			Schedule(index, ACTION_JOIN, 0);
+		}
+	}
+	else if (turn == bot.m_Seat) {
+		Schedule(index, ACTION_MOVE, m_Config.m_ThinkMs * 1'000'000ull);
+	}
+}
+
+bool LoadWorker::OnFrame(u32 index)
+{
+	Bot& bot = m_Bots[index];
+
+	if (bot.m_Input.size() < SpectatorFrame::HeaderSize) {
+		return false;
+	}
+
+	u32 magic {};
+	u32 size {};
+	std::memcpy(&magic, bot.m_Input.data(), 4);
+	std::memcpy(&size, bot.m_Input.data() + 4, 4);
+
+	if (magic != SpectatorFrame::Magic) {
+		++m_Stats.m_ServerErrors;
+		Disconnect(index, false);
+		return false;
+	}
+	if (bot.m_Input.size() < SpectatorFrame::HeaderSize + size) {
+		return false;
+	}
+
+	const bool over =
+		size > 12 and bot.m_Input[SpectatorFrame::HeaderSize + 12] == GAME_OVER;
+
+	bot.m_Input.erase(0, SpectatorFrame::HeaderSize + size);
+	++m_Stats.m_Frames;
+
+	if (over) {
+		Schedule(index, ACTION_SPECTATE, 0);
+	}
+
+	return true;
+}
+
+void LoadWorker::Move(u32 index)
+{
+	Bot& bot = m_Bots[index];
+	if (!bot.m_Playing) {
+		return;
+	}
+
+	std::pair<i32, i32> move { -1, -1 };
+
+	if (bot.m_EngineMoves) {
+		move = FindBestMove(bot.m_Cells, static_cast<i32>(bot.m_Seat), m_Config.m_Depth);
+	}
+	else {
+		u32 empty[9] {};
+		u32 count {};
+		for (u32 i = 0; i < 9; ++i) {
+			if (bot.m_Cells[i / 3][i % 3] == 0) {
+				empty[count++] = i;
+			}
+		}
+
+		if (count != 0) {
+			const u32 cell = empty[m_Random() % count];
+			move           = { static_cast<i32>(cell / 3), static_cast<i32>(cell % 3) };
+		}
+	}
+
+	if (move.first == -1) {
+		return;
+	}
+
+	bot.m_MovedAt = NowNanoseconds();
+	Send(index, "MOVE " + std::to_string(move.first * 3 + move.second) + '\n');
+}
+
+bool LoadWorker::Chance(double probability)
+{
+	return std::uniform_real_distribution<double> { 0.0, 1.0 }(m_Random) < probability;
+}
+
+static bool ParseArguments(int argc, char* argv[], LoadConfig& config)
+{
+	for (int i = 1; i < argc; i += 2) {
+		if (i + 1 >= argc) {
+			return false;
+		}
+
+		const std::string_view name  = argv[i];
+		const char*            value = argv[i + 1];
+
+		if (name == "--host") {
+			config.m_Host = value;
+		}
+		else if (name == "--port") {
+			config.m_Port = std::strtoul(value, nullptr, 10);
+		}
+		else if (name == "--clients") {
+			config.m_Clients = std::strtoul(value, nullptr, 10);
+		}
+		else if (name == "--seconds") {
+			config.m_Seconds = std::strtoul(value, nullptr, 10);
+		}
+		else if (name == "--threads") {
+			config.m_Threads = std::max(1ul, std::strtoul(value, nullptr, 10));
+		}
+		else if (name == "--think-ms") {
+			config.m_ThinkMs = std::strtoul(value, nullptr, 10);
+		}
+		else if (name == "--depth") {
+			config.m_Depth = std::strtoul(value, nullptr, 10);
+		}
+		else if (name == "--tenants") {
+			config.m_Tenants = std::max(1ul, std::strtoul(value, nullptr, 10));
+		}
+		else if (name == "--churn") {
+			config.m_Churn = std::strtod(value, nullptr);
+		}
+		else if (name == "--spectators") {
+			config.m_Spectators = std::strtod(value, nullptr);
+		}
+		else if (name == "--single") {
+			config.m_Single = std::strtod(value, nullptr);
+		}
+		else if (name == "--engine") {
+			config.m_Engine = std::strtod(value, nullptr);
+		}
+		else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	LoadConfig config {};
+	if (!ParseArguments(argc, argv, config)) {
+		std::cerr << "Usage: TicTacToeLoad [--host A] [--port N] [--clients N] "
+					 "[--seconds N] [--threads N] [--think-ms N] [--churn P] "
+					 "[--spectators P] [--single P] [--engine P] [--depth N] "
+					 "[--tenants N]"
+				  << std::endl;
+		return -1;
+	}
+
+	std::vector<std::unique_ptr<LoadWorker>> workers {};
+	std::vector<std::thread>                 threads {};
+
+	for (u32 t = 0; t < config.m_Threads; ++t) {
+		const u32 clients = config.m_Clients / config.m_Threads +
+							(t < config.m_Clients % config.m_Threads ? 1 : 0);
+		workers.push_back(std::make_unique<LoadWorker>(config, clients, t + 1));
+	}
+
+	const u64 start = NowNanoseconds();
+	const u64 end   = start + config.m_Seconds * 1'000'000'000ull;
+
+	for (auto& worker : workers) {
+		threads.emplace_back([&worker, end]() {
+			worker->Run(end);
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	const double elapsed = (NowNanoseconds() - start) / 1e9;
+
+	LoadStats total {};
+	for (const auto& worker : workers) {
+		total.Merge(worker->Stats());
+	}
+
+	std::cout << "Clients: " << config.m_Clients << ", duration: " << elapsed << "s\n"
+			  << "Throughput: " << total.m_Moves / elapsed << " moves/s, "
+			  << total.m_Games / elapsed << " games/s, "
+			  << total.m_Frames / elapsed << " spectator frames/s\n"
+			  << "Errors: connect=" << total.m_ConnectErrors
+			  << " disconnect=" << total.m_Disconnects
+			  << " server=" << total.m_ServerErrors
+			  << " aborted games=" << total.m_Aborted << std::endl;
+
+	if (total.m_Moved > 0) {
+		std::cout << "Migrations: moved=" << total.m_Moved
+				  << " resumed=" << total.m_Resumed << std::endl;
+	}
+
+	total.m_Connect.Print(std::cout, "Connect");
+	total.m_Match.Print(std::cout, "Matchmaking");
+	total.m_Move.Print(std::cout, "Move round trip");
+
+	return total.m_ConnectErrors + total.m_Disconnects + total.m_ServerErrors == 0 ? 0
+																					 : 1;
+}
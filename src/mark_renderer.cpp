@@ -0,0 +1,152 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "mark_renderer.h"
+
+
+MarkRenderer::MarkRenderer() :
+	m_Vao {},
+	m_Quad {},
+	m_Indices {},
+	m_Instances {},
+	m_Capacity {}
+{
+}
+
+MarkRenderer::~MarkRenderer()
+{
+	if (m_Vao != 0) {
+		glDeleteVertexArrays(1, &m_Vao);
+		glDeleteBuffers(1, &m_Quad);
+		glDeleteBuffers(1, &m_Indices);
+		glDeleteBuffers(1, &m_Instances);
+	}
+}
+
+void MarkRenderer::Init()
+{
+	// One cell, centered on the origin. The shader moves it to its cell and
+	// draws the mark inside from its distance field, so there are no
+	// texture coordinates.
+	const float quad[] = {
+		 0.5f,  0.5f,    // top right
+		 0.5f, -0.5f,    // bottom right
+		-0.5f, -0.5f,    // bottom left
+		-0.5f,  0.5f     // top left
+	};
+
+	const unsigned int indices[] = {
+		0, 1, 3,
+		1, 2, 3
+	};
+
+	glGenVertexArrays(1, &m_Vao);
+	glGenBuffers(1, &m_Quad);
+	glGenBuffers(1, &m_Indices);
+	glGenBuffers(1, &m_Instances);
+
+	glBindVertexArray(m_Vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_Quad);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Indices);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+	// Per instance: the cell and the mark.
+	glBindBuffer(GL_ARRAY_BUFFER, m_Instances);
+
+	glVertexAttribPointer(
+		1,
+		2,
+		GL_FLOAT,
+		GL_FALSE,
+		sizeof(MarkInstance),
+		(void*)offsetof(MarkInstance, m_Column));
+	glEnableVertexAttribArray(1);
+	glVertexAttribDivisor(1, 1);
+
+	glVertexAttribIPointer(
+		2, 1, GL_UNSIGNED_INT, sizeof(MarkInstance), (void*)offsetof(MarkInstance, m_Mark));
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MarkRenderer::SetMarks(const MarkInstance* marks, u32 count)
+{
+	if (count == m_Marks.size() and
+		(count == 0 or std::memcmp(marks, m_Marks.data(), count * sizeof(MarkInstance)) == 0)) {
+		return;
+	}
+
+	m_Marks.assign(marks, marks + count);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_Instances);
+
+	if (count > m_Capacity) {
+		m_Capacity = std::max(count, m_Capacity * 2);
+		glBufferData(
+			GL_ARRAY_BUFFER, m_Capacity * sizeof(MarkInstance), nullptr, GL_DYNAMIC_DRAW);
+	}
+	if (count > 0) {
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(MarkInstance), marks);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MarkRenderer::SetBoard(const i32 board[3][3])
+{
+	// Nine marks and at most every line through them.
+	MarkInstance marks[9 + 8] {};
+	u32          count {};
+
+	for (u32 i = 0; i < 3; ++i) {
+		for (u32 j = 0; j < 3; ++j) {
+			if (board[i][j] != 0) {
+				marks[count++] = MarkInstance {
+					static_cast<float>(j), static_cast<float>(i), static_cast<u32>(board[i][j])
+				};
+			}
+		}
+	}
+
+	// A win line sits on the middle cell of its three.
+	for (u32 i = 0; i < 3; ++i) {
+		if (board[i][0] != 0 and board[i][0] == board[i][1] and board[i][0] == board[i][2]) {
+			marks[count++] = MarkInstance { 1.0f, static_cast<float>(i), LINE_ROW };
+		}
+		if (board[0][i] != 0 and board[0][i] == board[1][i] and board[0][i] == board[2][i]) {
+			marks[count++] = MarkInstance { static_cast<float>(i), 1.0f, LINE_COLUMN };
+		}
+	}
+
+	if (board[0][0] != 0 and board[0][0] == board[1][1] and board[0][0] == board[2][2]) {
+		marks[count++] = MarkInstance { 1.0f, 1.0f, LINE_DIAGONAL };
+	}
+	if (board[2][0] != 0 and board[2][0] == board[1][1] and board[2][0] == board[0][2]) {
+		marks[count++] = MarkInstance { 1.0f, 1.0f, LINE_ANTIDIAGONAL };
+	}
+
+	SetMarks(marks, count);
+}
+
+void MarkRenderer::Draw() const
+{
+	if (m_Marks.empty()) {
+		return;
+	}
+
+	glBindVertexArray(m_Vao);
+	glDrawElementsInstanced(
+		GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(m_Marks.size()));
+}
@@ -0,0 +1,64 @@
+#ifndef MARK_RENDERER_H
+#define MARK_RENDERER_H
+
+#include <vector>
+
+#include "rules.h"
+
+
+// What an instance draws. X and O match the values of board cells. A win
+// line is named by its direction, the diagonal running from the top left.
+enum MarkShape : u32 {
+	MARK_X = 1,
+	MARK_O,
+	LINE_ROW,
+	LINE_COLUMN,
+	LINE_DIAGONAL,
+	LINE_ANTIDIAGONAL
+};
+
+// One mark on the board, read by element-vshader.vs as instance attributes.
+struct MarkInstance {
+	float m_Column {};
+	float m_Row {};
+	u32   m_Mark {};    // a MarkShape
+};
+
+// Draws every mark of a board with one glDrawElementsInstanced. The quad is
+// shared and each mark only costs an instance: its cell and its shape,
+// which element-fshader-2.fs draws from a distance field. Marks stay sharp
+// at any window size and read no textures, so a board of thousands of
+// marks is still a single draw call.
+class MarkRenderer {
+public:
+	MarkRenderer();
+	~MarkRenderer();
+
+	MarkRenderer(const MarkRenderer&)            = delete;
+	MarkRenderer& operator=(const MarkRenderer&) = delete;
+
+	// Needs a current GL context.
+	void Init();
+
+	// Replaces the marks. The instance buffer is only written when they
+	// differ from the last call, and only reallocated when it has to grow.
+	void SetMarks(const MarkInstance* marks, u32 count);
+
+	// Collects the marks of a 3x3 board and a line through every row,
+	// column or diagonal it completes, and passes them to SetMarks().
+	void SetBoard(const i32 board[3][3]);
+
+	// With the mark shader in use.
+	void Draw() const;
+
+private:
+	unsigned int m_Vao;
+	unsigned int m_Quad;
+	unsigned int m_Indices;
+	unsigned int m_Instances;
+	u32          m_Capacity;
+
+	std::vector<MarkInstance> m_Marks;
+};
+
+#endif
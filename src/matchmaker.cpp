@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <iostream>
+
+#include "matchmaker.h"
+
+
+Matchmaker::Matchmaker(u32 slots, u32 bandWidth, u64 queueCapacity) :
+	m_BandWidth { bandWidth == 0 ? 1 : bandWidth },
+	m_Joins { queueCapacity },
+	m_Released { slots },
+	m_Restores { slots },
+	m_Slots(slots),
+	m_Running { false },
+	m_Matched {},
+	m_NextGameId { 1 }
+{
+	m_Free.reserve(slots);
+	for (u32 i = slots; i-- > 0;) {
+		m_Free.push_back(i);
+	}
+
+	m_Batch.reserve(BatchSize);
+}
+
+Matchmaker::~Matchmaker()
+{
+	Stop();
+}
+
+void Matchmaker::SetOnMatch(MatchCallback callback)
+{
+	m_OnMatch = std::move(callback);
+}
+
+void Matchmaker::SetGameIdFilter(GameIdFilter filter)
+{
+	m_GameIdFilter = std::move(filter);
+}
+
+void Matchmaker::SetOnRestore(MatchCallback callback)
+{
+	m_OnRestore = std::move(callback);
+}
+
+bool Matchmaker::Start()
+{
+	if (m_Thread.joinable()) {
+		return false;
+	}
+
+	m_Running = true;
+	m_Thread  = std::thread { &Matchmaker::Run, this };
+
+	return true;
+}
+
+void Matchmaker::Stop()
+{
+	m_Running = false;
+
+	if (m_Thread.joinable()) {
+		m_Thread.join();
+	}
+}
+
+bool Matchmaker::Join(JoinRequest request)
+{
+	request.m_Enqueued = NowNanoseconds();
+	return m_Joins.Push(request);
+}
+
+bool Matchmaker::Restore(const GameSlot& game)
+{
+	return m_Restores.Push(game);
+}
+
+void Matchmaker::Release(u32 slot)
+{
+	// Capacity equals the slot count, so this can only spin if a slot is
+	// released twice.
+	while (!m_Released.Push(slot)) {
+		std::this_thread::yield();
+	}
+}
+
+GameSlot& Matchmaker::Slot(u32 slot)
+{
+	return m_Slots[slot];
+}
+
+LatencyHistogram Matchmaker::Latency() const
+{
+	std::lock_guard lock { m_Mutex };
+	return m_Latency;
+}
+
+u64 Matchmaker::Matched() const
+{
+	return m_Matched.load(std::memory_order_relaxed);
+}
+
+void Matchmaker::Run()
+{
+	u32 idle {};
+
+	while (m_Running.load(std::memory_order_relaxed)) {
+		if (Drain()) {
+			idle = 0;
+		}
+		else if (++idle < 64) {
+			std::this_thread::yield();
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::microseconds(20));
+		}
+	}
+}
+
+bool Matchmaker::Drain()
+{
+	bool worked {};
+
+	u32 slot {};
+	while (m_Released.Pop(slot)) {
+		m_Free.push_back(slot);
+		worked = true;
+	}
+
+	// Restored games wait in their queue while every slot is taken.
+	GameSlot restored {};
+	while (!m_Free.empty() and m_Restores.Pop(restored)) {
+		const u32 free = m_Free.back();
+		m_Free.pop_back();
+
+		if (restored.m_GameId < m_NextGameId) {
+			restored.m_GameId = NextGameId();
+		}
+		else {
+			m_NextGameId = restored.m_GameId + 1;
+		}
+
+		m_Slots[free] = restored;
+		if (m_OnRestore) {
+			m_OnRestore(free);
+		}
+		worked = true;
+	}
+
+	m_Batch.clear();
+	if (!m_Free.empty()) {
+		m_Batch.swap(m_Deferred);
+	}
+
+	JoinRequest request {};
+	while (m_Batch.size() < BatchSize and m_Joins.Pop(request)) {
+		m_Batch.push_back(request);
+	}
+
+	if (m_Batch.empty()) {
+		if (m_Waiting.size() > 1) {
+			Widen(NowNanoseconds());
+		}
+		return worked;
+	}
+
+	// Engine games first, then human games grouped by rating band so that
+	// neighbours in the batch are already the best available pairs.
+	const auto key = [this](const JoinRequest& r) {
+		return r.m_Mode == SINGLE_P ? 0u : 1u + r.m_Rating / m_BandWidth;
+	};
+	std::stable_sort(
+		m_Batch.begin(),
+		m_Batch.end(),
+		[&key](const JoinRequest& a, const JoinRequest& b) {
+			return key(a) < key(b);
+		});
+
+	for (u64 i = 0; i < m_Batch.size(); ++i) {
+		const JoinRequest& current = m_Batch[i];
+
+		if (current.m_Mode == SINGLE_P) {
+			Pair(current, nullptr);
+			continue;
+		}
+
+		const u32 band = current.m_Rating / m_BandWidth;
+
+		if (i + 1 < m_Batch.size() and key(m_Batch[i + 1]) == key(current)) {
+			Pair(current, &m_Batch[i + 1]);
+			++i;
+		}
+		else if (auto waiting = m_Waiting.find(band); waiting != m_Waiting.end()) {
+			const JoinRequest first = waiting->second;
+			m_Waiting.erase(waiting);
+			Pair(first, &current);
+		}
+		else {
+			m_Waiting.emplace(band, current);
+		}
+	}
+
+	if (m_Waiting.size() > 1) {
+		Widen(NowNanoseconds());
+	}
+
+	return true;
+}
+
+void Matchmaker::Pair(const JoinRequest& first, const JoinRequest* second)
+{
+	if (m_Free.empty()) {
+		m_Deferred.push_back(first);
+		if (second != nullptr) {
+			m_Deferred.push_back(*second);
+		}
+		return;
+	}
+
+	const u32 slot = m_Free.back();
+	m_Free.pop_back();
+
+	GameSlot& game     = m_Slots[slot];
+	game.m_GameId      = NextGameId();
+	game.m_Mode        = first.m_Mode;
+	game.m_EngineDepth = first.m_EngineDepth;
+	game.m_Tenant      = first.m_Tenant;
+	game.m_Players[0]  = first.m_PlayerId;
+	game.m_Players[1]  = second != nullptr ? second->m_PlayerId : 0;
+	game.m_Restored    = 0;
+	game.m_Board.Reset();
+
+	const u64 now = NowNanoseconds();
+	{
+		std::lock_guard lock { m_Mutex };
+		m_Latency.Record(now - first.m_Enqueued);
+		if (second != nullptr) {
+			m_Latency.Record(now - second->m_Enqueued);
+		}
+	}
+
+	m_Matched.fetch_add(1, std::memory_order_relaxed);
+
+	if (m_OnMatch) {
+		m_OnMatch(slot);
+	}
+}
+
+u64 Matchmaker::NextGameId()
+{
+	while (m_GameIdFilter and !m_GameIdFilter(m_NextGameId)) {
+		++m_NextGameId;
+	}
+
+	return m_NextGameId++;
+}
+
+void Matchmaker::Widen(u64 now)
+{
+	std::vector<JoinRequest> lonely {};
+	lonely.reserve(m_Waiting.size());
+	for (const auto& [band, request] : m_Waiting) {
+		lonely.push_back(request);
+	}
+
+	std::sort(
+		lonely.begin(),
+		lonely.end(),
+		[](const JoinRequest& a, const JoinRequest& b) {
+			return a.m_Rating < b.m_Rating;
+		});
+
+	for (u64 i = 0; i + 1 < lonely.size(); ++i) {
+		const JoinRequest& a = lonely[i];
+		const JoinRequest& b = lonely[i + 1];
+
+		const u32 bandA = a.m_Rating / m_BandWidth;
+		const u32 bandB = b.m_Rating / m_BandWidth;
+		const bool old  = now - a.m_Enqueued > WidenAfter or
+						 now - b.m_Enqueued > WidenAfter;
+
+		if (bandB - bandA == 1 and old) {
+			m_Waiting.erase(bandA);
+			m_Waiting.erase(bandB);
+			Pair(a, &b);
+			++i;
+		}
+	}
+}
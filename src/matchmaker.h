@@ -0,0 +1,111 @@
+#ifndef MATCHMAKER_H
+#define MATCHMAKER_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "histogram.h"
+#include "mpsc_queue.h"
+#include "rules.h"
+
+
+struct JoinRequest {
+	u64      m_PlayerId {};
+	u32      m_Rating {};
+	GameMode m_Mode { MULTI_P };
+	u32      m_EngineDepth { PerfectDepth };    // SINGLE_P only
+	u32      m_Tenant {};                       // engine fair-share group
+	u64      m_Enqueued {};
+};
+
+// Pre-allocated home of a matched game. m_Players[1] is 0 when the opponent
+// is the engine.
+struct GameSlot {
+	u64      m_GameId {};
+	Board    m_Board {};
+	GameMode m_Mode { MULTI_P };
+	u64      m_Players[2] {};
+	u32      m_EngineDepth { PerfectDepth };
+	u32      m_Tenant {};
+	u64      m_Restored {};    // caller's ticket for games passed to Restore()
+};
+
+class Matchmaker {
+public:
+	using MatchCallback = std::function<void(u32 slot)>;
+	using GameIdFilter  = std::function<bool(u64 gameId)>;
+
+	Matchmaker(u32 slots, u32 bandWidth = 100, u64 queueCapacity = 1 << 16);
+	~Matchmaker();
+
+	Matchmaker(const Matchmaker&)            = delete;
+	Matchmaker& operator=(const Matchmaker&) = delete;
+
+	// Called before Start(), runs on the matcher thread for every pairing.
+	void SetOnMatch(MatchCallback callback);
+
+	// Called before Start(). Game IDs the filter rejects are skipped, so a
+	// shard only hands out IDs it owns.
+	void SetGameIdFilter(GameIdFilter filter);
+
+	// Called before Start(), runs on the matcher thread once a restored game
+	// has a slot.
+	void SetOnRestore(MatchCallback callback);
+
+	bool Start();
+	void Stop();
+
+	// Safe from any thread. Join() returns false when the ingestion queue is
+	// full and the request was not accepted.
+	bool      Join(JoinRequest request);
+
+	// Safe from any thread. Takes a game that started in another process.
+	// It keeps its ID unless this matchmaker may already have used it.
+	bool      Restore(const GameSlot& game);
+	void      Release(u32 slot);
+	GameSlot& Slot(u32 slot);
+
+	LatencyHistogram Latency() const;
+	u64              Matched() const;
+
+private:
+	static constexpr u32 BatchSize  = 4096;
+	static constexpr u64 WidenAfter = 200'000;    // ns before a lone player
+												  // may pair across bands
+
+	const u32 m_BandWidth;
+
+	MpscQueue<JoinRequest> m_Joins;
+	MpscQueue<u32>         m_Released;
+	MpscQueue<GameSlot>    m_Restores;
+	std::vector<GameSlot>  m_Slots;
+	MatchCallback          m_OnMatch;
+	MatchCallback          m_OnRestore;
+	GameIdFilter           m_GameIdFilter;
+
+	std::thread       m_Thread;
+	std::atomic<bool> m_Running;
+
+	mutable std::mutex m_Mutex;
+	LatencyHistogram   m_Latency;
+	std::atomic<u64>   m_Matched;
+
+	// Matcher thread state
+	std::vector<u32>                     m_Free;
+	std::vector<JoinRequest>             m_Batch;
+	std::unordered_map<u32, JoinRequest> m_Waiting;
+	std::vector<JoinRequest>             m_Deferred;
+	u64                                  m_NextGameId;
+
+	void Run();
+	bool Drain();
+	void Pair(const JoinRequest& first, const JoinRequest* second);
+	u64  NextGameId();
+	void Widen(u64 now);
+};
+
+#endif
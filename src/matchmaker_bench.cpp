@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "matchmaker.h"
+
+
+// Local load test for the matchmaker: paced producers push joins at a fixed
+// aggregate rate and the pairing latency distribution is printed at the end.
+//
+//     MatchmakerBench [joins/sec] [seconds] [producers]
+int main(int argc, char* argv[])
+{
+	const u64 rate      = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+	const u64 seconds   = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5;
+	const u32 producers = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 4;
+
+	if (rate == 0 or producers == 0) {
+		std::cerr << "Usage: MatchmakerBench [joins/sec] [seconds] [producers]"
+				  << std::endl;
+		return -1;
+	}
+
+	Matchmaker matchmaker { 1 << 16 };
+	matchmaker.SetOnMatch([&matchmaker](u32 slot) {
+		matchmaker.Release(slot);
+	});
+	matchmaker.Start();
+
+	std::atomic<u64>         rejected {};
+	std::vector<std::thread> threads {};
+
+	const u64 interval = 1'000'000'000ull * producers / rate;
+	const u64 start    = NowNanoseconds();
+	const u64 end      = start + seconds * 1'000'000'000ull;
+
+	for (u32 p = 0; p < producers; ++p) {
+		threads.emplace_back([&, p]() {
+			std::mt19937_64                    random { p + 1 };
+			std::uniform_int_distribution<u32> rating { 0, 2999 };
+			std::uniform_int_distribution<u32> percent { 0, 99 };
+
+			u64 next     = start + p * interval / producers;
+			u64 playerId = static_cast<u64>(p) << 40;
+
+			while (next < end) {
+				while (NowNanoseconds() < next) {
+					std::this_thread::yield();
+				}
+
+				JoinRequest request {};
+				request.m_PlayerId    = ++playerId;
+				request.m_Rating      = rating(random);
+				request.m_Mode        = percent(random) < 20 ? SINGLE_P : MULTI_P;
+				request.m_EngineDepth = percent(random) % (PerfectDepth + 1);
+
+				if (!matchmaker.Join(request)) {
+					rejected.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				next += interval;
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	matchmaker.Stop();
+
+	const double elapsed = (NowNanoseconds() - start) / 1e9;
+	const auto   latency = matchmaker.Latency();
+
+	std::cout << "Games matched: " << matchmaker.Matched() << " ("
+			  << latency.Count() / elapsed << " players/sec), rejected joins: "
+			  << rejected.load() << std::endl;
+	latency.Print(std::cout, "Pairing latency");
+
+	return latency.Percentile(99.0) < 1'000'000 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "net.h"
+#include "server.h"
+
+
+// Bulk migration test: a GameServer accepts sessions on a local socket and
+// this process plays the draining side, sending mid-game snapshots as fast
+// as the server takes them. Prints the transfer rate and the per-session
+// restore latency.
+//
+//     MigrationBench [sessions]
+int main(int argc, char* argv[])
+{
+	const u64 sessions = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+	if (sessions == 0) {
+		std::cerr << "Usage: MigrationBench [sessions]" << std::endl;
+		return -1;
+	}
+
+	GameServer server { static_cast<u32>(sessions + 1024) };
+	if (!server.AcceptMigrations("migration-bench")) {
+		return -1;
+	}
+
+	std::thread serving { [&server]() {
+		server.Run();
+	} };
+
+	const int link = ConnectLocal("migration-bench");
+	if (link == -1) {
+		server.Stop();
+		serving.join();
+		return -1;
+	}
+
+	// Human games a few moves in, so restored games wait for a RESUME and
+	// the engine stays idle.
+	std::mt19937_64 random { 1 };
+
+	const u64 start = NowNanoseconds();
+	u64       sent {};
+
+	for (u64 i = 0; i < sessions; ++i) {
+		SessionSnapshot session {};
+		session.m_GameId    = i + 1;
+		session.m_Sequence  = 4;
+		session.m_Tokens[0] = static_cast<u32>(random()) | 1;
+		session.m_Tokens[1] = static_cast<u32>(random()) | 1;
+		session.m_Waited    = random() % 1'000'000'000;
+
+		for (u32 move = 0; move < 3; ++move) {
+			u32 cell = random() % 9;
+			while (session.m_Board.m_Cells[cell / 3][cell % 3] != 0) {
+				cell = (cell + 1) % 9;
+			}
+			session.m_Board.Play(cell / 3, cell % 3);
+			session.m_History[move] = static_cast<unsigned char>(cell);
+		}
+
+		const auto data = EncodeSession(session);
+		if (send(link, data.data(), data.size(), MSG_NOSIGNAL) !=
+			static_cast<ssize_t>(data.size())) {
+			std::cerr << "send failed after " << sent << " sessions" << std::endl;
+			break;
+		}
+		++sent;
+	}
+
+	const u64 transferred = NowNanoseconds();
+
+	// Sessions the target had no room for never arrive, so give up once it
+	// stops making progress.
+	u64 received {};
+	u64 progress = NowNanoseconds();
+	while (received < sent and NowNanoseconds() - progress < 5'000'000'000) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		const u64 now = server.Migrations().m_Received.load();
+		if (now != received) {
+			received = now;
+			progress = NowNanoseconds();
+		}
+	}
+
+	const u64 restored = NowNanoseconds();
+
+	server.Stop();
+	serving.join();
+	close(link);
+
+	std::cout << "Sessions: " << received << "/" << sent << " (" << SessionSnapshot::EncodedSize
+			  << " bytes each)\n"
+			  << "Sent in " << (transferred - start) / 1'000'000 << " ms, all running after "
+			  << (restored - start) / 1'000'000 << " ms ("
+			  << sent * 1e9 / static_cast<double>(restored - start) << " sessions/s)"
+			  << std::endl;
+	server.Migrations().m_Restore.Print(std::cout, "restore");
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <bit>
+#include <memory>
+
+#include "rules.h"
+
+
+// Bounded lock-free queue for many producers and a single consumer (Vyukov's
+// sequence-numbered ring). Producers claim a slot with one CAS on the tail
+// and publish it by bumping the slot sequence, the consumer never writes to
+// shared counters other than the slot it just emptied.
+template <typename T>
+class MpscQueue {
+public:
+	explicit MpscQueue(u64 capacity) :
+		m_Mask { std::bit_ceil(capacity < 2 ? 2 : capacity) - 1 },
+		m_Cells { std::make_unique<Cell[]>(m_Mask + 1) }
+	{
+		for (u64 i = 0; i <= m_Mask; ++i) {
+			m_Cells[i].m_Sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Returns false when the queue is full, the caller decides whether to
+	// retry or shed the item.
+	bool Push(const T& value)
+	{
+		u64 position = m_Tail.load(std::memory_order_relaxed);
+
+		while (true) {
+			Cell&     cell     = m_Cells[position & m_Mask];
+			const u64 sequence = cell.m_Sequence.load(std::memory_order_acquire);
+			const i64 diff     = static_cast<i64>(sequence - position);
+
+			if (diff == 0) {
+				if (m_Tail.compare_exchange_weak(
+						position, position + 1, std::memory_order_relaxed)) {
+					cell.m_Value = value;
+					cell.m_Sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				position = m_Tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool Pop(T& value)
+	{
+		Cell&     cell     = m_Cells[m_Head & m_Mask];
+		const u64 sequence = cell.m_Sequence.load(std::memory_order_acquire);
+
+		if (sequence != m_Head + 1) {
+			return false;
+		}
+
+		value = cell.m_Value;
+		cell.m_Sequence.store(m_Head + m_Mask + 1, std::memory_order_release);
+		++m_Head;
+
+		return true;
+	}
+
+private:
+	struct Cell {
+		std::atomic<u64> m_Sequence;
+		T                m_Value;
+	};
+
+	const u64               m_Mask;
+	std::unique_ptr<Cell[]> m_Cells;
+
+	alignas(64) std::atomic<u64> m_Tail {};
+	alignas(64) u64 m_Head {};
+};
+
+#endif
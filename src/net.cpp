@@ -0,0 +1,252 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "net.h"
+
+
+int ListenTcp(u32 port, bool reusePort)
+{
+	const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		std::cerr << "socket failed: " << std::strerror(errno) << std::endl;
+		return -1;
+	}
+
+	const int enable = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+	if (reusePort) {
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+	}
+
+	sockaddr_in address {};
+	address.sin_family      = AF_INET;
+	address.sin_port        = htons(static_cast<uint16_t>(port));
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 or
+		listen(fd, SOMAXCONN) == -1) {
+		std::cerr << "Cannot listen on port " << port << ": "
+				  << std::strerror(errno) << std::endl;
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+u64 RaiseFileLimit()
+{
+	rlimit limit {};
+	if (getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+		std::cerr << "getrlimit failed: " << std::strerror(errno) << std::endl;
+		return 0;
+	}
+
+	if (limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		if (setrlimit(RLIMIT_NOFILE, &limit) == -1) {
+			std::cerr << "setrlimit failed: " << std::strerror(errno) << std::endl;
+			getrlimit(RLIMIT_NOFILE, &limit);
+		}
+	}
+
+	return limit.rlim_cur;
+}
+
+int ConnectTcp(const char* host, u32 port)
+{
+	const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		std::cerr << "socket failed: " << std::strerror(errno) << std::endl;
+		return -1;
+	}
+
+	sockaddr_in address {};
+	address.sin_family = AF_INET;
+	address.sin_port   = htons(static_cast<uint16_t>(port));
+
+	if (inet_pton(AF_INET, host, &address.sin_addr) != 1 or
+		connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	const int enable = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+	return fd;
+}
+
+bool SetNonBlocking(int fd)
+{
+	const int flags = fcntl(fd, F_GETFL);
+	return flags != -1 and fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+static socklen_t LocalAddress(const char* name, sockaddr_un& address)
+{
+	address            = sockaddr_un {};
+	address.sun_family = AF_UNIX;
+
+	// Leading NUL: abstract namespace, nothing to clean up on disk.
+	const int length = std::snprintf(
+		address.sun_path + 1, sizeof(address.sun_path) - 1, "tictactoe-%s", name);
+
+	return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + length);
+}
+
+static socklen_t HandoffAddress(u32 port, u32 index, sockaddr_un& address)
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%u-%u", port, index);
+
+	return LocalAddress(name, address);
+}
+
+int BindHandoff(u32 port, u32 index)
+{
+	const int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		std::cerr << "socket failed: " << std::strerror(errno) << std::endl;
+		return -1;
+	}
+
+	sockaddr_un     address {};
+	const socklen_t length = HandoffAddress(port, index, address);
+
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), length) == -1) {
+		std::cerr << "Cannot bind handoff socket " << index << ": "
+				  << std::strerror(errno) << std::endl;
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+bool SendHandoff(int socket, u32 port, u32 index, int fd, std::string_view data)
+{
+	sockaddr_un     address {};
+	const socklen_t length = HandoffAddress(port, index, address);
+
+	iovec iov {};
+	iov.iov_base = const_cast<char*>(data.data());
+	iov.iov_len  = data.size();
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+
+	msghdr message {};
+	message.msg_name       = &address;
+	message.msg_namelen    = length;
+	message.msg_iov        = &iov;
+	message.msg_iovlen     = 1;
+	message.msg_control    = control;
+	message.msg_controllen = sizeof(control);
+
+	cmsghdr* header    = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type  = SCM_RIGHTS;
+	header->cmsg_len   = CMSG_LEN(sizeof(int));
+	std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+	while (sendmsg(socket, &message, MSG_NOSIGNAL) == -1) {
+		if (errno != EINTR) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int ReceiveHandoff(int socket, std::string& data)
+{
+	char  buffer[8192];
+	iovec iov {};
+	iov.iov_base = buffer;
+	iov.iov_len  = sizeof(buffer);
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+
+	msghdr message {};
+	message.msg_iov        = &iov;
+	message.msg_iovlen     = 1;
+	message.msg_control    = control;
+
+	while (true) {
+		message.msg_controllen = sizeof(control);
+
+		const ssize_t size = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+		if (size == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+
+		const cmsghdr* header = CMSG_FIRSTHDR(&message);
+		if (header == nullptr or header->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+
+		int fd {};
+		std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+
+		data.assign(buffer, static_cast<u64>(size));
+		return fd;
+	}
+}
+
+int ListenLocal(const char* name)
+{
+	const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		std::cerr << "socket failed: " << std::strerror(errno) << std::endl;
+		return -1;
+	}
+
+	sockaddr_un     address {};
+	const socklen_t length = LocalAddress(name, address);
+
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), length) == -1 or
+		listen(fd, SOMAXCONN) == -1) {
+		std::cerr << "Cannot listen on " << name << ": " << std::strerror(errno)
+				  << std::endl;
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int ConnectLocal(const char* name)
+{
+	const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		std::cerr << "socket failed: " << std::strerror(errno) << std::endl;
+		return -1;
+	}
+
+	sockaddr_un     address {};
+	const socklen_t length = LocalAddress(name, address);
+
+	if (connect(fd, reinterpret_cast<sockaddr*>(&address), length) == -1) {
+		std::cerr << "Cannot connect to " << name << ": " << std::strerror(errno)
+				  << std::endl;
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
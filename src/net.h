@@ -0,0 +1,38 @@
+#ifndef NET_H
+#define NET_H
+
+#include <string>
+#include <string_view>
+
+#include "rules.h"
+
+
+// Small POSIX socket helpers shared by the hosting tools. All of them print
+// the reason to std::cerr and return -1 on failure.
+int ListenTcp(u32 port, bool reusePort = false);
+int ConnectTcp(const char* host, u32 port);
+
+bool SetNonBlocking(int fd);
+
+// Lifts the soft descriptor limit to the hard one, since the default 1024
+// caps a process at about a thousand sockets. Returns the limit now in
+// effect, 0 when it cannot be read.
+u64 RaiseFileLimit();
+
+// Unix datagram sockets in the abstract namespace, used to pass accepted
+// connections between processes of one host. The name is derived from
+// the server port and index so a restarted process binds the same one.
+int  BindHandoff(u32 port, u32 index);
+bool SendHandoff(int socket, u32 port, u32 index, int fd, std::string_view data);
+
+// Returns the received descriptor with data filled in, or -1 when nothing
+// is pending.
+int ReceiveHandoff(int socket, std::string& data);
+
+// Message-oriented local stream (SOCK_SEQPACKET) in the abstract namespace,
+// used to move sessions between server processes. The listener is
+// non-blocking, connected sockets are blocking.
+int ListenLocal(const char* name);
+int ConnectLocal(const char* name);
+
+#endif
@@ -0,0 +1,513 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <queue>
+
+#include "file_io.h"
+#include "game_codec.h"
+#include "position_index.h"
+
+
+static constexpr unsigned char Magic[8] = { 'T', 'T', 'T', 'P', 'I', 'D', 'X', '1' };
+
+static constexpr u32 Positions  = 19683;    // 3^9
+static constexpr u64 BufferSize = 1 << 20;
+
+struct IndexHeader {
+	unsigned char m_Magic[8];
+	u64           m_Positions;
+	u64           m_Games;
+	u64           m_Entries;    // offset of the PositionEntry table
+};
+
+static u32 Power(u32 cell)
+{
+	static constexpr std::array<u32, 9> powers { 1, 3, 9, 27, 81, 243, 729, 2187, 6561 };
+	return powers[cell];
+}
+
+static std::array<u32, Positions> MakeCanonicalTable()
+{
+	// Where each cell goes under the eight rotations and reflections.
+	std::array<std::array<u32, 9>, 8> symmetries {};
+	for (u32 cell = 0; cell < 9; ++cell) {
+		u32 row = cell / 3;
+		u32 col = cell % 3;
+
+		for (u32 s = 0; s < 4; ++s) {
+			symmetries[s][cell]     = row * 3 + col;
+			symmetries[s + 4][cell] = row * 3 + (2 - col);
+
+			const u32 rotated = col;
+			col               = 2 - row;
+			row               = rotated;
+		}
+	}
+
+	std::array<u32, Positions> table {};
+	for (u32 index = 0; index < Positions; ++index) {
+		u32 best = index;
+
+		for (const auto& symmetry : symmetries) {
+			u32 image {};
+			for (u32 cell = 0; cell < 9; ++cell) {
+				image += index / Power(cell) % 3 * Power(symmetry[cell]);
+			}
+			best = std::min(best, image);
+		}
+
+		table[index] = best;
+	}
+
+	return table;
+}
+
+static u32 Canonical(u32 index)
+{
+	static const std::array<u32, Positions> table = MakeCanonicalTable();
+	return table[index];
+}
+
+u32 CanonicalPosition(const i32 cells[3][3])
+{
+	u32 index {};
+	for (u32 cell = 0; cell < 9; ++cell) {
+		index += static_cast<u32>(cells[cell / 3][cell % 3] % 3) * Power(cell);
+	}
+
+	return Canonical(index);
+}
+
+PostingList::PostingList(const unsigned char* data, u64 size) :
+	m_Data { data },
+	m_Size { size },
+	m_Offset {},
+	m_Last {}
+{
+}
+
+bool PostingList::Next(u64& gameId)
+{
+	u64 delta {};
+	if (m_Offset == m_Size or !ReadVarint(m_Data, m_Size, m_Offset, delta)) {
+		return false;
+	}
+
+	m_Last += delta;
+	gameId = m_Last;
+	return true;
+}
+
+PositionIndex::PositionIndex() :
+	m_Map { nullptr },
+	m_MapSize {},
+	m_Entries { nullptr },
+	m_Positions {},
+	m_Games {}
+{
+}
+
+PositionIndex::~PositionIndex()
+{
+	Close();
+}
+
+bool PositionIndex::Open(const char* path)
+{
+	const int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		std::cerr << "PositionIndex: cannot open " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		return false;
+	}
+
+	struct stat status {};
+	if (fstat(fd, &status) == -1 or static_cast<u64>(status.st_size) < sizeof(IndexHeader)) {
+		std::cerr << "PositionIndex: " << path << " is not a position index" << std::endl;
+		close(fd);
+		return false;
+	}
+
+	const u64 size   = static_cast<u64>(status.st_size);
+	void*     memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED) {
+		std::cerr << "PositionIndex: mmap failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	m_Map     = static_cast<const unsigned char*>(memory);
+	m_MapSize = size;
+
+	IndexHeader header {};
+	std::memcpy(&header, m_Map, sizeof(header));
+
+	const bool fits = header.m_Entries % alignof(PositionEntry) == 0 and
+					  header.m_Entries <= size and
+					  header.m_Positions <= (size - header.m_Entries) / sizeof(PositionEntry);
+
+	if (std::memcmp(header.m_Magic, Magic, sizeof(Magic)) != 0 or !fits) {
+		std::cerr << "PositionIndex: " << path << " is not a position index" << std::endl;
+		Close();
+		return false;
+	}
+
+	m_Entries   = reinterpret_cast<const PositionEntry*>(m_Map + header.m_Entries);
+	m_Positions = header.m_Positions;
+	m_Games     = header.m_Games;
+
+	for (u64 i = 0; i < m_Positions; ++i) {
+		const PositionEntry& entry = m_Entries[i];
+		if (entry.m_Offset > header.m_Entries or entry.m_Size > header.m_Entries - entry.m_Offset or
+			(i > 0 and m_Entries[i - 1].m_Key >= entry.m_Key)) {
+			std::cerr << "PositionIndex: " << path << " is damaged" << std::endl;
+			Close();
+			return false;
+		}
+	}
+
+	madvise(memory, size, MADV_RANDOM);
+
+	return true;
+}
+
+void PositionIndex::Close()
+{
+	if (m_Map != nullptr) {
+		munmap(const_cast<unsigned char*>(m_Map), m_MapSize);
+	}
+
+	m_Map       = nullptr;
+	m_MapSize   = 0;
+	m_Entries   = nullptr;
+	m_Positions = 0;
+	m_Games     = 0;
+}
+
+const PositionEntry* PositionIndex::Find(const i32 cells[3][3]) const
+{
+	return Find(CanonicalPosition(cells));
+}
+
+const PositionEntry* PositionIndex::Find(u32 key) const
+{
+	const PositionEntry* end   = m_Entries + m_Positions;
+	const PositionEntry* entry = std::lower_bound(
+		m_Entries, end, key, [](const PositionEntry& e, u32 k) { return e.m_Key < k; });
+
+	return entry != end and entry->m_Key == key ? entry : nullptr;
+}
+
+PostingList PositionIndex::Games(const PositionEntry& entry) const
+{
+	return PostingList { m_Map + entry.m_Offset, entry.m_Size };
+}
+
+const PositionEntry* PositionIndex::Entries() const
+{
+	return m_Entries;
+}
+
+u64 PositionIndex::Positions() const
+{
+	return m_Positions;
+}
+
+u64 PositionIndex::GameCount() const
+{
+	return m_Games;
+}
+
+PositionIndexBuilder::PositionIndexBuilder(u32 threads, u64 runPairs) :
+	m_Threads { std::max(threads, 1u) },
+	m_RunPairs { std::max<u64>(runPairs, 16) },
+	m_Games {},
+	m_Failed { false }
+{
+}
+
+PositionIndexBuilder::~PositionIndexBuilder()
+{
+	JoinSpills(0);
+
+	for (const auto& path : m_RunPaths) {
+		unlink(path.c_str());
+	}
+}
+
+bool PositionIndexBuilder::Open(const char* path)
+{
+	m_Path = path;
+	m_Run.reserve(m_RunPairs);
+
+	return true;
+}
+
+void PositionIndexBuilder::Add(const GameRecord& record)
+{
+	const auto push = [this, &record](u32 index) {
+		if (m_Run.size() == m_RunPairs) {
+			StartSpill();
+		}
+		m_Run.push_back(
+			Pair { Canonical(index), static_cast<u32>(record.m_Winner + 1), record.m_GameId });
+	};
+
+	u32  index {};
+	bool taken[9] {};
+	push(index);
+
+	for (u32 i = 0; i < record.m_Moves and i < 9; ++i) {
+		const u32 cell = record.m_History[i];
+		if (cell > 8 or taken[cell]) {
+			break;
+		}
+
+		taken[cell] = true;
+		index += (i % 2 == 0 ? 1 : 2) * Power(cell);
+		push(index);
+	}
+
+	++m_Games;
+}
+
+bool PositionIndexBuilder::Finish()
+{
+	if (!m_Run.empty()) {
+		StartSpill();
+	}
+
+	const bool spilled = JoinSpills(0);
+	const bool merged  = spilled and !m_Failed and Merge();
+
+	for (const auto& path : m_RunPaths) {
+		unlink(path.c_str());
+	}
+
+	return merged;
+}
+
+u64 PositionIndexBuilder::Games() const
+{
+	return m_Games;
+}
+
+u64 PositionIndexBuilder::Runs() const
+{
+	return m_RunPaths.size();
+}
+
+// Hands the current run to a sorting thread, first waiting for the oldest
+// one when all threads are busy.
+void PositionIndexBuilder::StartSpill()
+{
+	if (!JoinSpills(m_Threads - 1)) {
+		m_Failed = true;
+	}
+
+	m_RunPaths.push_back(m_Path + ".run" + std::to_string(m_RunPaths.size()));
+
+	auto spill      = std::make_unique<Spill>();
+	Spill* raw      = spill.get();
+	raw->m_Thread   = std::thread { [raw, path = m_RunPaths.back(), run = std::move(m_Run)]() mutable {
+		raw->m_Ok = WriteRun(path, run);
+	} };
+	m_Spills.push_back(std::move(spill));
+
+	m_Run = std::vector<Pair> {};
+	m_Run.reserve(m_RunPairs);
+}
+
+// Joins spills until at most keep are still running, false if any of them
+// failed.
+bool PositionIndexBuilder::JoinSpills(u64 keep)
+{
+	bool ok = true;
+
+	while (m_Spills.size() > keep) {
+		m_Spills.front()->m_Thread.join();
+		ok = ok and m_Spills.front()->m_Ok;
+		m_Spills.erase(m_Spills.begin());
+	}
+
+	return ok;
+}
+
+bool PositionIndexBuilder::WriteRun(const std::string& path, std::vector<Pair>& run)
+{
+	std::sort(run.begin(), run.end(), [](const Pair& a, const Pair& b) {
+		return a.m_Key != b.m_Key ? a.m_Key < b.m_Key : a.m_GameId < b.m_GameId;
+	});
+
+	const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		std::cerr << "PositionIndex: cannot create " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		return false;
+	}
+
+	const bool ok = WriteAll(fd, run.data(), run.size() * sizeof(Pair), "PositionIndex");
+	close(fd);
+
+	return ok;
+}
+
+// K-way merge of the sorted runs. Posting lists stream out as the merge
+// produces them, and the entry table follows once every key has been seen.
+bool PositionIndexBuilder::Merge()
+{
+	struct Reader {
+		int               m_File { -1 };
+		std::vector<Pair> m_Buffer;
+		u64               m_Offset {};
+		u64               m_Size {};
+		bool              m_Error {};
+	};
+
+	const u64           readerPairs = std::max<u64>(BufferSize / sizeof(Pair), 1);
+	std::vector<Reader> readers(m_RunPaths.size());
+
+	const auto fill = [readerPairs](Reader& reader) {
+		reader.m_Buffer.resize(readerPairs);
+		reader.m_Offset = 0;
+		reader.m_Size   = 0;
+
+		u64 bytes {};
+		while (bytes < readerPairs * sizeof(Pair)) {
+			const ssize_t size = read(reader.m_File,
+									  reinterpret_cast<unsigned char*>(reader.m_Buffer.data()) + bytes,
+									  readerPairs * sizeof(Pair) - bytes);
+			if (size == -1 and errno == EINTR) {
+				continue;
+			}
+			if (size == -1) {
+				std::cerr << "PositionIndex: read failed: " << std::strerror(errno) << std::endl;
+				reader.m_Error = true;
+			}
+			if (size <= 0) {
+				break;
+			}
+			bytes += static_cast<u64>(size);
+		}
+
+		reader.m_Size = bytes / sizeof(Pair);
+		return reader.m_Size > 0;
+	};
+
+	using Head = std::pair<Pair, u32>;
+	const auto later = [](const Head& a, const Head& b) {
+		return a.first.m_Key != b.first.m_Key ? a.first.m_Key > b.first.m_Key
+											  : a.first.m_GameId > b.first.m_GameId;
+	};
+	std::priority_queue<Head, std::vector<Head>, decltype(later)> heads { later };
+
+	bool ok = true;
+	for (u32 i = 0; i < readers.size(); ++i) {
+		readers[i].m_File = open(m_RunPaths[i].c_str(), O_RDONLY | O_CLOEXEC);
+		if (readers[i].m_File == -1) {
+			std::cerr << "PositionIndex: cannot open " << m_RunPaths[i] << ": "
+					  << std::strerror(errno) << std::endl;
+			ok = false;
+			break;
+		}
+		posix_fadvise(readers[i].m_File, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+		if (fill(readers[i])) {
+			heads.push({ readers[i].m_Buffer[0], i });
+		}
+	}
+
+	const int fd = ok ? CreateTemporary(m_Path, "PositionIndex") : -1;
+	ok           = ok and fd != -1;
+
+	std::vector<PositionEntry> entries {};
+	std::vector<unsigned char> out(sizeof(IndexHeader));
+	u64                        written {};
+	u64                        last {};
+
+	while (ok and !heads.empty()) {
+		const auto [pair, run] = heads.top();
+		heads.pop();
+
+		Reader& reader = readers[run];
+		if (++reader.m_Offset < reader.m_Size or fill(reader)) {
+			heads.push({ reader.m_Buffer[reader.m_Offset], run });
+		}
+
+		const u64 offset = written + out.size();
+		if (entries.empty() or entries.back().m_Key != pair.m_Key) {
+			if (!entries.empty()) {
+				entries.back().m_Size = offset - entries.back().m_Offset;
+			}
+
+			entries.push_back(PositionEntry {});
+			entries.back().m_Key    = pair.m_Key;
+			entries.back().m_Offset = offset;
+			last                    = 0;
+		}
+
+		PositionEntry& entry = entries.back();
+		++entry.m_Games;
+		entry.m_XWins += pair.m_Winner == Utility::X + 1;
+		entry.m_OWins += pair.m_Winner == Utility::O + 1;
+		entry.m_Draws += pair.m_Winner == Utility::T + 1;
+
+		WriteVarint(pair.m_GameId - last, out);
+		last = pair.m_GameId;
+
+		if (out.size() >= BufferSize) {
+			ok = WriteAll(fd, out.data(), out.size(), "PositionIndex");
+			written += out.size();
+			out.clear();
+		}
+	}
+
+	for (auto& reader : readers) {
+		if (reader.m_File != -1) {
+			close(reader.m_File);
+		}
+		ok = ok and !reader.m_Error;
+	}
+
+	if (!ok) {
+		if (fd != -1) {
+			close(fd);
+			unlink((m_Path + ".tmp").c_str());
+		}
+		return false;
+	}
+
+	const u64 postings = written + out.size();
+	if (!entries.empty()) {
+		entries.back().m_Size = postings - entries.back().m_Offset;
+	}
+
+	// The table is read in place, so it starts on an entry boundary.
+	out.resize(out.size() + (alignof(PositionEntry) - postings % alignof(PositionEntry)) %
+								alignof(PositionEntry));
+
+	IndexHeader header {};
+	std::memcpy(header.m_Magic, Magic, sizeof(Magic));
+	header.m_Positions = entries.size();
+	header.m_Games     = m_Games;
+	header.m_Entries   = written + out.size();
+
+	if (written == 0) {
+		std::memcpy(out.data(), &header, sizeof(header));
+	}
+
+	ok = WriteAll(fd, out.data(), out.size(), "PositionIndex") and
+		 WriteAll(fd, entries.data(), entries.size() * sizeof(PositionEntry), "PositionIndex") and
+		 (written == 0 or pwrite(fd, &header, sizeof(header), 0) == sizeof(header)) and
+		 fdatasync(fd) == 0;
+
+	return ReplaceWithTemporary(fd, m_Path, ok, "PositionIndex");
+}
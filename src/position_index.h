@@ -0,0 +1,137 @@
+#ifndef POSITION_INDEX_H
+#define POSITION_INDEX_H
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "journal.h"
+
+
+// Base-3 number of a board (X = 1, O = 2, cell row * 3 + col being digit
+// cell), reduced to the smallest over the board's eight symmetries.
+u32 CanonicalPosition(const i32 cells[3][3]);
+
+// One position in a PositionIndex. Counts are over the games that passed
+// through it, each game counted once.
+struct PositionEntry {
+	u32 m_Key {};
+	u32 m_Reserved {};
+	u64 m_Games {};
+	u64 m_XWins {};
+	u64 m_OWins {};
+	u64 m_Draws {};
+	u64 m_Offset {};    // of the posting list, from the start of the file
+	u64 m_Size {};      // posting list bytes
+};
+
+// Game IDs of one position in ascending order, decoded straight from the
+// mapping as varint deltas.
+class PostingList {
+public:
+	PostingList(const unsigned char* data = nullptr, u64 size = 0);
+
+	bool Next(u64& gameId);
+
+private:
+	const unsigned char* m_Data;
+	u64                  m_Size;
+	u64                  m_Offset;
+	u64                  m_Last;
+};
+
+// Read-only index from canonical position to the games that reached it. The
+// file is
+//
+//     header (magic, positions, games, entry table offset)
+//     posting lists
+//     PositionEntry table sorted by key
+//
+// and is used in place through mmap, so opening costs nothing beyond the
+// header check and a lookup is a binary search over the table.
+class PositionIndex {
+public:
+	PositionIndex();
+	~PositionIndex();
+
+	PositionIndex(const PositionIndex&)            = delete;
+	PositionIndex& operator=(const PositionIndex&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	// Null when no indexed game reached the position.
+	const PositionEntry* Find(const i32 cells[3][3]) const;
+	const PositionEntry* Find(u32 key) const;
+
+	PostingList Games(const PositionEntry& entry) const;
+
+	const PositionEntry* Entries() const;
+	u64                  Positions() const;
+	u64                  GameCount() const;
+
+private:
+	const unsigned char* m_Map;
+	u64                  m_MapSize;
+	const PositionEntry* m_Entries;
+	u64                  m_Positions;
+	u64                  m_Games;
+};
+
+// Builds a PositionIndex with an external sort. Added games are replayed
+// into (position, game) pairs that fill fixed-size runs; each full run is
+// sorted on a thread of its own and spilled to a temporary file next to the
+// index, and Finish() merges the runs into posting lists. Memory stays at
+// about threads + 1 runs however many games go in.
+class PositionIndexBuilder {
+public:
+	static constexpr u64 RunPairs = 1 << 21;
+
+	PositionIndexBuilder(u32 threads = 1, u64 runPairs = RunPairs);
+	~PositionIndexBuilder();
+
+	PositionIndexBuilder(const PositionIndexBuilder&)            = delete;
+	PositionIndexBuilder& operator=(const PositionIndexBuilder&) = delete;
+
+	bool Open(const char* path);
+
+	// Moves after an illegal one are ignored.
+	void Add(const GameRecord& record);
+
+	// Writes the index, false on any failure along the way.
+	bool Finish();
+
+	u64 Games() const;
+	u64 Runs() const;
+
+private:
+	struct Pair {
+		u32 m_Key;
+		u32 m_Winner;    // Utility + 1
+		u64 m_GameId;
+	};
+
+	struct Spill {
+		std::thread m_Thread;
+		bool        m_Ok {};
+	};
+
+	std::string       m_Path;
+	u32               m_Threads;
+	u64               m_RunPairs;
+	u64               m_Games;
+	bool              m_Failed;
+	std::vector<Pair> m_Run;
+
+	std::vector<std::string>            m_RunPaths;
+	std::vector<std::unique_ptr<Spill>> m_Spills;
+
+	void StartSpill();
+	bool JoinSpills(u64 keep);
+	bool Merge();
+
+	static bool WriteRun(const std::string& path, std::vector<Pair>& run);
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "game_codec.h"
+#include "position_index.h"
+
+
+struct Expected {
+	u64 m_Games {};
+	u64 m_XWins {};
+	u64 m_OWins {};
+	u64 m_Draws {};
+	u64 m_IdSum {};
+};
+
+// Writes a journal of random games, builds the index from it with small runs
+// so the external merge does real work, then checks every entry against
+// counts kept in memory and times position lookups.
+//
+//     PositionIndexBench [games] [threads] [path]
+int main(int argc, char* argv[])
+{
+	const u64   games   = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+	const u32   threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2;
+	const char* path    = argc > 3 ? argv[3] : "index-bench";
+
+	if (games == 0 or threads == 0) {
+		std::cerr << "Usage: PositionIndexBench [games] [threads] [path]" << std::endl;
+		return -1;
+	}
+
+	const std::string journalPath = std::string { path } + ".journal";
+	const std::string indexPath   = std::string { path } + ".index";
+	unlink(journalPath.c_str());
+
+	const GameRanking&                      ranking = GameRanking::Get();
+	std::unordered_map<u32, Expected>       expected {};
+	std::vector<std::vector<unsigned char>> openings {};
+	std::mt19937_64                         random { 1 };
+
+	GameJournal journal {};
+	if (!journal.Open(journalPath.c_str())) {
+		return -1;
+	}
+
+	for (u64 i = 0; i < games; ++i) {
+		GameRecord record {};
+		record.m_Time   = UnixNanoseconds();
+		record.m_GameId = i + 1;
+
+		// Complete games, uniformly over the game tree.
+		record.m_Moves  = ranking.Unrank(static_cast<u32>(random() % GameRanking::CompleteGames),
+										 record.m_History);
+		record.m_Winner = ranking.Winner(record.m_History, record.m_Moves);
+		journal.Append(record);
+
+		Board board {};
+		for (u32 move = 0; move <= record.m_Moves; ++move) {
+			Expected& counts = expected[CanonicalPosition(board.m_Cells)];
+			++counts.m_Games;
+			counts.m_XWins += record.m_Winner == Utility::X;
+			counts.m_OWins += record.m_Winner == Utility::O;
+			counts.m_Draws += record.m_Winner == Utility::T;
+			counts.m_IdSum += record.m_GameId;
+
+			if (move < record.m_Moves) {
+				board.Play(record.m_History[move] / 3, record.m_History[move] % 3);
+			}
+		}
+
+		if (openings.size() < 4'096) {
+			openings.emplace_back(record.m_History, record.m_History + 1 + random() % 4);
+		}
+	}
+
+	journal.Sync();
+	journal.Close();
+
+	const u64            start = NowNanoseconds();
+	PositionIndexBuilder builder { threads, games };
+	builder.Open(indexPath.c_str());
+
+	GameJournal::Scan(journalPath.c_str(), [&builder](const GameRecord& record) {
+		builder.Add(record);
+	});
+
+	if (!builder.Finish()) {
+		return -1;
+	}
+	const u64 built = NowNanoseconds() - start;
+
+	PositionIndex index {};
+	if (!index.Open(indexPath.c_str())) {
+		return -1;
+	}
+
+	u64 failures {};
+	u64 postings {};
+	u64 bytes {};
+
+	for (u64 i = 0; i < index.Positions(); ++i) {
+		const PositionEntry& entry  = index.Entries()[i];
+		const auto           wanted = expected.find(entry.m_Key);
+
+		PostingList list = index.Games(entry);
+		u64         gameId {};
+		u64         previous {};
+		u64         count {};
+		u64         sum {};
+		while (list.Next(gameId)) {
+			failures += gameId < previous;
+			previous = gameId;
+			sum += gameId;
+			++count;
+		}
+		postings += entry.m_Games;
+		bytes += entry.m_Size;
+
+		if (wanted == expected.end() or wanted->second.m_Games != entry.m_Games or
+			wanted->second.m_XWins != entry.m_XWins or wanted->second.m_OWins != entry.m_OWins or
+			wanted->second.m_Draws != entry.m_Draws or wanted->second.m_IdSum != sum or
+			count != entry.m_Games) {
+			++failures;
+		}
+	}
+	failures += index.Positions() != expected.size();
+
+	// Lookups of early positions, each reading the first 100 game IDs.
+	LatencyHistogram lookups {};
+	u64              checksum {};
+
+	for (u32 round = 0; round < 100'000; ++round) {
+		const auto& moves = openings[round % openings.size()];
+		const u64   begin = NowNanoseconds();
+
+		Board board {};
+		for (const unsigned char cell : moves) {
+			board.Play(cell / 3, cell % 3);
+		}
+
+		if (const PositionEntry* entry = index.Find(board.m_Cells); entry != nullptr) {
+			PostingList list = index.Games(*entry);
+			u64         gameId {};
+			for (u32 i = 0; i < 100 and list.Next(gameId); ++i) {
+				checksum += gameId;
+			}
+		}
+
+		lookups.Record(NowNanoseconds() - begin);
+	}
+
+	std::cout << "Indexed " << builder.Games() << " games (" << builder.Runs() << " runs) in "
+			  << built / 1'000'000 << " ms: " << index.Positions() << " positions, "
+			  << static_cast<double>(bytes) / static_cast<double>(postings)
+			  << " bytes per posting, " << failures << " mismatches" << std::endl;
+	lookups.Print(std::cout, "lookup");
+	std::cout << "Checksum " << checksum << std::endl;
+
+	index.Close();
+	unlink(journalPath.c_str());
+	unlink(indexPath.c_str());
+
+	return failures == 0 ? 0 : -1;
+}
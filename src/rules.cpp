@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <limits>
+
+#include "rules.h"
+
+
+bool Board::Play(u32 row, u32 col)
+{
+	if (m_State == GAME_OVER or row > 2 or col > 2 or m_Cells[row][col] != 0) {
+		return false;
+	}
+
+	m_Cells[row][col] = m_Player1Turn ? 1 : 2;
+	m_Player1Turn     = !m_Player1Turn;
+	++m_Moves;
+
+	if (m_Winner = CheckWinner(m_Cells); m_Winner != Utility::T) {
+		m_State = GAME_OVER;
+	}
+	else if (m_Moves == 9) {
+		m_State = GAME_OVER;
+	}
+
+	return true;
+}
+
+void Board::Reset()
+{
+	*this = Board {};
+}
+
+Utility CheckWinner(const i32 board[3][3])
+{
+	for (u32 i = 0; i < 3; ++i) {
+		if (board[i][0] != 0 and board[i][0] == board[i][1] and board[i][0] == board[i][2]) {
+			return board[i][0] == 1 ? Utility::X : Utility::O;
+		}
+		if (board[0][i] != 0 and board[0][i] == board[1][i] and board[0][i] == board[2][i]) {
+			return board[0][i] == 1 ? Utility::X : Utility::O;
+		}
+	}
+
+	if (board[0][0] != 0 and board[0][0] == board[1][1] and
+		board[0][0] == board[2][2]) {
+		return board[0][0] == 1 ? Utility::X : Utility::O;
+	}
+	if (board[2][0] != 0 and board[2][0] == board[1][1] and
+		board[2][0] == board[0][2]) {
+		return board[2][0] == 1 ? Utility::X : Utility::O;
+	}
+
+	return Utility::T;
+}
+
+i32 Minimax(i32 board[3][3], u32 depth, bool isMax, u32 maxDepth)
+{
+	if (auto temp = CheckWinner(board); temp != Utility::T) {
+		return temp;
+	}
+
+	if (depth >= maxDepth) {
+		return Utility::T;
+	}
+
+	i32 bestUtilVal = isMax ? std::numeric_limits<i32>::min()
+							: std::numeric_limits<i32>::max();
+	bool moved {};
+
+	for (u32 i = 0; i < 3; ++i) {
+		for (u32 j = 0; j < 3; ++j) {
+			if (board[i][j] != 0) {
+				continue;
+			}
+
+			board[i][j]        = isMax ? 1 : 2;
+			const auto utilVal = Minimax(board, depth + 1, !isMax, maxDepth);
+			board[i][j]        = 0;
+			moved              = true;
+
+			bestUtilVal = isMax ? std::max(utilVal, bestUtilVal)
+								: std::min(utilVal, bestUtilVal);
+		}
+	}
+
+	return moved ? bestUtilVal : Utility::T;
+}
+
+std::pair<i32, i32> FindBestMove(i32 board[3][3], i32 mark, u32 maxDepth)
+{
+	const bool maximizing = mark == 1;
+
+	i32 bestUtilVal = maximizing ? std::numeric_limits<i32>::min()
+								 : std::numeric_limits<i32>::max();
+	std::pair<i32, i32> currentMove { -1, -1 };
+
+	for (i32 i = 0; i < 3; ++i) {
+		for (i32 j = 0; j < 3; ++j) {
+			if (board[i][j] != 0) {
+				continue;
+			}
+
+			board[i][j]        = mark;
+			const auto utilVal = Minimax(board, 1, !maximizing, maxDepth);
+			board[i][j]        = 0;
+
+			if (maximizing ? utilVal > bestUtilVal : utilVal < bestUtilVal) {
+				bestUtilVal        = utilVal;
+				currentMove.first  = i;
+				currentMove.second = j;
+			}
+		}
+	}
+
+	return currentMove;
+}
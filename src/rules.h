@@ -0,0 +1,52 @@
+#ifndef RULES_H
+#define RULES_H
+
+
+#include <cstdint>
+#include <utility>
+
+
+using i32 = std::int32_t;
+using u32 = std::uint32_t;
+using i64 = std::int64_t;
+using u64 = std::uint64_t;
+
+enum GameState {
+	GAME_MENU,
+	GAME_INPROGRESS,
+	GAME_OVER
+};
+
+enum GameMode {
+	SINGLE_P,
+	MULTI_P
+};
+
+enum Utility {
+	O = -1,
+	T,
+	X
+};
+
+// Search depth at which the engine plays perfectly, lower depths give weaker
+// opponents.
+constexpr u32 PerfectDepth = 9;
+
+// Headless copy of the game state for hosted sessions. Cells hold 0 for
+// empty, 1 for player one (X) and 2 for player two (O), as in Game.
+struct Board {
+	i32       m_Cells[3][3] {};
+	u32       m_Moves {};
+	bool      m_Player1Turn { true };
+	Utility   m_Winner { Utility::T };
+	GameState m_State { GAME_INPROGRESS };
+
+	bool Play(u32 row, u32 col);
+	void Reset();
+};
+
+Utility             CheckWinner(const i32 board[3][3]);
+i32                 Minimax(i32 board[3][3], u32 depth, bool isMax, u32 maxDepth);
+std::pair<i32, i32> FindBestMove(i32 board[3][3], i32 mark, u32 maxDepth);
+
+#endif
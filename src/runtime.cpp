@@ -0,0 +1,325 @@
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#include "runtime.h"
+
+
+namespace {
+
+constexpr u64 FrameGranularity = 64;
+constexpr u64 FrameClasses     = 32;
+
+struct FramePool {
+	std::vector<void*> m_Free[FrameClasses + 1];
+	FrameStats         m_Stats;
+
+	~FramePool()
+	{
+		for (auto& list : m_Free) {
+			for (void* frame : list) {
+				::operator delete(frame);
+			}
+		}
+	}
+};
+
+thread_local FramePool t_Frames {};
+
+}    // namespace
+
+void Task::promise_type::unhandled_exception() noexcept
+{
+	std::cerr << "Unhandled exception in a coroutine" << std::endl;
+	std::terminate();
+}
+
+void* Task::promise_type::operator new(std::size_t size)
+{
+	const u64 sizeClass = (size + FrameGranularity - 1) / FrameGranularity;
+
+	t_Frames.m_Stats.m_Live += 1;
+	t_Frames.m_Stats.m_LiveBytes += size;
+	t_Frames.m_Stats.m_LargestFrame = std::max<u64>(t_Frames.m_Stats.m_LargestFrame, size);
+
+	if (sizeClass > FrameClasses) {
+		return ::operator new(size);
+	}
+
+	auto& list = t_Frames.m_Free[sizeClass];
+	if (list.empty()) {
+		return ::operator new(sizeClass * FrameGranularity);
+	}
+
+	void* frame = list.back();
+	list.pop_back();
+
+	return frame;
+}
+
+void Task::promise_type::operator delete(void* frame, std::size_t size)
+{
+	const u64 sizeClass = (size + FrameGranularity - 1) / FrameGranularity;
+
+	t_Frames.m_Stats.m_Live -= 1;
+	t_Frames.m_Stats.m_LiveBytes -= size;
+
+	if (sizeClass > FrameClasses) {
+		::operator delete(frame);
+		return;
+	}
+
+	t_Frames.m_Free[sizeClass].push_back(frame);
+}
+
+FrameStats CurrentFrameStats()
+{
+	return t_Frames.m_Stats;
+}
+
+Task::Task(std::coroutine_handle<promise_type> handle) :
+	m_Handle { handle }
+{
+}
+
+Task::Task(Task&& other) noexcept :
+	m_Handle { std::exchange(other.m_Handle, nullptr) }
+{
+}
+
+Task::~Task()
+{
+	if (m_Handle) {
+		m_Handle.destroy();
+	}
+}
+
+std::coroutine_handle<> Task::Release()
+{
+	return std::exchange(m_Handle, nullptr);
+}
+
+Scheduler::Scheduler() :
+	m_Epoll { epoll_create1(EPOLL_CLOEXEC) },
+	m_Wake { eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) },
+	m_Running { false },
+	m_NextTimer { 1 },
+	m_Remote { 1 << 16 },
+	m_OnWritable { nullptr },
+	m_WritableContext { nullptr }
+{
+	epoll_event event {};
+	event.events  = EPOLLIN;
+	event.data.fd = m_Wake;
+	epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Wake, &event);
+}
+
+Scheduler::~Scheduler()
+{
+	close(m_Wake);
+	close(m_Epoll);
+}
+
+void Scheduler::Spawn(Task task)
+{
+	m_Ready.push_back(task.Release());
+}
+
+void Scheduler::Resume(std::coroutine_handle<> handle)
+{
+	m_Ready.push_back(handle);
+}
+
+void Scheduler::Post(Callback callback, void* context, u64 value)
+{
+	while (!m_Remote.Push(Remote { callback, context, value })) {
+		std::this_thread::yield();
+	}
+
+	const u64 one = 1;
+	write(m_Wake, &one, sizeof(one));
+}
+
+bool Scheduler::Watch(int fd)
+{
+	if (static_cast<u64>(fd) >= m_Fds.size()) {
+		m_Fds.resize(static_cast<u64>(fd) * 2 + 1);
+	}
+
+	m_Fds[fd] = FdState {};
+
+	epoll_event event {};
+	event.events  = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.fd = fd;
+
+	return epoll_ctl(m_Epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+void Scheduler::Unwatch(int fd)
+{
+	epoll_ctl(m_Epoll, EPOLL_CTL_DEL, fd, nullptr);
+
+	if (m_Fds[fd].m_Reader) {
+		Resume(m_Fds[fd].m_Reader);
+	}
+	m_Fds[fd] = FdState {};
+}
+
+void Scheduler::SetWritableCallback(WritableCallback callback, void* context)
+{
+	m_OnWritable      = callback;
+	m_WritableContext = context;
+}
+
+u64 Scheduler::AddTimer(u64 deadline, Callback callback, void* context, u64 value)
+{
+	const u64 id = m_NextTimer++;
+
+	m_Timers.push_back(Timer { deadline, id, callback, context, value });
+	std::push_heap(m_Timers.begin(), m_Timers.end(), std::greater<Timer> {});
+
+	return id;
+}
+
+void Scheduler::CancelTimer(u64 id)
+{
+	// Cancelled timers stay in the heap and are skipped when they come due.
+	m_Cancelled.insert(id);
+}
+
+void Scheduler::Run()
+{
+	m_Running = true;
+
+	epoll_event events[512];
+
+	while (m_Running) {
+		RunReady();
+		if (!m_Running) {
+			break;
+		}
+
+		const int count = epoll_wait(m_Epoll, events, 512, Timeout());
+		if (count == -1 and errno != EINTR) {
+			std::cerr << "Scheduler: epoll_wait failed: " << std::strerror(errno)
+					  << std::endl;
+			break;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			const int fd = events[i].data.fd;
+
+			if (fd == m_Wake) {
+				u64 value {};
+				read(m_Wake, &value, sizeof(value));
+
+				Remote remote {};
+				while (m_Remote.Pop(remote)) {
+					remote.m_Callback(remote.m_Context, remote.m_Value);
+				}
+				continue;
+			}
+
+			if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+				FdState& state = m_Fds[fd];
+				if (state.m_Reader) {
+					Resume(std::exchange(state.m_Reader, nullptr));
+				}
+				else {
+					state.m_Readable = true;
+				}
+			}
+
+			if (events[i].events & EPOLLOUT and m_OnWritable != nullptr) {
+				m_OnWritable(m_WritableContext, fd);
+			}
+		}
+
+		FireTimers();
+	}
+}
+
+void Scheduler::Stop()
+{
+	// Only flips a flag the loop reads, so it can come from anywhere via
+	// Post() as well.
+	Post(
+		[](void* context, u64) {
+			static_cast<Scheduler*>(context)->m_Running = false;
+		},
+		this,
+		0);
+}
+
+void Scheduler::ResumeHandle(void* context, u64)
+{
+	std::coroutine_handle<>::from_address(context).resume();
+}
+
+void Scheduler::RunReady()
+{
+	while (!m_Ready.empty()) {
+		m_Resuming.swap(m_Ready);
+
+		for (const auto handle : m_Resuming) {
+			handle.resume();
+		}
+
+		m_Resuming.clear();
+	}
+}
+
+void Scheduler::FireTimers()
+{
+	const u64 now = NowNanoseconds();
+
+	while (!m_Timers.empty() and m_Timers.front().m_Deadline <= now) {
+		std::pop_heap(m_Timers.begin(), m_Timers.end(), std::greater<Timer> {});
+		const Timer timer = m_Timers.back();
+		m_Timers.pop_back();
+
+		if (m_Cancelled.erase(timer.m_Id) == 0) {
+			timer.m_Callback(timer.m_Context, timer.m_Value);
+		}
+	}
+}
+
+int Scheduler::Timeout() const
+{
+	if (!m_Ready.empty()) {
+		return 0;
+	}
+	if (m_Timers.empty()) {
+		return -1;
+	}
+
+	const u64 now      = NowNanoseconds();
+	const u64 deadline = m_Timers.front().m_Deadline;
+
+	return deadline <= now ? 0 : static_cast<int>((deadline - now + 999'999) / 1'000'000);
+}
+
+bool Scheduler::ReadableAwaiter::await_ready() noexcept
+{
+	FdState& state = m_Scheduler.m_Fds[m_Fd];
+	return std::exchange(state.m_Readable, false);
+}
+
+void Scheduler::ReadableAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept
+{
+	m_Scheduler.m_Fds[m_Fd].m_Reader = handle;
+}
+
+void Scheduler::SleepAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept
+{
+	m_Scheduler.AddTimer(
+		NowNanoseconds() + m_Duration, &Scheduler::ResumeHandle, handle.address());
+}
@@ -0,0 +1,254 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <coroutine>
+#include <cstddef>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "histogram.h"
+#include "mpsc_queue.h"
+#include "rules.h"
+
+
+// Fire-and-forget coroutine. It starts suspended, Scheduler::Spawn() takes
+// ownership and the frame frees itself when the body returns. Frames come
+// from a per-thread size-class pool, so suspended sessions cost exactly
+// their frame size and nothing else.
+class Task {
+public:
+	struct promise_type {
+		Task get_return_object() noexcept
+		{
+			return Task { std::coroutine_handle<promise_type>::from_promise(*this) };
+		}
+
+		std::suspend_always initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void return_void() noexcept
+		{
+		}
+
+		void unhandled_exception() noexcept;
+
+		static void* operator new(std::size_t size);
+		static void  operator delete(void* frame, std::size_t size);
+	};
+
+	explicit Task(std::coroutine_handle<promise_type> handle);
+	Task(Task&& other) noexcept;
+	~Task();
+
+	Task(const Task&)            = delete;
+	Task& operator=(const Task&) = delete;
+	Task& operator=(Task&&)      = delete;
+
+	std::coroutine_handle<> Release();
+
+private:
+	std::coroutine_handle<promise_type> m_Handle;
+};
+
+struct FrameStats {
+	u64 m_Live {};
+	u64 m_LiveBytes {};
+	u64 m_LargestFrame {};
+};
+
+// Frames allocated and not yet freed on the calling thread.
+FrameStats CurrentFrameStats();
+
+// Single-threaded event loop for coroutines: a ready queue, timers, epoll
+// readiness for sockets and a lock-free queue for work handed back from
+// other threads (engine results, matchmaking).
+class Scheduler {
+public:
+	using Callback         = void (*)(void* context, u64 value);
+	using WritableCallback = void (*)(void* context, int fd);
+
+	Scheduler();
+	~Scheduler();
+
+	Scheduler(const Scheduler&)            = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+
+	void Spawn(Task task);
+	void Resume(std::coroutine_handle<> handle);
+
+	// The only thread-safe entry point: runs callback(context, value) on the
+	// scheduler thread.
+	void Post(Callback callback, void* context, u64 value);
+
+	// Registers a socket for edge-triggered readiness. Unwatch() wakes a
+	// pending reader so it can notice the socket is gone.
+	bool Watch(int fd);
+	void Unwatch(int fd);
+	void SetWritableCallback(WritableCallback callback, void* context);
+
+	u64  AddTimer(u64 deadline, Callback callback, void* context, u64 value = 0);
+	void CancelTimer(u64 id);
+
+	void Run();
+	void Stop();
+
+	struct ReadableAwaiter {
+		Scheduler& m_Scheduler;
+		int        m_Fd;
+
+		bool await_ready() noexcept;
+		void await_suspend(std::coroutine_handle<> handle) noexcept;
+		void await_resume() noexcept
+		{
+		}
+	};
+
+	struct SleepAwaiter {
+		Scheduler& m_Scheduler;
+		u64        m_Duration;
+
+		bool await_ready() noexcept
+		{
+			return m_Duration == 0;
+		}
+		void await_suspend(std::coroutine_handle<> handle) noexcept;
+		void await_resume() noexcept
+		{
+		}
+	};
+
+	ReadableAwaiter Readable(int fd)
+	{
+		return ReadableAwaiter { *this, fd };
+	}
+
+	SleepAwaiter Sleep(u64 nanoseconds)
+	{
+		return SleepAwaiter { *this, nanoseconds };
+	}
+
+	static void ResumeHandle(void* context, u64 value);
+
+private:
+	struct FdState {
+		std::coroutine_handle<> m_Reader;
+		bool                    m_Readable {};
+	};
+
+	struct Timer {
+		u64      m_Deadline;
+		u64      m_Id;
+		Callback m_Callback;
+		void*    m_Context;
+		u64      m_Value;
+
+		bool operator>(const Timer& other) const
+		{
+			return m_Deadline > other.m_Deadline;
+		}
+	};
+
+	struct Remote {
+		Callback m_Callback;
+		void*    m_Context;
+		u64      m_Value;
+	};
+
+	int  m_Epoll;
+	int  m_Wake;
+	bool m_Running;
+
+	std::vector<std::coroutine_handle<>> m_Ready;
+	std::vector<std::coroutine_handle<>> m_Resuming;
+	std::vector<FdState>                 m_Fds;
+	std::vector<Timer>                   m_Timers;
+	std::unordered_set<u64>              m_Cancelled;
+	u64                                  m_NextTimer;
+	MpscQueue<Remote>                    m_Remote;
+
+	WritableCallback m_OnWritable;
+	void*            m_WritableContext;
+
+	void RunReady();
+	void FireTimers();
+	int  Timeout() const;
+};
+
+// Single-consumer message queue a coroutine can wait on with a timeout.
+// Receive() yields std::nullopt when the timeout expires first.
+template <typename T>
+class Mailbox {
+public:
+	explicit Mailbox(Scheduler& scheduler) :
+		m_Scheduler { &scheduler }
+	{
+	}
+
+	void Post(T value)
+	{
+		m_Messages.push_back(std::move(value));
+
+		if (m_Waiter) {
+			m_Scheduler->CancelTimer(m_Timer);
+			m_Scheduler->Resume(std::exchange(m_Waiter, nullptr));
+		}
+	}
+
+	struct Awaiter {
+		Mailbox& m_Mailbox;
+		u64      m_Timeout;
+
+		bool await_ready() noexcept
+		{
+			return !m_Mailbox.m_Messages.empty();
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) noexcept
+		{
+			m_Mailbox.m_Waiter = handle;
+			m_Mailbox.m_Timer  = m_Mailbox.m_Scheduler->AddTimer(
+				NowNanoseconds() + m_Timeout, &Mailbox::OnTimeout, &m_Mailbox);
+		}
+
+		std::optional<T> await_resume()
+		{
+			if (m_Mailbox.m_Messages.empty()) {
+				return std::nullopt;
+			}
+
+			T value = std::move(m_Mailbox.m_Messages.front());
+			m_Mailbox.m_Messages.erase(m_Mailbox.m_Messages.begin());
+			return value;
+		}
+	};
+
+	Awaiter Receive(u64 timeout)
+	{
+		return Awaiter { *this, timeout };
+	}
+
+private:
+	Scheduler*              m_Scheduler;
+	std::vector<T>          m_Messages;
+	std::coroutine_handle<> m_Waiter;
+	u64                     m_Timer {};
+
+	static void OnTimeout(void* context, u64)
+	{
+		auto* mailbox = static_cast<Mailbox*>(context);
+		if (mailbox->m_Waiter) {
+			mailbox->m_Scheduler->Resume(std::exchange(mailbox->m_Waiter, nullptr));
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include <limits>
+
+#include "search.h"
+
+
+void ResumableSearch::Start(const i32 cells[3][3], i32 mark, u32 maxDepth)
+{
+	for (u32 i = 0; i < 3; ++i) {
+		for (u32 j = 0; j < 3; ++j) {
+			m_Cells[i][j] = cells[i][j];
+		}
+	}
+
+	const bool maximizing = mark == 1;
+
+	m_Stack[0] = Frame {
+		maximizing ? std::numeric_limits<i32>::min() : std::numeric_limits<i32>::max(),
+		-1,
+		0,
+		maximizing,
+		false
+	};
+	m_Size     = 1;
+	m_MaxDepth = maxDepth;
+	m_Nodes    = 0;
+	m_Move     = { -1, -1 };
+}
+
+bool ResumableSearch::Step(u64 budget)
+{
+	u64 spent {};
+
+	while (m_Size > 0 and spent < budget) {
+		Frame& top  = m_Stack[m_Size - 1];
+		u32    cell = top.m_Next;
+
+		while (cell < 9 and m_Cells[cell / 3][cell % 3] != 0) {
+			++cell;
+		}
+
+		if (cell == 9) {
+			if (m_Size == 1) {
+				m_Size = 0;
+				break;
+			}
+
+			const i32 value  = top.m_Moved ? top.m_Best : Utility::T;
+			const i32 played = top.m_Cell;
+
+			--m_Size;
+			m_Cells[played / 3][played % 3] = 0;
+			Return(value, played);
+			continue;
+		}
+
+		top.m_Next                  = cell + 1;
+		m_Cells[cell / 3][cell % 3] = top.m_IsMax ? 1 : 2;
+		++m_Nodes;
+		++spent;
+
+		// Same order of checks as Minimax(): a win ends the line before the
+		// depth limit is looked at.
+		if (const auto winner = CheckWinner(m_Cells); winner != Utility::T) {
+			m_Cells[cell / 3][cell % 3] = 0;
+			Return(winner, static_cast<i32>(cell));
+		}
+		else if (m_Size >= m_MaxDepth) {
+			m_Cells[cell / 3][cell % 3] = 0;
+			Return(Utility::T, static_cast<i32>(cell));
+		}
+		else {
+			const bool isMax   = !top.m_IsMax;
+			m_Stack[m_Size++] = Frame {
+				isMax ? std::numeric_limits<i32>::min() : std::numeric_limits<i32>::max(),
+				static_cast<i32>(cell),
+				0,
+				isMax,
+				false
+			};
+		}
+	}
+
+	return m_Size == 0;
+}
+
+bool ResumableSearch::Done() const
+{
+	return m_Size == 0;
+}
+
+u64 ResumableSearch::Nodes() const
+{
+	return m_Nodes;
+}
+
+std::pair<i32, i32> ResumableSearch::Result() const
+{
+	return m_Move;
+}
+
+void ResumableSearch::Return(i32 value, i32 cell)
+{
+	Frame& parent  = m_Stack[m_Size - 1];
+	parent.m_Moved = true;
+
+	if (m_Size == 1) {
+		// Root keeps the first best move, like FindBestMove().
+		if (parent.m_IsMax ? value > parent.m_Best : value < parent.m_Best) {
+			parent.m_Best = value;
+			m_Move        = { cell / 3, cell % 3 };
+		}
+		return;
+	}
+
+	parent.m_Best = parent.m_IsMax ? std::max(parent.m_Best, value)
+								   : std::min(parent.m_Best, value);
+}
+
+const PerfectTable& PerfectTable::Get()
+{
+	static const PerfectTable table {};
+	return table;
+}
+
+PerfectTable::PerfectTable()
+{
+	for (u32 index = 0; index < Positions; ++index) {
+		i32 cells[3][3] {};
+
+		u32 rest = index;
+		for (u32 i = 0; i < 9; ++i) {
+			cells[i / 3][i % 3] = static_cast<i32>(rest % 3);
+			rest /= 3;
+		}
+
+		Solve(cells, index, 1);
+		Solve(cells, index, 2);
+	}
+}
+
+std::pair<i32, i32> PerfectTable::BestMove(const i32 cells[3][3], i32 mark) const
+{
+	const u32 index = Index(cells);
+
+	i32 bestUtilVal = mark == 1 ? std::numeric_limits<i32>::min()
+								: std::numeric_limits<i32>::max();
+	std::pair<i32, i32> currentMove { -1, -1 };
+
+	u32 power = 1;
+	for (u32 i = 0; i < 9; ++i, power *= 3) {
+		if (cells[i / 3][i % 3] != 0) {
+			continue;
+		}
+
+		const u32 child   = index + static_cast<u32>(mark) * power;
+		const i32 utilVal = m_Values[child * 2 + (mark == 1 ? 1 : 0)];
+
+		if (mark == 1 ? utilVal > bestUtilVal : utilVal < bestUtilVal) {
+			bestUtilVal = utilVal;
+			currentMove = { static_cast<i32>(i / 3), static_cast<i32>(i % 3) };
+		}
+	}
+
+	return currentMove;
+}
+
+i32 PerfectTable::Value(const i32 cells[3][3], i32 mark) const
+{
+	return m_Values[Index(cells) * 2 + static_cast<u32>(mark - 1)];
+}
+
+i32 PerfectTable::Solve(i32 cells[3][3], u32 index, i32 mark)
+{
+	const u32 slot = index * 2 + static_cast<u32>(mark - 1);
+	if (m_Solved[slot]) {
+		return m_Values[slot];
+	}
+
+	i32 value = CheckWinner(cells);
+
+	if (value == Utility::T) {
+		i32  best = mark == 1 ? std::numeric_limits<i32>::min()
+							  : std::numeric_limits<i32>::max();
+		bool moved {};
+
+		u32 power = 1;
+		for (u32 i = 0; i < 9; ++i, power *= 3) {
+			if (cells[i / 3][i % 3] != 0) {
+				continue;
+			}
+
+			cells[i / 3][i % 3] = mark;
+			const i32 child =
+				Solve(cells, index + static_cast<u32>(mark) * power, mark == 1 ? 2 : 1);
+			cells[i / 3][i % 3] = 0;
+
+			best  = mark == 1 ? std::max(best, child) : std::min(best, child);
+			moved = true;
+		}
+
+		value = moved ? best : Utility::T;
+	}
+
+	m_Values[slot] = static_cast<signed char>(value);
+	m_Solved[slot] = true;
+
+	return value;
+}
+
+u32 PerfectTable::Index(const i32 cells[3][3])
+{
+	u32 index {};
+	u32 power = 1;
+
+	for (u32 i = 0; i < 9; ++i, power *= 3) {
+		index += static_cast<u32>(cells[i / 3][i % 3]) * power;
+	}
+
+	return index;
+}
+
+u64 EstimateNodes(const i32 cells[3][3], u32 maxDepth)
+{
+	u64 empty {};
+	for (u32 i = 0; i < 9; ++i) {
+		empty += cells[i / 3][i % 3] == 0 ? 1 : 0;
+	}
+
+	u64 nodes {};
+	u64 level = 1;
+	for (u64 k = 0; k < empty and k < maxDepth; ++k) {
+		level *= empty - k;
+		nodes += level;
+	}
+
+	return nodes;
+}
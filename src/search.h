@@ -0,0 +1,68 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <array>
+#include <utility>
+
+#include "rules.h"
+
+
+// The same search as FindBestMove(), written with an explicit stack so it can
+// stop after any number of nodes and pick up again later. The engine
+// scheduler uses these stop points to time-slice long searches.
+class ResumableSearch {
+public:
+	void Start(const i32 cells[3][3], i32 mark, u32 maxDepth);
+
+	// Expands at most budget nodes, returns true once the search is complete.
+	bool Step(u64 budget);
+
+	bool                Done() const;
+	u64                 Nodes() const;
+	std::pair<i32, i32> Result() const;
+
+private:
+	struct Frame {
+		i32  m_Best;
+		i32  m_Cell;    // cell played to reach this frame, -1 at the root
+		u32  m_Next;
+		bool m_IsMax;
+		bool m_Moved;
+	};
+
+	i32                     m_Cells[3][3] {};
+	std::array<Frame, 10>   m_Stack {};
+	u32                     m_Size {};
+	u32                     m_MaxDepth {};
+	u64                     m_Nodes {};
+	std::pair<i32, i32>     m_Move { -1, -1 };
+
+	void Return(i32 value, i32 cell);
+};
+
+// Perfect-play values for every 3x3 position, solved once on first use.
+// Lookups are a handful of array reads and return the move FindBestMove()
+// would pick at PerfectDepth.
+class PerfectTable {
+public:
+	static const PerfectTable& Get();
+
+	std::pair<i32, i32> BestMove(const i32 cells[3][3], i32 mark) const;
+	i32                 Value(const i32 cells[3][3], i32 mark) const;
+
+private:
+	static constexpr u32 Positions = 19683;    // 3^9
+
+	std::array<signed char, Positions * 2> m_Values {};
+	std::array<bool, Positions * 2>        m_Solved {};
+
+	PerfectTable();
+
+	i32        Solve(i32 cells[3][3], u32 index, i32 mark);
+	static u32 Index(const i32 cells[3][3]);
+};
+
+// Rough node count of a depth-limited search, used for admission control.
+u64 EstimateNodes(const i32 cells[3][3], u32 maxDepth);
+
+#endif
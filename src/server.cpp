@@ -0,0 +1,1241 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+#include "net.h"
+#include "server.h"
+
+
+static bool        ParseNumbers(std::string_view text, u32* values, u32 count);
+static std::string BoardLine(const Board& board);
+
+GameServer::GameServer(u32 slots, u32 engineThreads) :
+	m_Listener { -1 },
+	m_Handoff { -1 },
+	m_Port {},
+	m_Shard {},
+	m_MigrationListener { -1 },
+	m_Migration { -1 },
+	m_DrainTarget {},
+	m_Draining { false },
+	m_DrainStarted {},
+	m_OpenConnections {},
+	m_NextTicket { 1 },
+	m_Random { std::random_device {}() },
+	m_Journal {},
+	m_Slots { slots },
+	m_Sessions {},
+	m_Matchmaker { slots },
+	m_Engine { m_Scheduler, engineThreads },
+	m_NewestGame {},
+	m_GamesPlayed {},
+	m_MovesPlayed {}
+{
+	// Runs on the matcher thread, the game starts on the scheduler thread.
+	m_Matchmaker.SetOnMatch([this](u32 slot) {
+		m_Scheduler.Post(&GameServer::OnMatch, this, slot);
+	});
+	m_Matchmaker.SetOnRestore([this](u32 slot) {
+		m_Scheduler.Post(&GameServer::OnRestore, this, slot);
+	});
+
+	m_Scheduler.SetWritableCallback(&GameServer::OnWritable, this);
+}
+
+GameServer::~GameServer()
+{
+	m_Matchmaker.Stop();
+
+	for (u64 fd = 0; fd < m_Connections.size(); ++fd) {
+		if (m_Connections[fd].m_Open) {
+			close(static_cast<int>(fd));
+		}
+	}
+
+	if (m_Listener != -1) {
+		close(m_Listener);
+	}
+
+	if (m_Handoff != -1) {
+		close(m_Handoff);
+	}
+
+	if (m_MigrationListener != -1) {
+		close(m_MigrationListener);
+	}
+
+	if (m_Migration != -1) {
+		close(m_Migration);
+	}
+}
+
+bool GameServer::Listen(u32 port, bool reusePort)
+{
+	m_Listener = ListenTcp(port, reusePort);
+
+	return m_Listener != -1 and m_Scheduler.Watch(m_Listener);
+}
+
+bool GameServer::EnableSharding(u32 shard, u32 shards, u32 port)
+{
+	m_Handoff = BindHandoff(port, shard);
+	if (m_Handoff == -1 or !m_Scheduler.Watch(m_Handoff)) {
+		return false;
+	}
+
+	m_Port  = port;
+	m_Shard = shard;
+	m_Ring  = std::make_unique<ShardRing>(shards);
+
+	m_Matchmaker.SetGameIdFilter([this](u64 gameId) {
+		return m_Ring->Owner(gameId) == m_Shard;
+	});
+
+	return true;
+}
+
+bool GameServer::AcceptMigrations(const char* name)
+{
+	m_MigrationListener = ListenLocal(name);
+
+	return m_MigrationListener != -1 and m_Scheduler.Watch(m_MigrationListener);
+}
+
+void GameServer::Drain(const char* target)
+{
+	m_DrainTarget = target;
+	m_Scheduler.Post(&GameServer::OnDrain, this, 0);
+}
+
+void GameServer::SetJournal(GameJournal* journal)
+{
+	m_Journal = journal;
+}
+
+bool GameServer::EnableSnapshot(const char* path)
+{
+	const SnapshotSection sessions {
+		SNAPSHOT_SESSIONS, SessionSnapshot::Version, sizeof(SnapshotSlot<SessionSnapshot>), m_Slots
+	};
+
+	if (!m_Snapshot.Open(path, { sessions })) {
+		return false;
+	}
+	m_Sessions = m_Snapshot.Section<SnapshotSlot<SessionSnapshot>>(SNAPSHOT_SESSIONS);
+
+	if (!m_Snapshot.Restored()) {
+		return true;
+	}
+
+	// Restored games may land in other slots, so the old ones are emptied
+	// and each game stores itself again once it runs.
+	for (u32 slot = 0; slot < m_Slots; ++slot) {
+		SessionSnapshot session {};
+		if (m_Sessions[slot].Load(session)) {
+			m_Sessions[slot].Clear();
+			Admit(session, true);
+		}
+	}
+
+	return true;
+}
+
+void GameServer::Run()
+{
+	m_Scheduler.Spawn(AcceptConnections());
+	if (m_Handoff != -1) {
+		m_Scheduler.Spawn(AcceptHandoffs());
+	}
+	if (m_MigrationListener != -1) {
+		m_Scheduler.Spawn(AcceptMigrationLinks());
+	}
+	m_Matchmaker.Start();
+
+	m_Scheduler.Run();
+
+	m_Matchmaker.Stop();
+}
+
+void GameServer::Stop()
+{
+	m_Scheduler.Stop();
+}
+
+u64 GameServer::GamesPlayed() const
+{
+	return m_GamesPlayed;
+}
+
+u64 GameServer::MovesPlayed() const
+{
+	return m_MovesPlayed.load(std::memory_order_relaxed);
+}
+
+EngineMetrics GameServer::EngineStats() const
+{
+	return m_Engine.Metrics();
+}
+
+const GameServer::MigrationStats& GameServer::Migrations() const
+{
+	return m_Migrations;
+}
+
+void GameServer::Accept()
+{
+	while (true) {
+		const int fd =
+			accept4(m_Listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd == -1) {
+			if (errno == EINTR or errno == ECONNABORTED) {
+				continue;
+			}
+			return;
+		}
+
+		Adopt(fd);
+	}
+}
+
+bool GameServer::Adopt(int fd)
+{
+	if (static_cast<u64>(fd) >= m_Connections.size()) {
+		m_Connections.resize(static_cast<u64>(fd) * 2 + 1);
+	}
+
+	if (!m_Scheduler.Watch(fd)) {
+		close(fd);
+		return false;
+	}
+
+	Connection& connection = m_Connections[fd];
+	const u32   generation = connection.m_Generation + 1;
+
+	connection              = Connection {};
+	connection.m_Open       = true;
+	connection.m_Generation = generation;
+	++m_OpenConnections;
+
+	m_Scheduler.Spawn(ServeConnection(fd, generation));
+
+	return true;
+}
+
+void GameServer::HandOff(int fd, u32 shard, std::string_view line)
+{
+	Connection& connection = m_Connections[fd];
+
+	// line points into m_Input, so everything from it onwards is the input
+	// the owning shard has yet to see.
+	const u64              offset = static_cast<u64>(line.data() - connection.m_Input.data());
+	const std::string_view unread = std::string_view { connection.m_Input }.substr(offset);
+
+	if (!SendHandoff(m_Handoff, m_Port, shard, fd, unread)) {
+		Send(fd, "ERR shard unavailable\n");
+		return;
+	}
+
+	Close(fd);
+}
+
+void GameServer::Read(int fd)
+{
+	Connection& connection = m_Connections[fd];
+	char        buffer[4096];
+
+	while (connection.m_Open) {
+		const ssize_t size = read(fd, buffer, sizeof(buffer));
+		if (size == 0) {
+			Close(fd);
+			return;
+		}
+		if (size == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN) {
+				Close(fd);
+			}
+			break;
+		}
+
+		connection.m_Input.append(buffer, static_cast<u64>(size));
+	}
+
+	u64 start {};
+	while (connection.m_Open) {
+		const u64 end = connection.m_Input.find('\n', start);
+		if (end == std::string::npos) {
+			break;
+		}
+
+		Handle(fd, std::string_view { connection.m_Input }.substr(start, end - start));
+		start = end + 1;
+	}
+
+	if (!connection.m_Open) {
+		return;
+	}
+
+	connection.m_Input.erase(0, start);
+	if (connection.m_Input.size() > 1024) {
+		Close(fd);
+	}
+}
+
+void GameServer::Flush(int fd)
+{
+	Connection& connection = m_Connections[fd];
+	if (connection.m_Broken) {
+		return;
+	}
+
+	// Text queued while a frame was half sent goes after that frame, never
+	// inside it. Frames not yet started wait for the text.
+	if (connection.m_FrameOffset > 0 and !FlushFrame(fd)) {
+		return;
+	}
+
+	while (connection.m_Written < connection.m_Output.size()) {
+		const ssize_t written = send(
+			fd,
+			connection.m_Output.data() + connection.m_Written,
+			connection.m_Output.size() - connection.m_Written,
+			MSG_NOSIGNAL);
+
+		if (written == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN) {
+				Break(fd);
+			}
+			return;
+		}
+
+		connection.m_Written += static_cast<u64>(written);
+	}
+
+	connection.m_Output.clear();
+	connection.m_Written = 0;
+
+	while (connection.m_Frame) {
+		if (!FlushFrame(fd)) {
+			return;
+		}
+	}
+
+	if (connection.m_Retiring) {
+		shutdown(fd, SHUT_WR);
+	}
+}
+
+// Writes the rest of the frame in flight and moves the queued one up. False
+// while the socket is full or once it broke.
+bool GameServer::FlushFrame(int fd)
+{
+	Connection& connection = m_Connections[fd];
+
+	while (true) {
+		const i64 written =
+			WriteFrame(fd, *connection.m_Frame, connection.m_FrameOffset);
+
+		if (written == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN) {
+				Break(fd);
+			}
+			return false;
+		}
+
+		connection.m_FrameOffset += static_cast<u64>(written);
+		if (connection.m_FrameOffset == connection.m_Frame->Size()) {
+			connection.m_Frame       = std::move(connection.m_Next);
+			connection.m_FrameOffset = 0;
+			return true;
+		}
+	}
+}
+
+void GameServer::Break(int fd)
+{
+	// Write failures happen deep inside Publish() and friends, the actual
+	// Close() runs from the scheduler once the current work is done.
+	if (!m_Connections[fd].m_Broken) {
+		m_Connections[fd].m_Broken = true;
+		m_Scheduler.AddTimer(0, &GameServer::OnBroken, this, static_cast<u64>(fd));
+	}
+}
+
+void GameServer::Close(int fd)
+{
+	Connection& connection = m_Connections[fd];
+	if (!connection.m_Open) {
+		return;
+	}
+
+	connection.m_Open = false;
+
+	if (auto game = m_Games.find(connection.m_GameId); game != m_Games.end()) {
+		LiveGame& live = game->second;
+
+		if (connection.m_Role == ROLE_PLAYER) {
+			// The game coroutine ends the game when it sees the event, until
+			// then nothing may be sent to this descriptor.
+			live.m_Players[connection.m_Seat - 1] = Left;
+			live.m_Events.Post(GameEvent { fd, 0, true });
+		}
+		else if (connection.m_Role == ROLE_SPECTATOR) {
+			std::erase(live.m_Spectators, fd);
+		}
+	}
+
+	m_Scheduler.Unwatch(fd);
+	close(fd);
+
+	const u32 generation    = connection.m_Generation;
+	connection              = Connection {};
+	connection.m_Generation = generation;
+	--m_OpenConnections;
+
+	if (m_Draining and m_Games.empty() and m_OpenConnections == 0) {
+		Stop();
+	}
+}
+
+void GameServer::Retire(int fd, std::string_view text)
+{
+	// Closing with unread input would reset the connection and could lose
+	// text, so only the write side is shut and the client closes.
+	Connection& connection = m_Connections[fd];
+	connection.m_Role      = ROLE_NONE;
+	connection.m_Retiring  = true;
+
+	Send(fd, text);
+}
+
+void GameServer::Handle(int fd, std::string_view line)
+{
+	Connection& connection = m_Connections[fd];
+	if (connection.m_Retiring) {
+		return;
+	}
+
+	if (!line.empty() and line.back() == '\r') {
+		line.remove_suffix(1);
+	}
+
+	const u64              space   = line.find(' ');
+	const std::string_view command = line.substr(0, space);
+	const std::string_view rest =
+		space == std::string_view::npos ? std::string_view {} : line.substr(space + 1);
+
+	if (command == "JOIN") {
+		u32 values[4] {};
+		if (!ParseNumbers(rest, values, 3) or values[0] > 1) {
+			Send(fd, "ERR usage: JOIN <mode> <rating> <depth> [tenant]\n");
+			return;
+		}
+		ParseNumbers(rest, values, 4);    // the tenant is optional and stays 0
+		if (connection.m_Role != ROLE_NONE) {
+			Send(fd, "ERR busy\n");
+			return;
+		}
+
+		JoinRequest request {};
+		request.m_PlayerId    = static_cast<u64>(connection.m_Generation) << 32 | fd;
+		request.m_Mode        = values[0] == 0 ? SINGLE_P : MULTI_P;
+		request.m_Rating      = values[1];
+		request.m_EngineDepth = std::min(values[2], PerfectDepth);
+		request.m_Tenant      = values[3];
+
+		if (!m_Matchmaker.Join(request)) {
+			Send(fd, "ERR overloaded\n");
+			return;
+		}
+
+		connection.m_Role = ROLE_QUEUED;
+	}
+	else if (command == "MOVE") {
+		u32 cell {};
+		if (!ParseNumbers(rest, &cell, 1) or cell > 8) {
+			Send(fd, "ERR usage: MOVE <cell>\n");
+			return;
+		}
+		if (connection.m_Role != ROLE_PLAYER) {
+			Send(fd, "ERR not in a game\n");
+			return;
+		}
+
+		m_Games.at(connection.m_GameId).m_Events.Post(GameEvent { fd, cell, false });
+	}
+	else if (command == "RESUME") {
+		u32 values[2] {};
+		if (!ParseNumbers(rest, values, 2)) {
+			Send(fd, "ERR usage: RESUME <id> <token>\n");
+			return;
+		}
+		if (connection.m_Role != ROLE_NONE) {
+			Send(fd, "ERR busy\n");
+			return;
+		}
+
+		u64 gameId = values[0];
+		if (auto renamed = m_Renamed.find(gameId); renamed != m_Renamed.end()) {
+			gameId = renamed->second;
+		}
+
+		if (!m_Games.contains(gameId) and m_Ring and m_Ring->Owner(gameId) != m_Shard) {
+			HandOff(fd, m_Ring->Owner(gameId), line);
+			return;
+		}
+
+		Resume(fd, gameId, values[1]);
+	}
+	else if (command == "SPECTATE") {
+		u32 id {};
+		if (!ParseNumbers(rest, &id, 1)) {
+			Send(fd, "ERR usage: SPECTATE <id>\n");
+			return;
+		}
+		if (connection.m_Role != ROLE_NONE) {
+			Send(fd, "ERR busy\n");
+			return;
+		}
+
+		u64 gameId = id == 0 ? m_NewestGame : id;
+		if (auto renamed = m_Renamed.find(gameId); renamed != m_Renamed.end()) {
+			gameId = renamed->second;
+		}
+
+		// Games restored from another process may live off their ring shard.
+		if (!m_Games.contains(gameId) and m_Ring and m_Ring->Owner(gameId) != m_Shard) {
+			HandOff(fd, m_Ring->Owner(gameId), line);
+			return;
+		}
+
+		auto game = m_Games.find(gameId);
+		if (game == m_Games.end()) {
+			Send(fd, "ERR no such game\n");
+			return;
+		}
+
+		connection.m_Role   = ROLE_SPECTATOR;
+		connection.m_GameId = gameId;
+		game->second.m_Spectators.push_back(fd);
+
+		const Board& board = m_Matchmaker.Slot(game->second.m_Slot).m_Board;
+		SendFrame(
+			fd,
+			SpectatorFrame::Make(
+				game->second.m_Sequence,
+				EncodeBoardFrame(
+					board.m_Cells,
+					board.m_Moves,
+					board.m_Player1Turn,
+					board.m_Winner,
+					board.m_State)));
+	}
+	else if (command == "STATS") {
+		const EngineMetrics metrics = m_Engine.Metrics();
+
+		std::string reply = "STATS";
+		reply += " queue=" + std::to_string(metrics.m_QueueDepth);
+		reply += " max_queue=" + std::to_string(metrics.m_MaxQueueDepth);
+		reply += " completed=" + std::to_string(metrics.m_Completed);
+		reply += " misses=" + std::to_string(metrics.m_DeadlineMisses);
+		reply += " reduced=" + std::to_string(metrics.m_Reduced);
+		reply += " table=" + std::to_string(metrics.m_TableLookups);
+		reply += " slices=" + std::to_string(metrics.m_Slices);
+		reply += " p99_us=" + std::to_string(metrics.m_Latency.Percentile(99.0) / 1000);
+		reply += "\n";
+
+		Send(fd, reply);
+	}
+	else if (command == "QUIT") {
+		Close(fd);
+	}
+	else {
+		Send(fd, "ERR unknown command\n");
+	}
+}
+
+void GameServer::Resume(int fd, u64 gameId, u32 token)
+{
+	auto game = m_Games.find(gameId);
+	if (game == m_Games.end()) {
+		Send(fd, "ERR no such game\n");
+		return;
+	}
+
+	LiveGame& live = game->second;
+
+	u32 seat {};
+	while (seat < 2 and (live.m_Tokens[seat] != token or live.m_Players[seat] == Engine)) {
+		++seat;
+	}
+	if (seat == 2 or live.m_Players[seat] == Left) {
+		Send(fd, "ERR bad token\n");
+		return;
+	}
+
+	// A client may resume over a connection the server still thinks is fine.
+	if (const int previous = live.m_Players[seat]; previous >= 0) {
+		m_Connections[previous].m_Role = ROLE_NONE;
+		Send(previous, "ERR seat resumed elsewhere\n");
+		Close(previous);
+	}
+
+	Connection& connection = m_Connections[fd];
+	connection.m_Role      = ROLE_PLAYER;
+	connection.m_GameId    = gameId;
+	connection.m_Seat      = seat + 1;
+	live.m_Players[seat]   = fd;
+
+	Send(
+		fd,
+		"GAME " + std::to_string(gameId) + ' ' + std::to_string(seat + 1) + ' ' +
+			std::to_string(token) + '\n');
+	Send(fd, BoardLine(m_Matchmaker.Slot(live.m_Slot).m_Board));
+}
+
+void GameServer::Send(int fd, std::string_view text)
+{
+	Connection& connection = m_Connections[fd];
+	const bool  idle = connection.m_Output.empty() and !connection.m_Frame;
+
+	connection.m_Output.append(text);
+
+	if (idle) {
+		Flush(fd);
+	}
+}
+
+void GameServer::SendFrame(int fd, std::shared_ptr<const SpectatorFrame> frame)
+{
+	Connection& connection = m_Connections[fd];
+
+	// Never queue more than one snapshot behind the one in flight, a slow
+	// spectator simply skips the boards it had no time to receive.
+	if (connection.m_Frame) {
+		connection.m_Next = std::move(frame);
+		return;
+	}
+
+	connection.m_Frame       = std::move(frame);
+	connection.m_FrameOffset = 0;
+
+	if (connection.m_Output.empty()) {
+		Flush(fd);
+	}
+}
+
+void GameServer::StartGame(u32 slot)
+{
+	GameSlot& match = m_Matchmaker.Slot(slot);
+
+	LiveGame game { m_Scheduler };
+	game.m_Slot = slot;
+
+	// The engine is player one in SINGLE_P games, as in Game.
+	if (match.m_Mode == SINGLE_P) {
+		game.m_Players[1] = Resolve(match.m_Players[0]);
+	}
+	else {
+		game.m_Players[0] = Resolve(match.m_Players[0]);
+		game.m_Players[1] = Resolve(match.m_Players[1]);
+	}
+
+	const bool complete = game.m_Players[1] != Engine and
+						  (match.m_Mode == SINGLE_P or game.m_Players[0] != Engine);
+
+	if (!complete) {
+		// Somebody disconnected while queued.
+		for (const int player : game.m_Players) {
+			if (player != Engine) {
+				m_Connections[player].m_Role = ROLE_NONE;
+				Send(player, "ERR opponent left\n");
+			}
+		}
+		m_Matchmaker.Release(slot);
+		return;
+	}
+
+	for (u32 seat = 0; seat < 2; ++seat) {
+		const int player = game.m_Players[seat];
+		if (player == Engine) {
+			continue;
+		}
+
+		Connection& connection = m_Connections[player];
+		connection.m_Role      = ROLE_PLAYER;
+		connection.m_GameId    = match.m_GameId;
+		connection.m_Seat      = seat + 1;
+
+		// Never 0, so the engine's seat can not be claimed.
+		game.m_Tokens[seat] = 1 + static_cast<u32>(m_Random() % 0xfffffffe);
+
+		Send(
+			player,
+			"GAME " + std::to_string(match.m_GameId) + ' ' + std::to_string(seat + 1) +
+				' ' + std::to_string(game.m_Tokens[seat]) + '\n');
+	}
+
+	game.m_TurnStarted = NowNanoseconds();
+
+	m_Games.emplace(match.m_GameId, std::move(game));
+	m_NewestGame = match.m_GameId;
+
+	m_Scheduler.Spawn(PlayGame(match.m_GameId));
+}
+
+void GameServer::StartRestoredGame(u32 slot)
+{
+	GameSlot& match   = m_Matchmaker.Slot(slot);
+	auto      arrival = m_Arriving.find(match.m_Restored);
+	if (arrival == m_Arriving.end()) {
+		m_Matchmaker.Release(slot);
+		return;
+	}
+
+	const SessionSnapshot& session = arrival->second.m_Session;
+	const u64              now     = NowNanoseconds();
+
+	LiveGame game { m_Scheduler };
+	game.m_Slot        = slot;
+	game.m_Sequence    = session.m_Sequence;
+	game.m_TurnStarted = now - std::min(session.m_Waited, now);
+
+	for (u32 seat = 0; seat < 2; ++seat) {
+		game.m_Players[seat] = session.m_Engine[seat] ? Engine : Away;
+		game.m_Tokens[seat]  = session.m_Tokens[seat];
+	}
+	std::memcpy(game.m_History, session.m_History, sizeof(game.m_History));
+
+	if (match.m_GameId != session.m_GameId) {
+		game.m_Alias                 = session.m_GameId;
+		m_Renamed[session.m_GameId] = match.m_GameId;
+	}
+
+	if (arrival->second.m_Local) {
+		++m_Migrations.m_Resumed;
+	}
+	else {
+		m_Migrations.m_Restore.Record(now - arrival->second.m_Received);
+		++m_Migrations.m_Received;
+	}
+	m_Arriving.erase(arrival);
+
+	m_Games.emplace(match.m_GameId, std::move(game));
+	m_NewestGame = match.m_GameId;
+
+	m_Scheduler.Spawn(PlayGame(match.m_GameId));
+}
+
+Task GameServer::AcceptConnections()
+{
+	// Draining closes the listener and wakes this coroutine one last time.
+	while (m_Listener != -1) {
+		co_await m_Scheduler.Readable(m_Listener);
+		Accept();
+	}
+}
+
+Task GameServer::AcceptMigrationLinks()
+{
+	while (true) {
+		co_await m_Scheduler.Readable(m_MigrationListener);
+
+		while (true) {
+			const int fd = accept4(
+				m_MigrationListener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd == -1) {
+				if (errno == EINTR or errno == ECONNABORTED) {
+					continue;
+				}
+				break;
+			}
+
+			if (!m_Scheduler.Watch(fd)) {
+				close(fd);
+				continue;
+			}
+
+			m_Scheduler.Spawn(ReceiveMigrations(fd));
+		}
+	}
+}
+
+Task GameServer::ReceiveMigrations(int fd)
+{
+	unsigned char buffer[SessionSnapshot::EncodedSize];
+
+	while (true) {
+		co_await m_Scheduler.Readable(fd);
+
+		while (true) {
+			const ssize_t size = recv(fd, buffer, sizeof(buffer), MSG_TRUNC);
+			if (size == -1 and errno == EINTR) {
+				continue;
+			}
+			if (size == -1 and errno == EAGAIN) {
+				break;
+			}
+			if (size <= 0) {
+				m_Scheduler.Unwatch(fd);
+				close(fd);
+				co_return;
+			}
+
+			SessionSnapshot session {};
+			if (!DecodeSession(buffer, static_cast<u64>(size), session)) {
+				std::cerr << "Migration: dropped a malformed session" << std::endl;
+				continue;
+			}
+
+			Admit(session, false);
+		}
+	}
+}
+
+Task GameServer::AcceptHandoffs()
+{
+	std::string pending {};
+
+	while (true) {
+		co_await m_Scheduler.Readable(m_Handoff);
+
+		int fd {};
+		while ((fd = ReceiveHandoff(m_Handoff, pending)) != -1) {
+			SetNonBlocking(fd);
+			if (!Adopt(fd)) {
+				continue;
+			}
+
+			// The sender already consumed these bytes from the socket.
+			m_Connections[fd].m_Input = std::move(pending);
+			Read(fd);
+		}
+	}
+}
+
+Task GameServer::ServeConnection(int fd, u32 generation)
+{
+	while (Alive(fd, generation)) {
+		co_await m_Scheduler.Readable(fd);
+
+		if (!Alive(fd, generation)) {
+			break;
+		}
+
+		Read(fd);
+	}
+}
+
+Task GameServer::PlayGame(u64 gameId)
+{
+	LiveGame& game  = m_Games.at(gameId);
+	GameSlot& match = m_Matchmaker.Slot(game.m_Slot);
+	Board&    board = match.m_Board;
+
+	Publish(game);
+	Persist(gameId);
+
+	while (board.m_State != GAME_OVER) {
+		// Only ever between moves, so a snapshot never sees half a turn.
+		if (m_Draining) {
+			Migrate(gameId);
+			co_return;
+		}
+
+		const u32 seat   = board.m_Player1Turn ? 1 : 2;
+		const int player = game.m_Players[seat - 1];
+		u32       cell {};
+
+		if (player == Engine) {
+			const auto move = co_await m_Engine.Search(
+				board.m_Cells,
+				static_cast<i32>(seat),
+				match.m_EngineDepth,
+				match.m_Tenant,
+				game.m_TurnStarted + EngineDeadline);
+			board.Play(static_cast<u32>(move.first), static_cast<u32>(move.second));
+			cell = static_cast<u32>(move.first * 3 + move.second);
+		}
+		else {
+			const u64  waited = NowNanoseconds() - game.m_TurnStarted;
+			const auto event  = co_await game.m_Events.Receive(
+				waited < MoveTimeout ? MoveTimeout - waited : 0);
+
+			if (event and event->m_Wake) {
+				continue;
+			}
+			if (!event or event->m_Left) {
+				// Timeouts and disconnects forfeit the game to the other seat.
+				for (const int other : game.m_Players) {
+					if (other >= 0) {
+						Send(other, event ? "ERR opponent left\n" : "ERR move timeout\n");
+					}
+				}
+
+				const u32 loser = !event ? seat : game.m_Players[0] == Left ? 1 : 2;
+				board.m_Winner  = loser == 1 ? Utility::O : Utility::X;
+				board.m_State   = GAME_OVER;
+				break;
+			}
+
+			// Re-read the seat, a RESUME may have moved it to a new connection.
+			if (event->m_Fd != game.m_Players[seat - 1]) {
+				Send(event->m_Fd, "ERR not your turn\n");
+				continue;
+			}
+			if (!board.Play(event->m_Cell / 3, event->m_Cell % 3)) {
+				Send(event->m_Fd, "ERR illegal move\n");
+				continue;
+			}
+			cell = event->m_Cell;
+		}
+
+		game.m_History[board.m_Moves - 1] = static_cast<unsigned char>(cell);
+		game.m_TurnStarted                = NowNanoseconds();
+
+		m_MovesPlayed.fetch_add(1, std::memory_order_relaxed);
+		Publish(game);
+		Persist(gameId);
+	}
+
+	EndGame(gameId);
+}
+
+void GameServer::Publish(LiveGame& game)
+{
+	const Board& board = m_Matchmaker.Slot(game.m_Slot).m_Board;
+	++game.m_Sequence;
+
+	const std::string line = BoardLine(board);
+
+	for (const int player : game.m_Players) {
+		if (player >= 0) {
+			Send(player, line);
+		}
+	}
+
+	if (game.m_Spectators.empty()) {
+		return;
+	}
+
+	// Encoded once, shared by every spectator of this game.
+	const auto frame = SpectatorFrame::Make(
+		game.m_Sequence,
+		EncodeBoardFrame(
+			board.m_Cells,
+			board.m_Moves,
+			board.m_Player1Turn,
+			board.m_Winner,
+			board.m_State));
+
+	for (const int spectator : game.m_Spectators) {
+		SendFrame(spectator, frame);
+	}
+}
+
+void GameServer::Persist(u64 gameId)
+{
+	if (m_Sessions != nullptr) {
+		m_Sessions[m_Games.at(gameId).m_Slot].Store(Capture(gameId));
+	}
+}
+
+void GameServer::EndGame(u64 gameId)
+{
+	auto game = m_Games.find(gameId);
+	if (game == m_Games.end()) {
+		return;
+	}
+
+	for (const int player : game->second.m_Players) {
+		if (player >= 0 and m_Connections[player].m_GameId == gameId) {
+			m_Connections[player].m_Role   = ROLE_NONE;
+			m_Connections[player].m_GameId = 0;
+		}
+	}
+
+	for (const int spectator : game->second.m_Spectators) {
+		m_Connections[spectator].m_Role   = ROLE_NONE;
+		m_Connections[spectator].m_GameId = 0;
+	}
+
+	if (game->second.m_Alias != 0) {
+		m_Renamed.erase(game->second.m_Alias);
+	}
+
+	if (const GameSlot& match = m_Matchmaker.Slot(game->second.m_Slot);
+		m_Journal != nullptr and match.m_Board.m_State == GAME_OVER) {
+		GameRecord record {};
+		record.m_Time   = UnixNanoseconds();
+		record.m_GameId = gameId;
+		record.m_Mode        = match.m_Mode;
+		record.m_EngineDepth = match.m_EngineDepth;
+		record.m_Winner      = match.m_Board.m_Winner;
+		record.m_Moves       = match.m_Board.m_Moves;
+		std::copy(game->second.m_History, game->second.m_History + 9, record.m_History);
+
+		m_Journal->Append(record);
+	}
+
+	if (m_Sessions != nullptr) {
+		m_Sessions[game->second.m_Slot].Clear();
+	}
+
+	m_Matchmaker.Release(game->second.m_Slot);
+	m_Games.erase(game);
+	++m_GamesPlayed;
+
+	if (m_Draining) {
+		FinishDrain();
+	}
+}
+
+void GameServer::BeginDrain()
+{
+	if (m_Draining or m_DrainTarget == nullptr) {
+		return;
+	}
+
+	m_Migration = ConnectLocal(m_DrainTarget);
+	if (m_Migration == -1) {
+		std::cerr << "Drain: nothing accepts migrations as " << m_DrainTarget
+				  << ", still serving" << std::endl;
+		return;
+	}
+
+	m_Draining     = true;
+	m_DrainStarted = NowNanoseconds();
+
+	// New connections now only reach the processes still listening.
+	if (m_Listener != -1) {
+		const int listener = m_Listener;
+		m_Listener         = -1;
+		m_Scheduler.Unwatch(listener);
+		close(listener);
+	}
+
+	// Every game migrates itself the next time its coroutine runs.
+	for (auto& [id, game] : m_Games) {
+		game.m_Events.Post(GameEvent { -1, 0, false, true });
+	}
+
+	FinishDrain();
+}
+
+void GameServer::Admit(const SessionSnapshot& session, bool local)
+{
+	const u64 ticket = m_NextTicket++;
+	m_Arriving.emplace(ticket, Arrival { session, NowNanoseconds(), local });
+
+	GameSlot game {};
+	game.m_GameId      = session.m_GameId;
+	game.m_Board       = session.m_Board;
+	game.m_Mode        = session.m_Mode;
+	game.m_EngineDepth = session.m_EngineDepth;
+	game.m_Tenant      = session.m_Tenant;
+	game.m_Restored    = ticket;
+
+	if (!m_Matchmaker.Restore(game)) {
+		std::cerr << (local ? "Snapshot" : "Migration") << ": no room for game "
+				  << session.m_GameId << std::endl;
+		m_Arriving.erase(ticket);
+	}
+}
+
+SessionSnapshot GameServer::Capture(u64 gameId)
+{
+	const LiveGame& game  = m_Games.at(gameId);
+	const GameSlot& match = m_Matchmaker.Slot(game.m_Slot);
+
+	SessionSnapshot session {};
+	session.m_GameId      = gameId;
+	session.m_Sequence    = game.m_Sequence;
+	session.m_Waited      = NowNanoseconds() - game.m_TurnStarted;
+	session.m_Board       = match.m_Board;
+	session.m_Mode        = match.m_Mode;
+	session.m_EngineDepth = match.m_EngineDepth;
+	session.m_Tenant      = match.m_Tenant;
+	std::memcpy(session.m_History, game.m_History, sizeof(session.m_History));
+
+	for (u32 seat = 0; seat < 2; ++seat) {
+		session.m_Engine[seat] = game.m_Players[seat] == Engine;
+		session.m_Tokens[seat] = game.m_Tokens[seat];
+	}
+
+	return session;
+}
+
+void GameServer::Migrate(u64 gameId)
+{
+	LiveGame&             game    = m_Games.at(gameId);
+	const SessionSnapshot session = Capture(gameId);
+
+	const auto    data = EncodeSession(session);
+	const ssize_t sent = send(m_Migration, data.data(), data.size(), MSG_NOSIGNAL);
+	const bool    moved = sent == static_cast<ssize_t>(data.size());
+
+	if (moved) {
+		++m_Migrations.m_Sent;
+	}
+	else {
+		std::cerr << "Migration: lost game " << gameId << ": " << std::strerror(errno)
+				  << std::endl;
+	}
+
+	for (const int player : game.m_Players) {
+		if (player >= 0) {
+			Retire(player, moved ? "MOVED\n" : "ERR server shutting down\n");
+		}
+	}
+
+	for (const int spectator : game.m_Spectators) {
+		Retire(spectator, "MOVED\n");
+	}
+
+	if (game.m_Alias != 0) {
+		m_Renamed.erase(game.m_Alias);
+	}
+
+	// The game lives on in the target now, not in a restart of this process.
+	if (m_Sessions != nullptr) {
+		m_Sessions[game.m_Slot].Clear();
+	}
+
+	m_Matchmaker.Release(game.m_Slot);
+	m_Games.erase(gameId);
+
+	FinishDrain();
+}
+
+void GameServer::FinishDrain()
+{
+	if (!m_Games.empty() or m_Migrations.m_DrainTime != 0) {
+		return;
+	}
+
+	m_Migrations.m_DrainTime = NowNanoseconds() - m_DrainStarted;
+
+	// Lobby and finished players reconnect to the new process for their
+	// next game.
+	for (u64 fd = 0; fd < m_Connections.size(); ++fd) {
+		if (m_Connections[fd].m_Open and !m_Connections[fd].m_Retiring) {
+			Retire(static_cast<int>(fd), "MOVED\n");
+		}
+	}
+
+	if (m_OpenConnections == 0) {
+		Stop();
+	}
+	else {
+		m_Scheduler.AddTimer(
+			NowNanoseconds() + DrainGrace, &GameServer::OnDrainTimeout, this);
+	}
+}
+
+int GameServer::Resolve(u64 playerId) const
+{
+	const u64 fd         = playerId & 0xffffffff;
+	const u32 generation = static_cast<u32>(playerId >> 32);
+
+	if (fd >= m_Connections.size()) {
+		return -1;
+	}
+
+	const Connection& connection = m_Connections[fd];
+	if (!connection.m_Open or connection.m_Generation != generation or
+		connection.m_Role != ROLE_QUEUED) {
+		return -1;
+	}
+
+	return static_cast<int>(fd);
+}
+
+bool GameServer::Alive(int fd, u32 generation) const
+{
+	const Connection& connection = m_Connections[fd];
+	return connection.m_Open and connection.m_Generation == generation;
+}
+
+void GameServer::OnMatch(void* context, u64 slot)
+{
+	static_cast<GameServer*>(context)->StartGame(static_cast<u32>(slot));
+}
+
+void GameServer::OnRestore(void* context, u64 slot)
+{
+	static_cast<GameServer*>(context)->StartRestoredGame(static_cast<u32>(slot));
+}
+
+void GameServer::OnDrain(void* context, u64)
+{
+	static_cast<GameServer*>(context)->BeginDrain();
+}
+
+void GameServer::OnDrainTimeout(void* context, u64)
+{
+	static_cast<GameServer*>(context)->Stop();
+}
+
+void GameServer::OnBroken(void* context, u64 fd)
+{
+	auto* server = static_cast<GameServer*>(context);
+	if (server->m_Connections[fd].m_Broken) {
+		server->Close(static_cast<int>(fd));
+	}
+}
+
+void GameServer::OnWritable(void* context, int fd)
+{
+	// The listener and handoff sockets are watched too but have no entry.
+	auto* server = static_cast<GameServer*>(context);
+	if (static_cast<u64>(fd) < server->m_Connections.size() and
+		server->m_Connections[fd].m_Open) {
+		server->Flush(fd);
+	}
+}
+
+static bool ParseNumbers(std::string_view text, u32* values, u32 count)
+{
+	for (u32 i = 0; i < count; ++i) {
+		while (!text.empty() and text.front() == ' ') {
+			text.remove_prefix(1);
+		}
+
+		const auto result =
+			std::from_chars(text.data(), text.data() + text.size(), values[i]);
+		if (result.ec != std::errc {}) {
+			return false;
+		}
+
+		text.remove_prefix(static_cast<u64>(result.ptr - text.data()));
+	}
+
+	return true;
+}
+
+static std::string BoardLine(const Board& board)
+{
+	std::string line { "BOARD " };
+	for (u32 i = 0; i < 9; ++i) {
+		line += static_cast<char>('0' + board.m_Cells[i / 3][i % 3]);
+	}
+	line += ' ';
+	line += board.m_Player1Turn ? '1' : '2';
+	line += ' ';
+	line += std::to_string(board.m_State) + ' ' + std::to_string(board.m_Winner) + '\n';
+
+	return line;
+}
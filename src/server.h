@@ -0,0 +1,237 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "engine_scheduler.h"
+#include "journal.h"
+#include "matchmaker.h"
+#include "runtime.h"
+#include "session.h"
+#include "shard.h"
+#include "snapshot.h"
+#include "spectator.h"
+
+
+// Hosted game service speaking a line protocol over TCP.
+//
+//     JOIN <mode> <rating> <depth> [tenant]  ->  GAME <id> <seat> <token>
+//     MOVE <cell>                            ->  BOARD <cells> <turn> <state> <winner>
+//     RESUME <id> <token>                    ->  GAME <id> <seat> <token>, BOARD ...
+//     SPECTATE <id>                          ->  binary spectator frames (0 = newest game)
+//     STATS                                  ->  STATS <engine scheduler counters>
+//     QUIT
+//
+// Errors are reported as "ERR <reason>". Seat 1 plays X and moves first; in
+// SINGLE_P games the engine takes seat 1 like it does in Game. A server that
+// is draining sends "MOVED" and closes the connection, players then
+// reconnect and RESUME their game with its token.
+//
+// Every connection and every game is a coroutine on one Scheduler, so a
+// game reads as a plain loop that awaits moves, engine results and timeouts.
+//
+// Several servers can share a port as shards. Each one only creates games
+// whose ID it owns on a ShardRing, and a SPECTATE for another shard's game
+// passes the connection to that shard, so a game is only ever touched by
+// one process.
+class GameServer {
+public:
+	static constexpr u64 MoveTimeout    = 60'000'000'000;
+	static constexpr u64 EngineDeadline = 50'000'000;
+	static constexpr u64 DrainGrace     = 2'000'000'000;
+
+	GameServer(u32 slots, u32 engineThreads = 1);
+	~GameServer();
+
+	GameServer(const GameServer&)            = delete;
+	GameServer& operator=(const GameServer&) = delete;
+
+	bool Listen(u32 port, bool reusePort = false);
+
+	// Called before Run() when running as one of several shards on port.
+	bool EnableSharding(u32 shard, u32 shards, u32 port);
+
+	// Called before Run(): accept sessions drained by other processes that
+	// target name.
+	bool AcceptMigrations(const char* name);
+
+	// Called before Run(): finished games are appended to journal.
+	void SetJournal(GameJournal* journal);
+
+	// Called before Run(). Running games are kept in a SnapshotFile at path
+	// after every move, so a server restarted on the same file resumes the
+	// games of the last one, whose players RESUME with their tokens.
+	bool EnableSnapshot(const char* path);
+
+	// Safe from signal handlers. Stops accepting connections, moves every
+	// running game to the process accepting migrations under target and
+	// stops once the last one is gone.
+	void Drain(const char* target);
+
+	// Runs the event loop on the calling thread until Stop().
+	void Run();
+
+	// Safe from any thread and from signal handlers.
+	void Stop();
+
+	u64 GamesPlayed() const;
+	u64 MovesPlayed() const;
+
+	EngineMetrics EngineStats() const;
+
+	struct MigrationStats {
+		u64              m_Sent {};
+		std::atomic<u64> m_Received {};    // polled by MigrationBench
+		u64              m_DrainTime {};    // ns from Drain() to the last game
+		LatencyHistogram m_Restore;         // snapshot received to game running
+		u64              m_Resumed {};      // from the SnapshotFile at startup
+	};
+
+	const MigrationStats& Migrations() const;
+
+private:
+	enum Role {
+		ROLE_NONE,
+		ROLE_QUEUED,
+		ROLE_PLAYER,
+		ROLE_SPECTATOR
+	};
+
+	struct Connection {
+		bool        m_Open {};
+		bool        m_Broken {};
+		bool        m_Retiring {};    // shut down once the output is flushed
+		u32         m_Generation {};
+		Role        m_Role { ROLE_NONE };
+		u64         m_GameId {};
+		u32         m_Seat {};
+		std::string m_Input;
+		std::string m_Output;
+		u64         m_Written {};
+
+		std::shared_ptr<const SpectatorFrame> m_Frame;
+		std::shared_ptr<const SpectatorFrame> m_Next;
+		u64                                   m_FrameOffset {};
+	};
+
+	struct GameEvent {
+		int  m_Fd {};
+		u32  m_Cell {};
+		bool m_Left {};
+		bool m_Wake {};    // no move, only makes the game look at m_Draining
+	};
+
+	static constexpr int Engine = -1;
+	static constexpr int Left   = -2;
+	static constexpr int Away   = -3;    // restored seat waiting for RESUME
+
+	struct LiveGame {
+		explicit LiveGame(Scheduler& scheduler) :
+			m_Events { scheduler }
+		{
+		}
+
+		u32                m_Slot {};
+		int                m_Players[2] { Engine, Engine };
+		u32                m_Tokens[2] {};
+		std::vector<int>   m_Spectators;
+		u64                m_Sequence {};
+		u64                m_TurnStarted {};
+		u64                m_Alias {};    // ID in the process it migrated from
+		unsigned char      m_History[9] {};
+		Mailbox<GameEvent> m_Events;
+	};
+
+	struct Arrival {
+		SessionSnapshot m_Session;
+		u64             m_Received {};
+		bool            m_Local {};    // from our own SnapshotFile
+	};
+
+	int m_Listener;
+	int m_Handoff;
+
+	u32                        m_Port;
+	u32                        m_Shard;
+	std::unique_ptr<ShardRing> m_Ring;
+
+	int                              m_MigrationListener;
+	int                              m_Migration;
+	const char*                      m_DrainTarget;
+	bool                             m_Draining;
+	u64                              m_DrainStarted;
+	u64                              m_OpenConnections;
+	u64                              m_NextTicket;
+	std::unordered_map<u64, Arrival> m_Arriving;
+	std::unordered_map<u64, u64>     m_Renamed;
+	MigrationStats                   m_Migrations;
+	std::mt19937                     m_Random;
+	GameJournal*                     m_Journal;
+
+	u32                            m_Slots;
+	SnapshotFile                   m_Snapshot;
+	SnapshotSlot<SessionSnapshot>* m_Sessions;
+
+	Scheduler       m_Scheduler;
+	Matchmaker      m_Matchmaker;
+	EngineScheduler m_Engine;
+
+	std::vector<Connection>            m_Connections;
+	std::unordered_map<u64, LiveGame>  m_Games;
+	u64                                m_NewestGame;
+	u64                                m_GamesPlayed;
+	std::atomic<u64>                   m_MovesPlayed;
+
+	Task AcceptConnections();
+	Task ServeConnection(int fd, u32 generation);
+	Task PlayGame(u64 gameId);
+	Task AcceptHandoffs();
+	Task AcceptMigrationLinks();
+	Task ReceiveMigrations(int fd);
+
+	void Accept();
+	bool Adopt(int fd);
+	void HandOff(int fd, u32 shard, std::string_view line);
+	void Read(int fd);
+	void Flush(int fd);
+	bool FlushFrame(int fd);
+	void Break(int fd);
+	void Close(int fd);
+	void Retire(int fd, std::string_view text);
+
+	void Handle(int fd, std::string_view line);
+	void Resume(int fd, u64 gameId, u32 token);
+	void Send(int fd, std::string_view text);
+	void SendFrame(int fd, std::shared_ptr<const SpectatorFrame> frame);
+
+	void StartGame(u32 slot);
+	void StartRestoredGame(u32 slot);
+	void Publish(LiveGame& game);
+	void Persist(u64 gameId);
+	void EndGame(u64 gameId);
+
+	void            Admit(const SessionSnapshot& session, bool local);
+	SessionSnapshot Capture(u64 gameId);
+
+	void BeginDrain();
+	void Migrate(u64 gameId);
+	void FinishDrain();
+
+	int  Resolve(u64 playerId) const;
+	bool Alive(int fd, u32 generation) const;
+
+	static void OnMatch(void* context, u64 slot);
+	static void OnRestore(void* context, u64 slot);
+	static void OnDrain(void* context, u64);
+	static void OnDrainTimeout(void* context, u64);
+	static void OnBroken(void* context, u64 fd);
+	static void OnWritable(void* context, int fd);
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "net.h"
+#include "server.h"
+
+
+struct ServerConfig {
+	u32 m_Port          = 7700;
+	u32 m_Slots         = 1 << 16;
+	u32 m_EngineThreads = 1;
+	u32 m_Shards        = 1;
+
+	const char* m_MigrateName {};
+	const char* m_DrainTo {};
+	const char* m_Journal {};
+	const char* m_Snapshot {};
+};
+
+static GameServer* s_Server {};
+static Supervisor* s_Supervisor {};
+static const char* s_DrainTarget {};
+
+static void OnSignal(int)
+{
+	if (s_Server != nullptr) {
+		s_Server->Stop();
+	}
+	if (s_Supervisor != nullptr) {
+		s_Supervisor->Stop();
+	}
+}
+
+static void OnDrainSignal(int)
+{
+	if (s_Server != nullptr and s_DrainTarget != nullptr) {
+		s_Server->Drain(s_DrainTarget);
+	}
+}
+
+// Shards append their index so every shard has a migration partner of its
+// own.
+static std::string LocalName(const char* name, u32 shard, bool shared)
+{
+	return shared ? std::string { name } + '-' + std::to_string(shard) : name;
+}
+
+static void Usage()
+{
+	std::cerr << "Usage: TicTacToeServer [--port N] [--slots N] "
+				 "[--engine-threads N] [--shards N] [--migrate-name NAME] "
+				 "[--drain-to NAME] [--journal PATH] [--snapshot PATH]"
+			  << std::endl;
+}
+
+static int Serve(u32 shard, void* context)
+{
+	const ServerConfig& config = *static_cast<const ServerConfig*>(context);
+	const bool          shared = config.m_Shards > 1;
+
+	// A forked worker must not signal its siblings through the parent's
+	// supervisor.
+	s_Supervisor = nullptr;
+
+	// Always SO_REUSEPORT, so an upgraded process can start on the port
+	// before the old one drains into it.
+	GameServer server { config.m_Slots, config.m_EngineThreads };
+	if (!server.Listen(config.m_Port, true)) {
+		return Supervisor::SetupFailed;
+	}
+	if (shared and !server.EnableSharding(shard, config.m_Shards, config.m_Port)) {
+		return Supervisor::SetupFailed;
+	}
+
+	const std::string migrateName =
+		config.m_MigrateName ? LocalName(config.m_MigrateName, shard, shared) : "";
+	const std::string drainTarget =
+		config.m_DrainTo ? LocalName(config.m_DrainTo, shard, shared) : "";
+
+	if (config.m_MigrateName and !server.AcceptMigrations(migrateName.c_str())) {
+		return Supervisor::SetupFailed;
+	}
+
+	GameJournal       journal {};
+	const std::string journalPath =
+		config.m_Journal ? LocalName(config.m_Journal, shard, shared) : "";
+
+	if (config.m_Journal) {
+		if (!journal.Open(journalPath.c_str())) {
+			return Supervisor::SetupFailed;
+		}
+		server.SetJournal(&journal);
+	}
+
+	const std::string snapshotPath =
+		config.m_Snapshot ? LocalName(config.m_Snapshot, shard, shared) : "";
+
+	if (config.m_Snapshot and !server.EnableSnapshot(snapshotPath.c_str())) {
+		return Supervisor::SetupFailed;
+	}
+
+	s_Server      = &server;
+	s_DrainTarget = config.m_DrainTo ? drainTarget.c_str() : nullptr;
+	std::signal(SIGINT, OnSignal);
+	std::signal(SIGTERM, OnSignal);
+	std::signal(SIGUSR1, OnDrainSignal);
+
+	if (shared) {
+		std::cout << "Shard " << shard << " serving on port " << config.m_Port
+				  << std::endl;
+	}
+	else {
+		std::cout << "Serving on port " << config.m_Port << std::endl;
+	}
+	server.Run();
+
+	const FrameStats frames = CurrentFrameStats();
+
+	if (shared) {
+		std::cout << "Shard " << shard << ": ";
+	}
+	std::cout << "Games played: " << server.GamesPlayed()
+			  << ", moves: " << server.MovesPlayed() << std::endl;
+	std::cout << "Suspended sessions: " << frames.m_Live << " ("
+			  << frames.m_LiveBytes << " bytes, largest frame "
+			  << frames.m_LargestFrame << " bytes)" << std::endl;
+
+	const EngineMetrics engine = server.EngineStats();
+
+	std::cout << "Engine: " << engine.m_Completed << " searches, "
+			  << engine.m_DeadlineMisses << " deadline misses, " << engine.m_Reduced
+			  << " reduced, " << engine.m_TableLookups << " table lookups, "
+			  << engine.m_Slices << " slices, max queue " << engine.m_MaxQueueDepth
+			  << std::endl;
+	engine.m_Latency.Print(std::cout, "engine");
+
+	if (config.m_Journal) {
+		journal.Close();
+
+		const JournalStats stats = journal.Stats();
+		std::cout << "Journal: " << stats.m_Durable << " games in " << stats.m_Commits
+				  << " commits" << std::endl;
+		stats.m_Commit.Print(std::cout, "commit");
+	}
+
+	const auto& migrations = server.Migrations();
+	if (migrations.m_Sent > 0) {
+		std::cout << "Migrated out: " << migrations.m_Sent << " sessions in "
+				  << migrations.m_DrainTime / 1'000'000 << " ms" << std::endl;
+	}
+	if (migrations.m_Resumed > 0) {
+		std::cout << "Resumed from snapshot: " << migrations.m_Resumed << " sessions"
+				  << std::endl;
+	}
+	if (migrations.m_Received > 0) {
+		std::cout << "Migrated in: " << migrations.m_Received << " sessions" << std::endl;
+		migrations.m_Restore.Print(std::cout, "restore");
+	}
+
+	return 0;
+}
+
+//     TicTacToeServer [--port N] [--slots N] [--engine-threads N] [--shards N]
+//                     [--migrate-name NAME] [--drain-to NAME] [--journal PATH]
+//                     [--snapshot PATH]
+//
+// With --drain-to, SIGUSR1 moves every running game to the server started
+// with the matching --migrate-name and exits. With --snapshot, a server
+// restarted after a crash or a plain stop picks up the games that were
+// running.
+int main(int argc, char* argv[])
+{
+	ServerConfig config {};
+
+	for (int i = 1; i < argc; i += 2) {
+		if (i + 1 >= argc) {
+			Usage();
+			return -1;
+		}
+
+		const u32 value = static_cast<u32>(std::strtoul(argv[i + 1], nullptr, 10));
+
+		if (std::strcmp(argv[i], "--migrate-name") == 0) {
+			config.m_MigrateName = argv[i + 1];
+		}
+		else if (std::strcmp(argv[i], "--drain-to") == 0) {
+			config.m_DrainTo = argv[i + 1];
+		}
+		else if (std::strcmp(argv[i], "--journal") == 0) {
+			config.m_Journal = argv[i + 1];
+		}
+		else if (std::strcmp(argv[i], "--snapshot") == 0) {
+			config.m_Snapshot = argv[i + 1];
+		}
+		else if (std::strcmp(argv[i], "--port") == 0) {
+			config.m_Port = value;
+		}
+		else if (std::strcmp(argv[i], "--slots") == 0) {
+			config.m_Slots = value;
+		}
+		else if (std::strcmp(argv[i], "--engine-threads") == 0) {
+			config.m_EngineThreads = value;
+		}
+		else if (std::strcmp(argv[i], "--shards") == 0) {
+			config.m_Shards = value;
+		}
+		else {
+			Usage();
+			return -1;
+		}
+	}
+
+	// Every player and spectator holds a descriptor, shards inherit the limit.
+	RaiseFileLimit();
+
+	if (config.m_Shards <= 1) {
+		return Serve(0, &config);
+	}
+
+	// Each shard is a separate process on the same port, the kernel spreads
+	// new connections between them.
+	Supervisor supervisor { config.m_Shards, &Serve, &config };
+
+	s_Supervisor = &supervisor;
+	std::signal(SIGINT, OnSignal);
+	std::signal(SIGTERM, OnSignal);
+	std::signal(SIGUSR1, SIG_IGN);    // drain individual shards instead
+
+	return supervisor.Run();
+}
@@ -0,0 +1,112 @@
+#include <cstring>
+
+#include "session.h"
+
+
+namespace {
+
+	template <typename T>
+	void Put(unsigned char* out, T value)
+	{
+		std::memcpy(out, &value, sizeof(T));
+	}
+
+	template <typename T>
+	T Get(const unsigned char* in)
+	{
+		T value {};
+		std::memcpy(&value, in, sizeof(T));
+		return value;
+	}
+
+}    // namespace
+
+//     0  version        1  flags (engine seats, mode)   2  engine depth
+//     4  tenant         8  game id                      16 sequence
+//     24 tokens         32 waited                       40 board word
+//     44 move list, one nibble per move
+std::vector<unsigned char> EncodeSession(const SessionSnapshot& session)
+{
+	std::vector<unsigned char> out(SessionSnapshot::EncodedSize);
+
+	const Board& board = session.m_Board;
+
+	u32 word {};
+	for (u32 i = 0; i < 9; ++i) {
+		word |= static_cast<u32>(board.m_Cells[i / 3][i % 3]) << (i * 2);
+	}
+	word |= board.m_Moves << 18;
+	word |= (board.m_Player1Turn ? 1u : 0u) << 22;
+	word |= static_cast<u32>(board.m_State) << 23;
+	word |= static_cast<u32>(board.m_Winner + 1) << 25;
+
+	out[0] = SessionSnapshot::Version;
+	out[1] = (session.m_Engine[0] ? 1 : 0) | (session.m_Engine[1] ? 2 : 0) |
+			 (session.m_Mode == MULTI_P ? 4 : 0);
+	out[2] = static_cast<unsigned char>(session.m_EngineDepth);
+
+	Put<u32>(&out[4], session.m_Tenant);
+	Put<u64>(&out[8], session.m_GameId);
+	Put<u64>(&out[16], session.m_Sequence);
+	Put<u32>(&out[24], session.m_Tokens[0]);
+	Put<u32>(&out[28], session.m_Tokens[1]);
+	Put<u64>(&out[32], session.m_Waited);
+	Put<u32>(&out[40], word);
+
+	for (u32 i = 0; i < board.m_Moves and i < 9; ++i) {
+		out[44 + i / 2] |= static_cast<unsigned char>(session.m_History[i] << (i % 2 * 4));
+	}
+
+	return out;
+}
+
+bool DecodeSession(const unsigned char* data, u64 size, SessionSnapshot& session)
+{
+	if (size != SessionSnapshot::EncodedSize or data[0] != SessionSnapshot::Version) {
+		return false;
+	}
+
+	session               = SessionSnapshot {};
+	session.m_Engine[0]   = (data[1] & 1) != 0;
+	session.m_Engine[1]   = (data[1] & 2) != 0;
+	session.m_Mode        = (data[1] & 4) != 0 ? MULTI_P : SINGLE_P;
+	session.m_EngineDepth = data[2];
+	session.m_Tenant      = Get<u32>(data + 4);
+	session.m_GameId      = Get<u64>(data + 8);
+	session.m_Sequence    = Get<u64>(data + 16);
+	session.m_Tokens[0]   = Get<u32>(data + 24);
+	session.m_Tokens[1]   = Get<u32>(data + 28);
+	session.m_Waited      = Get<u64>(data + 32);
+
+	const u32 word  = Get<u32>(data + 40);
+	Board&    board = session.m_Board;
+
+	u32 marked {};
+	for (u32 i = 0; i < 9; ++i) {
+		const i32 cell = static_cast<i32>(word >> (i * 2) & 3);
+		if (cell > 2) {
+			return false;
+		}
+		board.m_Cells[i / 3][i % 3] = cell;
+		marked += cell != 0 ? 1 : 0;
+	}
+
+	board.m_Moves       = word >> 18 & 15;
+	board.m_Player1Turn = (word >> 22 & 1) != 0;
+	board.m_State       = static_cast<GameState>(word >> 23 & 3);
+	board.m_Winner      = static_cast<Utility>(static_cast<i32>(word >> 25 & 3) - 1);
+
+	if (board.m_Moves != marked or board.m_State > GAME_OVER or
+		board.m_Winner > Utility::X or session.m_EngineDepth > PerfectDepth) {
+		return false;
+	}
+
+	for (u32 i = 0; i < board.m_Moves; ++i) {
+		session.m_History[i] = data[44 + i / 2] >> (i % 2 * 4) & 15;
+		if (session.m_History[i] > 8) {
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,34 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <vector>
+
+#include "rules.h"
+
+
+// Everything a hosted game needs to continue in another process. Players
+// are not part of it: they reconnect to the new process and claim their
+// seat with the token they were given when the game started.
+struct SessionSnapshot {
+	static constexpr u32 Version     = 1;
+	static constexpr u32 EncodedSize = 49;
+
+	u64           m_GameId {};
+	u64           m_Sequence {};
+	u32           m_Tokens[2] {};
+	bool          m_Engine[2] {};     // seats played by the engine
+	u64           m_Waited {};        // ns the side to move has already used
+	Board         m_Board {};
+	GameMode      m_Mode { MULTI_P };
+	u32           m_EngineDepth { PerfectDepth };
+	u32           m_Tenant {};
+	unsigned char m_History[9] {};    // cells in the order they were played
+};
+
+// Fixed size little-endian encoding. The board, turn and result share one
+// word and the move list takes a nibble per move, so a session is
+// EncodedSize bytes on the wire.
+std::vector<unsigned char> EncodeSession(const SessionSnapshot& session);
+bool DecodeSession(const unsigned char* data, u64 size, SessionSnapshot& session);
+
+#endif
@@ -1,88 +1,285 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
-#include <sstream>
+#include <string>
 
+#include "histogram.h"
 #include "shader.h"
 
+
+// glMaxShaderCompilerThreadsKHR is not in glad's core profile loader, it is
+// fetched by hand when the driver has GL_KHR_parallel_shader_compile.
+using MaxCompilerThreadsProc = void (*)(unsigned int count);
+
+static constexpr u32 CacheMagic = 0x42535454;    // "TTSB"
+
+struct CacheHeader {
+	u32 m_Magic;
+	u32 m_Format;
+	u64 m_Key;
+	u64 m_Size;
+};
+
+static u64 Fnv1a(u64 hash, std::string_view text)
+{
+	for (const char c : text) {
+		hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+	}
+	// Separates fields, so "ab" + "c" and "a" + "bc" differ.
+	return (hash ^ 0xff) * 1099511628211ull;
+}
+
+static bool ReadFile(const char* path, std::string& out)
+{
+	std::ifstream file { path, std::ios::binary | std::ios::ate };
+	if (!file) {
+		std::cout << "Error: Could not load shader file " << path << std::endl;
+		return false;
+	}
+
+	out.resize(static_cast<u64>(file.tellg()));
+	file.seekg(0);
+	return static_cast<bool>(file.read(out.data(), static_cast<std::streamsize>(out.size())));
+}
+
 void Shader::Load(
 	const char* vertexPath,
 	const char* fragPath,
 	const char* geoPath)
 {
-	std::stringstream fragSource {};
-	std::stringstream vertexSource {};
-	std::stringstream geoSource {};
+	ShaderBuilder builder {};
+	builder.Add(*this, vertexPath, fragPath, geoPath);
+	builder.Build();
+}
+
+ShaderBuilder::ShaderBuilder(const char* cacheDirectory) :
+	m_Directory { cacheDirectory != nullptr ? cacheDirectory : "" },
+	m_Stats {}
+{
+}
+
+void ShaderBuilder::Add(
+	Shader&     shader,
+	const char* vertexPath,
+	const char* fragPath,
+	const char* geoPath)
+{
+	Program program {};
+	program.m_Shader = &shader;
+
+	ReadFile(vertexPath, program.m_Sources[0]);
+	ReadFile(fragPath, program.m_Sources[1]);
+	if (geoPath != nullptr) {
+		ReadFile(geoPath, program.m_Sources[2]);
+	}
+
+	m_Programs.push_back(std::move(program));
+}
+
+void ShaderBuilder::AddSources(
+	Shader&          shader,
+	std::string_view vertex,
+	std::string_view frag,
+	std::string_view geo)
+{
+	Program program {};
+	program.m_Shader     = &shader;
+	program.m_Sources[0] = vertex;
+	program.m_Sources[1] = frag;
+	program.m_Sources[2] = geo;
+
+	m_Programs.push_back(std::move(program));
+}
+
+bool ShaderBuilder::Build()
+{
+	static constexpr unsigned int Stages[3] = {
+		GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER
+	};
+	static constexpr const char* StageNames[3] = {
+		"Vertex Shader", "Fragment Shader", "Geometry Shader"
+	};
+
+	const u64 start = NowNanoseconds();
 
-	try {
-		std::ifstream file {};
-		file.open(vertexPath);
-		vertexSource << file.rdbuf();
-		file.close();
+	m_Stats            = ShaderBuildStats {};
+	m_Stats.m_Programs = static_cast<u32>(m_Programs.size());
 
-		file.open(fragPath);
-		fragSource << file.rdbuf();
-		file.close();
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+		const auto maxThreads = reinterpret_cast<MaxCompilerThreadsProc>(
+			glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+		if (maxThreads != nullptr) {
+			maxThreads(0xffffffff);
+			m_Stats.m_Parallel = true;
+		}
+	}
 
-		if (geoPath != nullptr) {
-			file.open(geoPath);
-			geoSource << file.rdbuf();
-			file.close();
+	// The driver identifies the compiler that produced a binary.
+	u64 driver = 14695981039346656037ull;
+	for (const unsigned int name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		const auto* text = reinterpret_cast<const char*>(glGetString(name));
+		driver           = Fnv1a(driver, text != nullptr ? text : "");
+	}
+
+	int formats {};
+	if (glGetProgramBinary != nullptr) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	const bool caching = !m_Directory.empty() and formats > 0;
+
+	// Everything is issued before anything is checked.
+	for (Program& program : m_Programs) {
+		program.m_Key = driver;
+		for (const std::string& source : program.m_Sources) {
+			program.m_Key = Fnv1a(program.m_Key, source);
+		}
+
+		program.m_Shader->m_SID = glCreateProgram();
+		program.m_Cached        = caching and Restore(program);
+		if (program.m_Cached) {
+			continue;
 		}
+
+		for (u32 i = 0; i < 3; ++i) {
+			if (program.m_Sources[i].empty()) {
+				continue;
+			}
+
+			const char* source  = program.m_Sources[i].c_str();
+			program.m_Stages[i] = glCreateShader(Stages[i]);
+			glShaderSource(program.m_Stages[i], 1, &source, NULL);
+			glCompileShader(program.m_Stages[i]);
+			glAttachShader(program.m_Shader->m_SID, program.m_Stages[i]);
+		}
+
+		if (caching) {
+			glProgramParameteri(
+				program.m_Shader->m_SID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+		glLinkProgram(program.m_Shader->m_SID);
 	}
-	catch (const std::ifstream::failure&) {
-		std::cout << "Error: Could not load shader file from source path"
-				  << std::endl;
+
+	for (Program& program : m_Programs) {
+		Shader& shader = *program.m_Shader;
+
+		int linked {};
+		glGetProgramiv(shader.m_SID, GL_LINK_STATUS, &linked);
+
+		if (!linked) {
+			for (u32 i = 0; i < 3; ++i) {
+				if (program.m_Stages[i] != 0) {
+					shader.LogError(program.m_Stages[i], StageNames[i]);
+				}
+			}
+			shader.LogError(shader.m_SID, "Binary");
+			++m_Stats.m_Failed;
+		}
+		else if (program.m_Cached) {
+			++m_Stats.m_Cached;
+		}
+		else if (caching) {
+			Save(program);
+		}
+
+		for (unsigned int& stage : program.m_Stages) {
+			if (stage != 0) {
+				glDetachShader(shader.m_SID, stage);
+				glDeleteShader(stage);
+				stage = 0;
+			}
+		}
+
+		shader.Reflect();
 	}
 
-	Compile(
-		vertexSource.str().c_str(),
-		fragSource.str().c_str(),
-		geoPath != nullptr ? geoSource.str().c_str() : nullptr);
+	m_Programs.clear();
+	m_Stats.m_Time = NowNanoseconds() - start;
+
+	return m_Stats.m_Failed == 0;
+}
+
+const ShaderBuildStats& ShaderBuilder::Stats() const
+{
+	return m_Stats;
 }
 
-void Shader::Compile(
-	const char* vertexSource,
-	const char* fragSource,
-	const char* geoSource)
+bool ShaderBuilder::Restore(Program& program)
 {
-	unsigned int vShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vShader, 1, &vertexSource, NULL);
-	glCompileShader(vShader);
-	LogError(vShader, "Vertex Shader");
+	std::ifstream file { CachePath(program), std::ios::binary };
+	CacheHeader   header {};
 
-	unsigned int fShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fShader, 1, &fragSource, NULL);
-	glCompileShader(fShader);
-	LogError(fShader, "Fragment Shader");
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) or
+		header.m_Magic != CacheMagic or header.m_Key != program.m_Key or
+		header.m_Size > (1u << 26)) {
+		return false;
+	}
 
-	unsigned int gShader {};
-	if (geoSource != nullptr) {
-		gShader = glCreateShader(GL_GEOMETRY_SHADER);
-		glShaderSource(gShader, 1, &geoSource, NULL);
-		glCompileShader(gShader);
-		LogError(gShader, "Geometry Shader");
+	std::vector<char> binary(header.m_Size);
+	if (!file.read(binary.data(), static_cast<std::streamsize>(binary.size()))) {
+		return false;
 	}
 
-	m_SID = glCreateProgram();
-	glAttachShader(m_SID, vShader);
-	glAttachShader(m_SID, fShader);
+	glProgramBinary(
+		program.m_Shader->m_SID,
+		header.m_Format,
+		binary.data(),
+		static_cast<int>(binary.size()));
+
+	// A driver update can refuse an old blob, the program is then built
+	// from source on a fresh ID.
+	int linked {};
+	glGetProgramiv(program.m_Shader->m_SID, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		glDeleteProgram(program.m_Shader->m_SID);
+		program.m_Shader->m_SID = glCreateProgram();
+	}
+	return linked != 0;
+}
 
-	if (geoSource != nullptr) {
-		glAttachShader(m_SID, gShader);
+void ShaderBuilder::Save(const Program& program)
+{
+	int size {};
+	glGetProgramiv(program.m_Shader->m_SID, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (size <= 0) {
+		return;
 	}
 
-	glLinkProgram(m_SID);
-	LogError(m_SID, "Binary");
+	std::vector<char> binary(static_cast<u32>(size));
+	unsigned int      format {};
+	glGetProgramBinary(program.m_Shader->m_SID, size, &size, &format, binary.data());
+
+	const CacheHeader header { CacheMagic, format, program.m_Key, static_cast<u64>(size) };
+
+	std::error_code error {};
+	std::filesystem::create_directories(m_Directory, error);
 
-	glDeleteShader(vShader);
-	glDeleteShader(fShader);
+	// Written aside and renamed, so a crash never leaves half a blob.
+	const std::filesystem::path path      = CachePath(program);
+	std::filesystem::path       temporary = path;
+	temporary += ".tmp";
 
-	if (geoSource != nullptr) {
-		glDeleteShader(gShader);
+	{
+		std::ofstream file { temporary, std::ios::binary | std::ios::trunc };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), size);
+		if (!file) {
+			std::cout << "Error: Could not write shader cache " << temporary << std::endl;
+			return;
+		}
 	}
+
+	std::filesystem::rename(temporary, path, error);
+}
+
+std::filesystem::path ShaderBuilder::CachePath(const Program& program) const
+{
+	char name[32] {};
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(program.m_Key));
+	return m_Directory / name;
 }
 
 void Shader::LogError(unsigned int id, const std::string_view& name)
@@ -113,3 +310,151 @@ Shader& Shader::Use()
 	glUseProgram(m_SID);
 	return *this;
 }
+
+// Looks up every active uniform and block once after linking, so the render
+// path never asks the driver for a location.
+void Shader::Reflect()
+{
+	m_Uniforms.clear();
+	m_Blocks.clear();
+
+	int count {};
+	int longest {};
+	glGetProgramiv(m_SID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_SID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &longest);
+
+	std::string name(static_cast<u32>(std::max(longest, 1)), '\0');
+
+	for (int i = 0; i < count; ++i) {
+		int          length {};
+		int          size {};
+		unsigned int type {};
+		glGetActiveUniform(
+			m_SID, static_cast<unsigned int>(i), longest, &length, &size, &type, name.data());
+
+		// Block members have no location of their own.
+		const int location = glGetUniformLocation(m_SID, name.c_str());
+		if (location == -1) {
+			continue;
+		}
+
+		// Arrays are reported as "name[0]" and set through their first
+		// element.
+		std::string_view base { name.data(), static_cast<u32>(length) };
+		if (base.ends_with("[0]")) {
+			base.remove_suffix(3);
+		}
+
+		m_Uniforms.push_back(ActiveUniform { UniformName(base), location });
+	}
+
+	glGetProgramiv(m_SID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	glGetProgramiv(m_SID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &longest);
+
+	name.assign(static_cast<u32>(std::max(longest, 1)), '\0');
+
+	for (int i = 0; i < count; ++i) {
+		int length {};
+		int size {};
+		glGetActiveUniformBlockName(
+			m_SID, static_cast<unsigned int>(i), longest, &length, name.data());
+		glGetActiveUniformBlockiv(
+			m_SID, static_cast<unsigned int>(i), GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+
+		m_Blocks.push_back(ActiveBlock {
+			UniformName({ name.data(), static_cast<u32>(length) }),
+			static_cast<unsigned int>(i),
+			size });
+	}
+
+	std::sort(m_Uniforms.begin(), m_Uniforms.end(), [](const auto& a, const auto& b) {
+		return a.m_Name < b.m_Name;
+	});
+}
+
+UniformHandle Shader::Uniform(u32 name) const
+{
+	const auto found = std::lower_bound(
+		m_Uniforms.begin(), m_Uniforms.end(), name, [](const ActiveUniform& uniform, u32 name) {
+			return uniform.m_Name < name;
+		});
+
+	if (found == m_Uniforms.end() or found->m_Name != name) {
+		return UniformHandle {};
+	}
+	return UniformHandle { found->m_Location };
+}
+
+Shader& Shader::Set(UniformHandle uniform, int value)
+{
+	glUniform1i(uniform.m_Location, value);
+	return *this;
+}
+
+Shader& Shader::Set(UniformHandle uniform, float value)
+{
+	glUniform1f(uniform.m_Location, value);
+	return *this;
+}
+
+Shader& Shader::Set(UniformHandle uniform, float x, float y)
+{
+	glUniform2f(uniform.m_Location, x, y);
+	return *this;
+}
+
+Shader& Shader::Set(UniformHandle uniform, float x, float y, float z, float w)
+{
+	glUniform4f(uniform.m_Location, x, y, z, w);
+	return *this;
+}
+
+bool Shader::BindBlock(u32 name, u32 binding, u32 size)
+{
+	for (const ActiveBlock& block : m_Blocks) {
+		if (block.m_Name != name) {
+			continue;
+		}
+
+		if (static_cast<u32>(block.m_Size) > size) {
+			std::cout << "Error! Uniform block needs " << block.m_Size << " bytes, the buffer has "
+					  << size << std::endl;
+			return false;
+		}
+
+		glUniformBlockBinding(m_SID, block.m_Index, binding);
+		return true;
+	}
+	return false;
+}
+
+UniformBuffer::UniformBuffer() :
+	m_Buffer {},
+	m_Size {}
+{
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	if (m_Buffer != 0) {
+		glDeleteBuffers(1, &m_Buffer);
+	}
+}
+
+void UniformBuffer::Init(u32 binding, u32 size)
+{
+	m_Size = size;
+
+	glGenBuffers(1, &m_Buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_Buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::Update(const void* data, u32 size)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, std::min(size, m_Size), data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -1,14 +1,35 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+#include <string>
 #include <string_view>
 #include <filesystem>
+#include <vector>
 
+#include "rules.h"
+
+
+// FNV-1a of a uniform or block name. Callers keep the hashes in constants,
+// so a lookup never hashes a string at run time.
+constexpr u32 UniformName(std::string_view name)
+{
+	u32 hash = 2166136261u;
+	for (const char c : name) {
+		hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+	}
+	return hash;
+}
+
+// Location of an active uniform, found once and kept by the caller.
+struct UniformHandle {
+	int m_Location { -1 };
+};
 
 class Shader {
 public:
 	unsigned int m_SID;
 
+	// Builds one program on its own, see ShaderBuilder for several.
 	void Load(
 		const char* vertexPath,
 		const char* fragPath,
@@ -16,10 +37,128 @@ public:
 
 	Shader& Use();
 
+	// Null handle for a name the program does not use.
+	UniformHandle Uniform(u32 name) const;
+
+	// On the program in use. Unknown names and null handles are ignored like
+	// location -1 is by GL.
+	Shader& Set(UniformHandle uniform, int value);
+	Shader& Set(UniformHandle uniform, float value);
+	Shader& Set(UniformHandle uniform, float x, float y);
+	Shader& Set(UniformHandle uniform, float x, float y, float z, float w);
+
+	template<typename... Values>
+	Shader& Set(u32 name, Values... values)
+	{
+		return Set(Uniform(name), values...);
+	}
+
+	// Points the uniform block called name at a UniformBuffer binding of size
+	// bytes, false when the program has no such block or needs a larger one.
+	bool BindBlock(u32 name, u32 binding, u32 size);
+
 private:
-	void Compile(const char* v, const char* f, const char* g = nullptr);
+	friend class ShaderBuilder;
+
+	struct ActiveUniform {
+		u32 m_Name;
+		int m_Location;
+	};
+
+	struct ActiveBlock {
+		u32          m_Name;
+		unsigned int m_Index;
+		int          m_Size;
+	};
+
+	// Sorted by name hash.
+	std::vector<ActiveUniform> m_Uniforms;
+	std::vector<ActiveBlock>   m_Blocks;
+
 	void LogError(unsigned int id, const std::string_view& name);
+	void Reflect();
+
+};
+
+struct ShaderBuildStats {
+	u32  m_Programs {};
+	u32  m_Cached {};      // loaded from a program binary
+	u32  m_Failed {};
+	bool m_Parallel {};    // the driver compiled on threads of its own
+	u64  m_Time {};        // ns until every program was usable
+};
+
+// Builds every program of a scene in one go. All compiles and links are
+// issued before the first status is read, so a driver with
+// GL_KHR_parallel_shader_compile works on them side by side, and the
+// checks then wait once for everything.
+//
+// With a cache directory, linked programs are kept as glGetProgramBinary
+// blobs in files named after a hash of their sources and of the driver's
+// vendor, renderer and version, and later starts load those instead of
+// compiling. A blob the driver refuses is rebuilt from source.
+class ShaderBuilder {
+public:
+	explicit ShaderBuilder(const char* cacheDirectory = nullptr);
 
+	void Add(
+		Shader&     shader,
+		const char* vertexPath,
+		const char* fragPath,
+		const char* geoPath = nullptr);
+
+	void AddSources(
+		Shader&          shader,
+		std::string_view vertex,
+		std::string_view frag,
+		std::string_view geo = {});
+
+	// Needs a current GL context. False when any program failed.
+	bool Build();
+
+	const ShaderBuildStats& Stats() const;
+
+private:
+	struct Program {
+		Shader*      m_Shader;
+		std::string  m_Sources[3];    // vertex, fragment, geometry
+		u64          m_Key;
+		bool         m_Cached;
+		unsigned int m_Stages[3];
+	};
+
+	std::filesystem::path m_Directory;
+	std::vector<Program>  m_Programs;
+	ShaderBuildStats      m_Stats;
+
+	bool Restore(Program& program);
+	void Save(const Program& program);
+	std::filesystem::path CachePath(const Program& program) const;
+};
+
+// Uniform buffer on a binding point that every program sharing the block
+// reads, written once per frame instead of once per program.
+class UniformBuffer {
+public:
+	UniformBuffer();
+	~UniformBuffer();
+
+	UniformBuffer(const UniformBuffer&)            = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	// Needs a current GL context.
+	void Init(u32 binding, u32 size);
+	void Update(const void* data, u32 size);
+
+	template<typename T>
+	void Update(const T& data)
+	{
+		Update(&data, sizeof(T));
+	}
+
+private:
+	unsigned int m_Buffer;
+	u32          m_Size;
 };
 
-#endif
\ No newline at end of file
+#endif
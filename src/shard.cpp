@@ -0,0 +1,154 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "histogram.h"
+#include "shard.h"
+
+
+static u64 Mix(u64 value)
+{
+	// splitmix64 finalizer
+	value ^= value >> 30;
+	value *= 0xbf58476d1ce4e5b9;
+	value ^= value >> 27;
+	value *= 0x94d049bb133111eb;
+	value ^= value >> 31;
+	return value;
+}
+
+ShardRing::ShardRing(u32 shards) :
+	m_Shards { shards == 0 ? 1 : shards }
+{
+	m_Points.reserve(static_cast<u64>(m_Shards) * VirtualNodes);
+
+	for (u32 shard = 0; shard < m_Shards; ++shard) {
+		for (u32 node = 0; node < VirtualNodes; ++node) {
+			m_Points.emplace_back(Mix(static_cast<u64>(shard) << 32 | node), shard);
+		}
+	}
+
+	std::sort(m_Points.begin(), m_Points.end());
+}
+
+u32 ShardRing::Owner(u64 gameId) const
+{
+	const u64 hash  = Mix(gameId);
+	auto      point = std::lower_bound(
+		m_Points.begin(), m_Points.end(), std::pair<u64, u32> { hash, 0 });
+
+	return point == m_Points.end() ? m_Points.front().second : point->second;
+}
+
+u32 ShardRing::Shards() const
+{
+	return m_Shards;
+}
+
+Supervisor::Supervisor(u32 shards, WorkerMain main, void* context) :
+	m_Main { main },
+	m_Context { context },
+	m_Stopping { 0 },
+	m_Failed { false },
+	m_Workers(shards == 0 ? 1 : shards, -1),
+	m_Started(m_Workers.size())
+{
+}
+
+int Supervisor::Run()
+{
+	for (u32 shard = 0; shard < m_Workers.size(); ++shard) {
+		if (!Spawn(shard)) {
+			m_Failed = true;
+			Stop();
+			break;
+		}
+	}
+
+	while (true) {
+		int         status {};
+		const pid_t pid = waitpid(-1, &status, 0);
+
+		if (pid == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			// ECHILD: every worker is gone.
+			return m_Failed ? -1 : 0;
+		}
+
+		const auto worker = std::find(m_Workers.begin(), m_Workers.end(), pid);
+		if (worker == m_Workers.end()) {
+			continue;
+		}
+
+		const u32 shard = static_cast<u32>(worker - m_Workers.begin());
+		*worker         = -1;
+
+		if (WIFEXITED(status) and WEXITSTATUS(status) == SetupFailed) {
+			if (!m_Stopping) {
+				std::cerr << "Shard " << shard << " failed to start, stopping" << std::endl;
+				m_Failed = true;
+				Stop();
+			}
+			continue;
+		}
+
+		const bool crashed = !WIFEXITED(status) or WEXITSTATUS(status) != 0;
+		if (m_Stopping or !crashed) {
+			continue;
+		}
+
+		std::cerr << "Shard " << shard << " ";
+		if (WIFSIGNALED(status)) {
+			std::cerr << "killed by signal " << WTERMSIG(status);
+		}
+		else {
+			std::cerr << "exited with status " << WEXITSTATUS(status);
+		}
+		std::cerr << ", restarting" << std::endl;
+
+		// Do not spin on a worker that dies right away.
+		if (NowNanoseconds() - m_Started[shard] < CrashBackoff) {
+			sleep(1);
+		}
+
+		if (!m_Stopping) {
+			Spawn(shard);
+		}
+	}
+}
+
+void Supervisor::Stop()
+{
+	m_Stopping = 1;
+
+	for (const pid_t pid : m_Workers) {
+		if (pid > 0) {
+			kill(pid, SIGTERM);
+		}
+	}
+}
+
+bool Supervisor::Spawn(u32 shard)
+{
+	const pid_t pid = fork();
+	if (pid == -1) {
+		std::cerr << "fork failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	if (pid == 0) {
+		std::exit(m_Main(shard, m_Context));
+	}
+
+	m_Workers[shard] = pid;
+	m_Started[shard] = NowNanoseconds();
+
+	return true;
+}
@@ -0,0 +1,64 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <sys/types.h>
+
+#include <csignal>
+#include <utility>
+#include <vector>
+
+#include "rules.h"
+
+
+// Consistent hash ring mapping game IDs to shards. Every shard owns
+// VirtualNodes points on the ring, so changing the shard count only moves
+// the IDs between the old and new points.
+class ShardRing {
+public:
+	static constexpr u32 VirtualNodes = 64;
+
+	explicit ShardRing(u32 shards);
+
+	u32 Owner(u64 gameId) const;
+	u32 Shards() const;
+
+private:
+	std::vector<std::pair<u64, u32>> m_Points;    // sorted by hash
+	u32                              m_Shards;
+};
+
+// Forks one worker process per shard and restarts workers that crash. A
+// worker that exits with status 0 is considered stopped on purpose, one
+// that exits with SetupFailed stops them all.
+class Supervisor {
+public:
+	using WorkerMain = int (*)(u32 shard, void* context);
+
+	// Exit status of a worker that could not start, on a busy port or a bad
+	// path. A restart would fail the same way.
+	static constexpr int SetupFailed = 78;
+
+	Supervisor(u32 shards, WorkerMain main, void* context);
+
+	// Blocks until every worker has exited after Stop(). Returns -1 when a
+	// worker failed to start.
+	int Run();
+
+	// Safe from signal handlers.
+	void Stop();
+
+private:
+	static constexpr u64 CrashBackoff = 1'000'000'000;
+
+	WorkerMain            m_Main;
+	void*                 m_Context;
+	volatile sig_atomic_t m_Stopping;
+	bool                  m_Failed;
+
+	std::vector<pid_t> m_Workers;
+	std::vector<u64>   m_Started;
+
+	bool Spawn(u32 shard);
+};
+
+#endif
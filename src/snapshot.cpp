@@ -0,0 +1,148 @@
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "snapshot.h"
+
+
+static constexpr char Magic[8] = { 'T', 'T', 'T', 'S', 'N', 'A', 'P', '1' };
+static constexpr u64  PageSize = 4096;
+
+static u64 RoundUp(u64 value)
+{
+	return (value + PageSize - 1) / PageSize * PageSize;
+}
+
+SnapshotFile::SnapshotFile() :
+	m_File { -1 },
+	m_Map { nullptr },
+	m_MapSize {},
+	m_Restored { false },
+	m_Header {}
+{
+}
+
+SnapshotFile::~SnapshotFile()
+{
+	Close();
+}
+
+bool SnapshotFile::Open(const char* path, std::initializer_list<SnapshotSection> sections)
+{
+	if (m_Map != nullptr or sections.size() > MaxSections) {
+		return false;
+	}
+
+	// The layout only depends on the sections, so an unchanged build finds
+	// everything where it left it.
+	Header header {};
+	std::memcpy(header.m_Magic, Magic, sizeof(Magic));
+	header.m_Sections = static_cast<u32>(sections.size());
+
+	u64 size = RoundUp(sizeof(Header));
+	for (const SnapshotSection& section : sections) {
+		SnapshotSection& entry = header.m_Table[&section - sections.begin()];
+		entry                  = section;
+		entry.m_Offset         = size;
+		size                  += RoundUp(section.m_Stride * section.m_Count);
+	}
+	header.m_Size = size;
+
+	m_File = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (m_File == -1) {
+		std::cerr << "Snapshot: cannot open " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		return false;
+	}
+
+	if (flock(m_File, LOCK_EX | LOCK_NB) == -1) {
+		std::cerr << "Snapshot: " << path << " is in use by another process" << std::endl;
+		close(m_File);
+		m_File = -1;
+		return false;
+	}
+
+	struct stat status {};
+	Header      found {};
+	m_Restored = fstat(m_File, &status) == 0 and static_cast<u64>(status.st_size) == size and
+				 pread(m_File, &found, sizeof(found), 0) == sizeof(found) and
+				 std::memcmp(&found, &header, sizeof(header)) == 0;
+
+	// Truncating first drops whatever was there, the new size reads as zeros
+	// without writing them.
+	if (!m_Restored and
+		(ftruncate(m_File, 0) == -1 or ftruncate(m_File, static_cast<off_t>(size)) == -1 or
+		 pwrite(m_File, &header, sizeof(header), 0) != sizeof(header))) {
+		std::cerr << "Snapshot: cannot size " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		close(m_File);
+		m_File = -1;
+		return false;
+	}
+
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+	if (memory == MAP_FAILED) {
+		std::cerr << "Snapshot: mmap failed: " << std::strerror(errno) << std::endl;
+		close(m_File);
+		m_File = -1;
+		return false;
+	}
+
+	m_Map     = static_cast<unsigned char*>(memory);
+	m_MapSize = size;
+	m_Header  = header;
+
+	return true;
+}
+
+void SnapshotFile::Close()
+{
+	if (m_Map != nullptr) {
+		msync(m_Map, m_MapSize, MS_SYNC);
+		munmap(m_Map, m_MapSize);
+		m_Map     = nullptr;
+		m_MapSize = 0;
+	}
+
+	if (m_File != -1) {
+		close(m_File);
+		m_File = -1;
+	}
+}
+
+bool SnapshotFile::Restored() const
+{
+	return m_Restored;
+}
+
+void* SnapshotFile::Section(u32 kind) const
+{
+	if (m_Map == nullptr) {
+		return nullptr;
+	}
+
+	for (u32 i = 0; i < m_Header.m_Sections; ++i) {
+		if (m_Header.m_Table[i].m_Kind == kind) {
+			return m_Map + m_Header.m_Table[i].m_Offset;
+		}
+	}
+	return nullptr;
+}
+
+u64 SnapshotFile::Size() const
+{
+	return m_MapSize;
+}
+
+void SnapshotFile::Sync()
+{
+	if (m_Map != nullptr) {
+		msync(m_Map, m_MapSize, MS_ASYNC);
+	}
+}
@@ -0,0 +1,120 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <initializer_list>
+#include <type_traits>
+
+#include "rules.h"
+
+
+enum SnapshotKind : u32 {
+	SNAPSHOT_SESSIONS = 1,    // GameServer, SnapshotSlot<SessionSnapshot> per matchmaker slot
+	SNAPSHOT_ENGINE_CACHE,    // EngineService answer cache
+	SNAPSHOT_GAME             // Game, one SnapshotSlot
+};
+
+// One array in a SnapshotFile. m_Version changes whenever the element type
+// does, so a file written by an older build is started over instead of
+// being misread.
+struct SnapshotSection {
+	u32 m_Kind {};
+	u32 m_Version {};
+	u64 m_Stride {};
+	u64 m_Count {};
+	u64 m_Offset {};    // from the start of the file, set by Open()
+};
+
+// State that outlives the process, kept in a file mapped read-write with
+// MAP_SHARED. Every store into a section lands in the page cache, so a
+// process that crashes or is killed leaves it behind and the next one only
+// maps the file and carries on: there is nothing to parse, and the cost of
+// a restart does not grow with the state. Sections hold plain structs
+// without pointers, each starting on a page of its own.
+//
+// Surviving a power loss is not the point; Sync() only schedules writeback.
+class SnapshotFile {
+public:
+	static constexpr u32 MaxSections = 8;
+
+	SnapshotFile();
+	~SnapshotFile();
+
+	SnapshotFile(const SnapshotFile&)            = delete;
+	SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+	// Maps path as is when it was written with the same sections, otherwise
+	// starts it over zero filled. The file stays locked until Close(), so
+	// two processes never share one.
+	bool Open(const char* path, std::initializer_list<SnapshotSection> sections);
+
+	// Writes back and unmaps, the contents stay valid for the next Open().
+	void Close();
+
+	// True when Open() found the previous process's state.
+	bool Restored() const;
+
+	// Null for a kind that was not asked for.
+	void* Section(u32 kind) const;
+	u64   Size() const;
+
+	template<typename T>
+	T* Section(u32 kind) const
+	{
+		return static_cast<T*>(Section(kind));
+	}
+
+	void Sync();
+
+private:
+	struct Header {
+		char            m_Magic[8];
+		u32             m_Sections;
+		u32             m_Reserved;
+		u64             m_Size;
+		SnapshotSection m_Table[MaxSections];
+	};
+
+	int            m_File;
+	unsigned char* m_Map;
+	u64            m_MapSize;
+	bool           m_Restored;
+	Header         m_Header;
+};
+
+// A value that a crash halfway through Store() can not tear. The new value
+// goes into the copy not in use and only then becomes current, so Load()
+// sees either the old value or the new one.
+template<typename T>
+struct SnapshotSlot {
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	u32 m_Live;
+	u32 m_Current;
+	T   m_Copies[2];
+
+	void Store(const T& value)
+	{
+		const u32 next = std::atomic_ref { m_Current }.load(std::memory_order_relaxed) ^ 1;
+
+		m_Copies[next] = value;
+		std::atomic_ref { m_Current }.store(next, std::memory_order_release);
+		std::atomic_ref { m_Live }.store(1, std::memory_order_release);
+	}
+
+	bool Load(T& value) const
+	{
+		if (m_Live != 1 or m_Current > 1) {
+			return false;
+		}
+		value = m_Copies[m_Current];
+		return true;
+	}
+
+	void Clear()
+	{
+		std::atomic_ref { m_Live }.store(0, std::memory_order_release);
+	}
+};
+
+#endif
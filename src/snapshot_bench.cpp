@@ -0,0 +1,176 @@
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "game_codec.h"
+#include "histogram.h"
+#include "session.h"
+#include "snapshot.h"
+
+
+// A running game part way through, the same for a given index every time.
+static SessionSnapshot MakeSession(u64 index)
+{
+	const GameRanking& ranking = GameRanking::Get();
+	std::mt19937_64    random { index + 1 };
+
+	SessionSnapshot session {};
+	session.m_GameId      = index + 1;
+	session.m_Tokens[0]   = static_cast<u32>(random());
+	session.m_Tokens[1]   = static_cast<u32>(random());
+	session.m_Mode        = random() % 2 ? MULTI_P : SINGLE_P;
+	session.m_Engine[0]   = session.m_Mode == SINGLE_P;
+	session.m_EngineDepth = static_cast<u32>(random() % (PerfectDepth + 1));
+	session.m_Tenant      = static_cast<u32>(random() % 16);
+
+	const u32 moves = ranking.Unrank(static_cast<u32>(random() % GameRanking::CompleteGames),
+									 session.m_History);
+	for (u32 i = 0; i < moves - 1; ++i) {
+		session.m_Board.Play(session.m_History[i] / 3, session.m_History[i] % 3);
+	}
+	session.m_Sequence = session.m_Board.m_Moves + 1;
+	std::memset(session.m_History + session.m_Board.m_Moves, 0, 9 - session.m_Board.m_Moves);
+
+	return session;
+}
+
+static bool Same(const SessionSnapshot& a, const SessionSnapshot& b)
+{
+	return EncodeSession(a) == EncodeSession(b);
+}
+
+// A server process fills a snapshot with running games and is killed with
+// SIGKILL, as in a crash. The restarted process then maps the file, and the
+// time until every game is back in hand is compared with reading and
+// decoding the same games from a serialized file.
+//
+//     SnapshotBench [sessions] [path]
+int main(int argc, char* argv[])
+{
+	const u64   sessions = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 20;
+	const char* path     = argc > 2 ? argv[2] : "snapshot-bench.snap";
+
+	if (sessions == 0) {
+		std::cerr << "Usage: SnapshotBench [sessions] [path]" << std::endl;
+		return -1;
+	}
+
+	const SnapshotSection layout {
+		SNAPSHOT_SESSIONS, SessionSnapshot::Version, sizeof(SnapshotSlot<SessionSnapshot>), sessions
+	};
+
+	unlink(path);
+
+	const pid_t child = fork();
+	if (child == 0) {
+		SnapshotFile snapshot {};
+		if (!snapshot.Open(path, { layout })) {
+			_exit(1);
+		}
+
+		auto* slots = snapshot.Section<SnapshotSlot<SessionSnapshot>>(SNAPSHOT_SESSIONS);
+		const u64 start = NowNanoseconds();
+		for (u64 i = 0; i < sessions; ++i) {
+			slots[i].Store(MakeSession(i));
+		}
+
+		std::cout << "Stored " << sessions << " sessions in "
+				  << (NowNanoseconds() - start) / 1'000'000 << " ms, "
+				  << snapshot.Size() / 1024 << " KiB mapped" << std::endl;
+
+		// No Close(), no msync: only what the page cache holds survives.
+		raise(SIGKILL);
+	}
+
+	int status {};
+	if (child == -1 or waitpid(child, &status, 0) != child or !WIFSIGNALED(status)) {
+		std::cerr << "The writer did not run to its crash" << std::endl;
+		return -1;
+	}
+
+	u64          start = NowNanoseconds();
+	SnapshotFile snapshot {};
+	if (!snapshot.Open(path, { layout })) {
+		return -1;
+	}
+	const u64 mapped = NowNanoseconds() - start;
+
+	if (!snapshot.Restored()) {
+		std::cerr << "The snapshot was not found again" << std::endl;
+		return -1;
+	}
+
+	const auto* slots = snapshot.Section<SnapshotSlot<SessionSnapshot>>(SNAPSHOT_SESSIONS);
+
+	// What GameServer::EnableSnapshot does with every slot.
+	std::vector<SessionSnapshot> restored(sessions);
+	start = NowNanoseconds();
+	u64 live {};
+	for (u64 i = 0; i < sessions; ++i) {
+		live += slots[i].Load(restored[i]) ? 1 : 0;
+	}
+	const u64 resumed = NowNanoseconds() - start;
+
+	u64 wrong {};
+	for (u64 i = 0; i < sessions; ++i) {
+		wrong += Same(restored[i], MakeSession(i)) ? 0 : 1;
+	}
+
+	std::cout << "Restart: mapped " << snapshot.Size() / 1024 << " KiB in " << mapped / 1'000
+			  << " us, " << live << " sessions in hand after another " << resumed / 1'000
+			  << " us, " << wrong << " differ from what was stored" << std::endl;
+
+	snapshot.Close();
+
+	// The same games the way a migration sends them, written to a file and
+	// parsed back.
+	std::vector<unsigned char> encoded {};
+	encoded.reserve(sessions * SessionSnapshot::EncodedSize);
+	for (const SessionSnapshot& session : restored) {
+		const auto data = EncodeSession(session);
+		encoded.insert(encoded.end(), data.begin(), data.end());
+	}
+
+	const std::string serialized = std::string { path } + ".sessions";
+	int               fd = open(serialized.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1 or write(fd, encoded.data(), encoded.size()) != static_cast<ssize_t>(encoded.size())) {
+		std::cerr << "Cannot write " << serialized << std::endl;
+		return -1;
+	}
+	close(fd);
+
+	start = NowNanoseconds();
+	fd    = open(serialized.c_str(), O_RDONLY | O_CLOEXEC);
+	std::vector<unsigned char> buffer(encoded.size());
+	if (fd == -1 or read(fd, buffer.data(), buffer.size()) != static_cast<ssize_t>(buffer.size())) {
+		std::cerr << "Cannot read " << serialized << std::endl;
+		return -1;
+	}
+	close(fd);
+
+	u64 decoded {};
+	for (u64 i = 0; i < sessions; ++i) {
+		decoded += DecodeSession(
+					   buffer.data() + i * SessionSnapshot::EncodedSize,
+					   SessionSnapshot::EncodedSize,
+					   restored[i])
+					   ? 1
+					   : 0;
+	}
+	const u64 parsed = NowNanoseconds() - start;
+
+	std::cout << "Parse: " << decoded << " sessions read and decoded in " << parsed / 1'000
+			  << " us" << std::endl;
+
+	unlink(serialized.c_str());
+	unlink(path);
+
+	return wrong == 0 and live == sessions ? 0 : 1;
+}
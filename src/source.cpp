@@ -1,9 +1,61 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
 #include "game.h"
 
-int main()
+#ifdef TICTACTOE_NETWORKING
+	#include "engine_host.h"
+	#include "journal.h"
+	#include "net.h"
+	#include "snapshot.h"
+	#include "spectator.h"
+#endif
+
+int main(int argc, char* argv[])
 {
 	Game game {};
 
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (std::strcmp(argv[i], "--assets") == 0) {
+			std::cout << "Assets in " << argv[i + 1] << " replace the embedded ones" << std::endl;
+			game.SetAssetDirectory(argv[i + 1]);
+		}
+	}
+
+#ifdef TICTACTOE_NETWORKING
+	SpectatorChannel spectators {};
+	EngineHost       engine {};
+	GameJournal      journal {};
+	SnapshotFile     snapshot {};
+
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--engine-host") == 0 and game.SetEngineHost(&engine)) {
+			std::cout << "Engine runs in a separate process" << std::endl;
+		}
+	}
+
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (std::strcmp(argv[i], "--spectate") == 0) {
+			const auto port = static_cast<u32>(std::strtoul(argv[i + 1], nullptr, 10));
+			RaiseFileLimit();
+			if (spectators.Listen(port) and spectators.Start()) {
+				std::cout << "Spectators can connect on port " << port << std::endl;
+				game.SetSpectators(&spectators);
+			}
+		}
+		else if (std::strcmp(argv[i], "--journal") == 0 and journal.Open(argv[i + 1])) {
+			std::cout << "Recording games to " << argv[i + 1] << std::endl;
+			game.SetJournal(&journal);
+		}
+		else if (std::strcmp(argv[i], "--snapshot") == 0 and
+				 game.SetSnapshot(&snapshot, argv[i + 1])) {
+			std::cout << (snapshot.Restored() ? "Resumed the game in " : "Saving the game to ")
+					  << argv[i + 1] << std::endl;
+		}
+	}
+#endif
+
 	auto check = game.Init();
 
 	return 0;
@@ -0,0 +1,419 @@
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "net.h"
+#include "spectator.h"
+
+
+std::shared_ptr<const SpectatorFrame>
+	SpectatorFrame::Make(u64 sequence, std::vector<unsigned char> payload)
+{
+	auto frame = std::make_shared<SpectatorFrame>();
+
+	const u32 magic = Magic;
+	const u32 size  = static_cast<u32>(payload.size());
+
+	std::memcpy(frame->m_Header, &magic, 4);
+	std::memcpy(frame->m_Header + 4, &size, 4);
+	std::memcpy(frame->m_Header + 8, &sequence, 8);
+
+	frame->m_Sequence = sequence;
+	frame->m_Payload  = std::move(payload);
+
+	return frame;
+}
+
+SpectatorChannel::SpectatorChannel() :
+	m_Epoll { epoll_create1(EPOLL_CLOEXEC) },
+	m_Wake { eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) },
+	m_Listener { -1 },
+	m_Spare { open("/dev/null", O_RDONLY | O_CLOEXEC) },
+	m_Running { false },
+	m_Sequence {},
+	m_Count {},
+	m_Refused {}
+{
+	epoll_event event {};
+	event.events  = EPOLLIN;
+	event.data.fd = m_Wake;
+	epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Wake, &event);
+}
+
+SpectatorChannel::~SpectatorChannel()
+{
+	Stop();
+
+	for (const int fd : m_Active) {
+		close(fd);
+	}
+
+	{
+		std::lock_guard lock { m_Mutex };
+		for (const int fd : m_Pending) {
+			close(fd);
+		}
+	}
+
+	if (m_Listener != -1) {
+		close(m_Listener);
+	}
+	if (m_Spare != -1) {
+		close(m_Spare);
+	}
+
+	close(m_Wake);
+	close(m_Epoll);
+}
+
+bool SpectatorChannel::Listen(u32 port)
+{
+	m_Listener = ListenTcp(port);
+	if (m_Listener == -1) {
+		return false;
+	}
+
+	epoll_event event {};
+	event.events  = EPOLLIN;
+	event.data.fd = m_Listener;
+	epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Listener, &event);
+
+	return true;
+}
+
+bool SpectatorChannel::Start()
+{
+	if (m_Epoll == -1 or m_Wake == -1) {
+		std::cerr << "Spectator: failed to create event loop" << std::endl;
+		return false;
+	}
+
+	m_Running = true;
+	m_Thread  = std::thread { &SpectatorChannel::Run, this };
+
+	return true;
+}
+
+void SpectatorChannel::Stop()
+{
+	if (!m_Thread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard lock { m_Mutex };
+		m_Running = false;
+	}
+
+	const u64 one = 1;
+	write(m_Wake, &one, sizeof(one));
+	m_Thread.join();
+}
+
+void SpectatorChannel::Subscribe(int fd)
+{
+	SetNonBlocking(fd);
+
+	{
+		std::lock_guard lock { m_Mutex };
+		m_Pending.push_back(fd);
+	}
+
+	const u64 one = 1;
+	write(m_Wake, &one, sizeof(one));
+}
+
+void SpectatorChannel::Publish(std::vector<unsigned char> payload)
+{
+	{
+		std::lock_guard lock { m_Mutex };
+		m_Latest = SpectatorFrame::Make(++m_Sequence, std::move(payload));
+	}
+
+	const u64 one = 1;
+	write(m_Wake, &one, sizeof(one));
+}
+
+u64 SpectatorChannel::Subscribers() const
+{
+	std::lock_guard lock { m_Mutex };
+	return m_Count;
+}
+
+u64 SpectatorChannel::Refused() const
+{
+	std::lock_guard lock { m_Mutex };
+	return m_Refused;
+}
+
+void SpectatorChannel::Run()
+{
+	std::shared_ptr<const SpectatorFrame> latest {};
+	std::vector<int>                      pending {};
+	epoll_event                           events[256];
+
+	while (true) {
+		const int count = epoll_wait(m_Epoll, events, 256, -1);
+		if (count == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::cerr << "Spectator: epoll_wait failed: " << std::strerror(errno)
+					  << std::endl;
+			return;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			const int fd = events[i].data.fd;
+
+			if (fd == m_Wake) {
+				u64 value {};
+				read(m_Wake, &value, sizeof(value));
+
+				{
+					std::lock_guard lock { m_Mutex };
+					if (!m_Running) {
+						return;
+					}
+					latest = m_Latest;
+					pending.swap(m_Pending);
+				}
+
+				m_Current = latest;
+				for (const int subscriber : pending) {
+					Add(subscriber);
+				}
+				pending.clear();
+
+				FanOut();
+			}
+			else if (fd == m_Listener) {
+				Accept();
+			}
+			else if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+				Drop(fd);
+			}
+			else {
+				if (events[i].events & EPOLLIN) {
+					Drain(fd);
+				}
+				if (events[i].events & EPOLLOUT) {
+					Flush(fd);
+				}
+			}
+		}
+	}
+}
+
+void SpectatorChannel::Accept()
+{
+	while (true) {
+		const int fd =
+			accept4(m_Listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd == -1) {
+			if (errno == EINTR or errno == ECONNABORTED) {
+				continue;
+			}
+
+			// Out of descriptors, the connection stays pending and the level
+			// triggered listener would wake us again at once. The spare
+			// descriptor makes room to accept it and hang up instead. The
+			// kernel reports EMFILE before it looks at the queue, so an empty
+			// one only shows up here.
+			if ((errno == EMFILE or errno == ENFILE) and m_Spare != -1) {
+				close(m_Spare);
+				const int refused = accept4(m_Listener, nullptr, nullptr, SOCK_CLOEXEC);
+				if (refused != -1) {
+					close(refused);
+				}
+				m_Spare = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+				if (refused == -1) {
+					return;
+				}
+
+				std::lock_guard lock { m_Mutex };
+				++m_Refused;
+				continue;
+			}
+			return;
+		}
+
+		Add(fd);
+	}
+}
+
+void SpectatorChannel::Add(int fd)
+{
+	if (static_cast<u64>(fd) >= m_Subscribers.size()) {
+		m_Subscribers.resize(static_cast<u64>(fd) * 2 + 1);
+	}
+
+	const int enable = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+	// Edge triggered, so EPOLLOUT only fires when a full socket buffer
+	// drains and we never have to toggle interest with epoll_ctl.
+	epoll_event event {};
+	event.events  = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.fd = fd;
+	if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, fd, &event) == -1) {
+		close(fd);
+		return;
+	}
+
+	m_Subscribers[fd] = Subscriber { nullptr, 0, 0, true, m_Active.size() };
+	m_Active.push_back(fd);
+
+	{
+		std::lock_guard lock { m_Mutex };
+		++m_Count;
+	}
+
+	Flush(fd);
+}
+
+void SpectatorChannel::Drop(int fd)
+{
+	Subscriber& subscriber = m_Subscribers[fd];
+	if (!subscriber.m_Open) {
+		return;
+	}
+
+	const int last               = m_Active.back();
+	m_Active[subscriber.m_Index] = last;
+	m_Subscribers[last].m_Index  = subscriber.m_Index;
+	m_Active.pop_back();
+
+	subscriber = Subscriber {};
+	close(fd);
+
+	std::lock_guard lock { m_Mutex };
+	--m_Count;
+}
+
+void SpectatorChannel::Drain(int fd)
+{
+	unsigned char scratch[256];
+
+	while (true) {
+		const ssize_t size = read(fd, scratch, sizeof(scratch));
+		if (size > 0) {
+			continue;
+		}
+		if (size == 0 or (errno != EAGAIN and errno != EINTR)) {
+			Drop(fd);
+		}
+		if (size == 0 or errno != EINTR) {
+			return;
+		}
+	}
+}
+
+void SpectatorChannel::Flush(int fd)
+{
+	Subscriber& subscriber = m_Subscribers[fd];
+
+	while (subscriber.m_Open) {
+		if (!subscriber.m_Frame) {
+			if (!m_Current or m_Current->m_Sequence <= subscriber.m_Sent) {
+				return;
+			}
+			subscriber.m_Frame  = m_Current;
+			subscriber.m_Offset = 0;
+		}
+
+		const SpectatorFrame& frame = *subscriber.m_Frame;
+
+		const i64 written = WriteFrame(fd, frame, subscriber.m_Offset);
+		if (written == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN) {
+				Drop(fd);
+			}
+			return;
+		}
+
+		subscriber.m_Offset += static_cast<u64>(written);
+
+		// A slow consumer finishes the frame it started and then jumps to
+		// whatever is latest, never queueing the snapshots in between.
+		if (subscriber.m_Offset == frame.Size()) {
+			subscriber.m_Sent = frame.m_Sequence;
+			subscriber.m_Frame.reset();
+		}
+	}
+}
+
+void SpectatorChannel::FanOut()
+{
+	// Walk backwards so a Drop() swapping the last entry into this slot only
+	// moves subscribers that were already served.
+	for (u64 i = m_Active.size(); i-- > 0;) {
+		const int fd = m_Active[i];
+		if (!m_Subscribers[fd].m_Frame) {
+			Flush(fd);
+		}
+	}
+}
+
+i64 WriteFrame(int fd, const SpectatorFrame& frame, u64 offset)
+{
+	iovec iov[2] {};
+	int   count {};
+
+	if (offset < SpectatorFrame::HeaderSize) {
+		iov[count].iov_base = const_cast<unsigned char*>(frame.m_Header + offset);
+		iov[count].iov_len  = SpectatorFrame::HeaderSize - offset;
+		++count;
+	}
+
+	const u64 payloadOffset =
+		offset > SpectatorFrame::HeaderSize ? offset - SpectatorFrame::HeaderSize : 0;
+	if (payloadOffset < frame.m_Payload.size()) {
+		iov[count].iov_base =
+			const_cast<unsigned char*>(frame.m_Payload.data() + payloadOffset);
+		iov[count].iov_len = frame.m_Payload.size() - payloadOffset;
+		++count;
+	}
+
+	msghdr message {};
+	message.msg_iov    = iov;
+	message.msg_iovlen = count;
+
+	return sendmsg(fd, &message, MSG_NOSIGNAL);
+}
+
+std::vector<unsigned char> EncodeBoardFrame(
+	const i32 board[3][3],
+	u32       moves,
+	bool      player1Turn,
+	Utility   winner,
+	GameState state)
+{
+	std::vector<unsigned char> payload(13);
+
+	for (u32 i = 0; i < 3; ++i) {
+		for (u32 j = 0; j < 3; ++j) {
+			payload[i * 3 + j] = static_cast<unsigned char>(board[i][j]);
+		}
+	}
+
+	payload[9]  = static_cast<unsigned char>(moves);
+	payload[10] = player1Turn ? 1 : 0;
+	payload[11] = static_cast<unsigned char>(static_cast<signed char>(winner));
+	payload[12] = static_cast<unsigned char>(state);
+
+	return payload;
+}
@@ -0,0 +1,107 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "game.h"
+
+
+// Wire layout of one frame: a 16 byte header (magic, payload size, sequence)
+// followed by the payload. Frames are built once and shared by every
+// subscriber, nobody ever writes to them after Make().
+struct SpectatorFrame {
+	static constexpr u32 Magic      = 0x53545454;    // "TTTS"
+	static constexpr u32 HeaderSize = 16;
+
+	u64                        m_Sequence {};
+	unsigned char              m_Header[HeaderSize] {};
+	std::vector<unsigned char> m_Payload;
+
+	u64 Size() const
+	{
+		return HeaderSize + m_Payload.size();
+	}
+
+	static std::shared_ptr<const SpectatorFrame>
+		Make(u64 sequence, std::vector<unsigned char> payload);
+};
+
+class SpectatorChannel {
+public:
+	SpectatorChannel();
+	~SpectatorChannel();
+
+	SpectatorChannel(const SpectatorChannel&)            = delete;
+	SpectatorChannel& operator=(const SpectatorChannel&) = delete;
+
+	bool Listen(u32 port);
+	bool Start();
+	void Stop();
+
+	// Hands an already connected socket to the channel, it is owned (and
+	// closed) by the channel from here on.
+	void Subscribe(int fd);
+
+	// Replaces the latest snapshot. Subscribers still busy with an older
+	// frame skip straight to this one once they drain.
+	void Publish(std::vector<unsigned char> payload);
+
+	u64 Subscribers() const;
+
+	// Connections closed on accept because the process ran out of
+	// descriptors.
+	u64 Refused() const;
+
+private:
+	struct Subscriber {
+		std::shared_ptr<const SpectatorFrame> m_Frame;
+		u64                                   m_Offset {};
+		u64                                   m_Sent {};
+		bool                                  m_Open {};
+		u64                                   m_Index {};
+	};
+
+	int                                   m_Epoll;
+	int                                   m_Wake;
+	int                                   m_Listener;
+	int                                   m_Spare;
+	std::thread                           m_Thread;
+	bool                                  m_Running;
+
+	mutable std::mutex                    m_Mutex;
+	std::shared_ptr<const SpectatorFrame> m_Latest;
+	std::vector<int>                      m_Pending;
+	u64                                   m_Sequence;
+	u64                                   m_Count;
+	u64                                   m_Refused;
+
+	// Only touched by the channel thread. Subscribers are indexed by file
+	// descriptor, m_Active lists the open ones for fan-out.
+	std::shared_ptr<const SpectatorFrame> m_Current;
+	std::vector<Subscriber>               m_Subscribers;
+	std::vector<int>                      m_Active;
+
+	void Run();
+	void Accept();
+	void Add(int fd);
+	void Drop(int fd);
+	void Drain(int fd);
+	void Flush(int fd);
+	void FanOut();
+};
+
+// One scatter-gather write of the frame from byte offset onwards, returns
+// what sendmsg() returned.
+i64 WriteFrame(int fd, const SpectatorFrame& frame, u64 offset);
+
+std::vector<unsigned char> EncodeBoardFrame(
+	const i32 board[3][3],
+	u32       moves,
+	bool      player1Turn,
+	Utility   winner,
+	GameState state);
+
+#endif
@@ -0,0 +1,176 @@
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "histogram.h"
+#include "net.h"
+#include "spectator.h"
+
+
+// One viewer socket on the reading side, with the part of a frame that has
+// arrived so far.
+struct Viewer {
+	unsigned char m_Buffer[64] {};
+	u32           m_Size {};
+};
+
+// Fan-out test of SpectatorChannel over loopback: VIEWERS sockets subscribe,
+// boards are published at RATE per second, and one thread reads every
+// socket. Each payload carries its publish time, so every delivered frame
+// gives a publish to receive latency.
+//
+//     SpectatorBench [viewers] [seconds] [rate] [port]
+int main(int argc, char* argv[])
+{
+	u64       viewers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000;
+	const u64 seconds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5;
+	const u64 rate    = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 100;
+	const u32 port    = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 7790;
+
+	if (viewers == 0 or rate == 0) {
+		std::cerr << "Usage: SpectatorBench [viewers] [seconds] [rate] [port]" << std::endl;
+		return -1;
+	}
+
+	// Both ends of every connection live in this process.
+	const u64 limit = RaiseFileLimit();
+	if (limit < 64 + viewers * 2) {
+		viewers = limit > 64 ? (limit - 64) / 2 : 1;
+		std::cout << "Descriptor limit " << limit << " allows " << viewers << " viewers"
+				  << std::endl;
+	}
+
+	SpectatorChannel channel {};
+	if (!channel.Listen(port) or !channel.Start()) {
+		return -1;
+	}
+
+	const int epoll = epoll_create1(EPOLL_CLOEXEC);
+
+	std::vector<int>    sockets {};
+	std::vector<Viewer> buffers {};
+
+	const u64 connectStart = NowNanoseconds();
+	for (u64 i = 0; i < viewers; ++i) {
+		const int fd = ConnectTcp("127.0.0.1", port);
+		if (fd == -1) {
+			break;
+		}
+		SetNonBlocking(fd);
+
+		epoll_event event {};
+		event.events  = EPOLLIN | EPOLLET;
+		event.data.fd = fd;
+		epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+
+		if (static_cast<u64>(fd) >= buffers.size()) {
+			buffers.resize(static_cast<u64>(fd) * 2 + 1);
+		}
+		sockets.push_back(fd);
+	}
+
+	while (channel.Subscribers() < sockets.size() and
+		   NowNanoseconds() - connectStart < 10'000'000'000ull) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	const double connectTime = (NowNanoseconds() - connectStart) / 1e9;
+
+	std::cout << channel.Subscribers() << " viewers subscribed in " << connectTime << " s"
+			  << std::endl;
+
+	std::atomic<bool> running { true };
+	LatencyHistogram  latency {};
+	u64               delivered {};
+	u64               broken {};
+
+	std::thread reader { [&]() {
+		epoll_event events[256];
+
+		while (running.load(std::memory_order_relaxed)) {
+			const int count = epoll_wait(epoll, events, 256, 10);
+
+			for (int i = 0; i < count; ++i) {
+				const int fd     = events[i].data.fd;
+				Viewer&   viewer = buffers[fd];
+
+				while (true) {
+					const ssize_t size = read(
+						fd, viewer.m_Buffer + viewer.m_Size, sizeof(viewer.m_Buffer) - viewer.m_Size);
+					if (size <= 0) {
+						if (size == 0 or (errno != EAGAIN and errno != EINTR)) {
+							++broken;
+							epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+						}
+						if (size == 0 or errno != EINTR) {
+							break;
+						}
+						continue;
+					}
+					viewer.m_Size += static_cast<u32>(size);
+
+					const u64 now = NowNanoseconds();
+					while (viewer.m_Size >= SpectatorFrame::HeaderSize + 13) {
+						u64 published {};
+						std::memcpy(&published, viewer.m_Buffer + SpectatorFrame::HeaderSize, 8);
+						latency.Record(now - published);
+						++delivered;
+
+						viewer.m_Size -= SpectatorFrame::HeaderSize + 13;
+						std::memmove(
+							viewer.m_Buffer,
+							viewer.m_Buffer + SpectatorFrame::HeaderSize + 13,
+							viewer.m_Size);
+					}
+				}
+			}
+		}
+	} };
+
+	const u64 interval  = 1'000'000'000ull / rate;
+	const u64 start     = NowNanoseconds();
+	const u64 end       = start + seconds * 1'000'000'000ull;
+	u64       published = 0;
+
+	for (u64 next = start; next < end; next += interval) {
+		while (NowNanoseconds() < next) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+
+		// The size of a board frame, led by the publish time.
+		std::vector<unsigned char> payload(13);
+		const u64                  now = NowNanoseconds();
+		std::memcpy(payload.data(), &now, 8);
+
+		channel.Publish(std::move(payload));
+		++published;
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	running.store(false);
+	reader.join();
+
+	const double elapsed = (NowNanoseconds() - start) / 1e9;
+
+	std::cout << "Published " << published << " boards to " << sockets.size()
+			  << " viewers: " << delivered << " frames delivered ("
+			  << delivered / elapsed << " frames/s, "
+			  << 100.0 * delivered / (static_cast<double>(published) * sockets.size())
+			  << "% of boards, the rest skipped as stale), " << broken << " dropped, "
+			  << channel.Refused() << " refused" << std::endl;
+	latency.Print(std::cout, "Publish to receive");
+
+	channel.Stop();
+	for (const int fd : sockets) {
+		close(fd);
+	}
+	close(epoll);
+
+	return 0;
+}
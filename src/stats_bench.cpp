@@ -0,0 +1,143 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "game_codec.h"
+#include "stats_store.h"
+
+
+// Writes a month of random games into a store, then runs three dashboard
+// queries with one thread and with N and checks them against counts kept
+// while writing: win rate by day, by first move for shallow engine games,
+// and by engine depth for a single day, which min/max stats should narrow
+// to a few blocks.
+//
+//     StatsBench [rows] [threads] [path]
+int main(int argc, char* argv[])
+{
+	const u64   rows    = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20'000'000;
+	const u32   threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+	const char* path    = argc > 3 ? argv[3] : "stats-bench.store";
+
+	if (rows == 0 or threads == 0) {
+		std::cerr << "Usage: StatsBench [rows] [threads] [path]" << std::endl;
+		return -1;
+	}
+
+	constexpr u64 Start = 1'767'225'600;    // 2026-01-01
+	constexpr u64 Days  = 30;
+	constexpr u64 Probe = 12;               // the day the third query looks at
+
+	const GameRanking& ranking = GameRanking::Get();
+	std::mt19937_64    random { 1 };
+
+	// Expected counts, indexed by group and then Utility + 1.
+	std::vector<std::array<u64, 3>> byDay(Days);
+	std::vector<std::array<u64, 3>> byFirst(10);
+	std::vector<std::array<u64, 3>> byDepth(PerfectDepth + 1);
+
+	StatsWriter writer {};
+	if (!writer.Open(path)) {
+		return -1;
+	}
+
+	u64 start = NowNanoseconds();
+	for (u64 i = 0; i < rows; ++i) {
+		GameRecord record {};
+		record.m_Time        = (Start + i * Days * 86'400 / rows) * 1'000'000'000;
+		record.m_GameId      = i + 1;
+		record.m_Mode        = random() % 2 ? MULTI_P : SINGLE_P;
+		record.m_EngineDepth = random() % (PerfectDepth + 1);
+		record.m_Moves  = ranking.Unrank(static_cast<u32>(random() % GameRanking::CompleteGames),
+										 record.m_History);
+		record.m_Winner = ranking.Winner(record.m_History, record.m_Moves);
+		writer.Append(record);
+
+		const u32 result = static_cast<u32>(record.m_Winner + 1);
+		const u64 day    = i * Days / rows;
+
+		++byDay[day][result];
+		if (record.m_Mode == SINGLE_P and record.m_EngineDepth <= 3) {
+			++byFirst[record.m_History[0]][result];
+		}
+		if (day == Probe) {
+			++byDepth[record.m_EngineDepth][result];
+		}
+	}
+
+	const u64 bytes = writer.Bytes();
+	if (!writer.Close()) {
+		return -1;
+	}
+
+	std::cout << "Wrote " << rows << " games in " << (NowNanoseconds() - start) / 1'000'000
+			  << " ms, " << static_cast<double>(bytes) / static_cast<double>(rows)
+			  << " bytes per game" << std::endl;
+
+	StatsStore store {};
+	if (!store.Open(path)) {
+		return -1;
+	}
+
+	struct Case {
+		const char*                             m_Name;
+		StatsQuery                              m_Query;
+		u32                                     m_First;
+		const std::vector<std::array<u64, 3>>* m_Expected;
+	};
+
+	const u32 day = static_cast<u32>(Start + Probe * 86'400);
+
+	const Case cases[] = {
+		{ "by day", { {}, COLUMN_TIME, 86'400 }, static_cast<u32>(Start / 86'400), &byDay },
+		{ "by first move, depth <= 3",
+		  { { { COLUMN_MODE, SINGLE_P, SINGLE_P }, { COLUMN_DEPTH, 0, 3 } }, COLUMN_OPENING, 100 },
+		  0,
+		  &byFirst },
+		{ "by depth, one day",
+		  { { { COLUMN_TIME, day, day + 86'399 } }, COLUMN_DEPTH, 1 },
+		  0,
+		  &byDepth },
+	};
+
+	u64 failures {};
+
+	for (const Case& test : cases) {
+		for (const u32 count : { 1u, threads }) {
+			start                    = NowNanoseconds();
+			const StatsResult result = store.Aggregate(test.m_Query, count);
+			const u64         took   = NowNanoseconds() - start;
+
+			u64 groups {};
+			for (u32 key = 0; key < test.m_Expected->size(); ++key) {
+				const auto& expected = (*test.m_Expected)[key];
+				if (expected[0] + expected[1] + expected[2] == 0) {
+					continue;
+				}
+
+				++groups;
+				const auto found = result.m_Groups.find(test.m_First + key);
+				if (found == result.m_Groups.end() or found->second.m_OWins != expected[0] or
+					found->second.m_Draws != expected[1] or found->second.m_XWins != expected[2]) {
+					++failures;
+				}
+			}
+			failures += groups != result.m_Groups.size();
+
+			std::cout << test.m_Name << ", " << count << " thread(s): " << took / 1'000'000
+					  << " ms (" << static_cast<double>(rows) * 1e3 / static_cast<double>(took)
+					  << "M games/s), " << result.m_BlocksRead << " blocks read, "
+					  << result.m_BlocksSkipped << " skipped" << std::endl;
+		}
+	}
+
+	store.Close();
+	unlink(path);
+	std::cout << failures << " mismatches" << std::endl;
+
+	return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,198 @@
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+
+#include "archive.h"
+#include "stats_store.h"
+
+
+struct Grouping {
+	const char* m_Name;
+	StatsColumn m_Column;
+	u32         m_Divisor;
+};
+
+static constexpr Grouping Groupings[] = {
+	{ "day", COLUMN_TIME, 86'400 },   { "hour", COLUMN_TIME, 3'600 },
+	{ "first", COLUMN_OPENING, 100 }, { "opening", COLUMN_OPENING, 10 },
+	{ "mode", COLUMN_MODE, 1 },       { "depth", COLUMN_DEPTH, 1 },
+	{ "length", COLUMN_LENGTH, 1 },
+};
+
+static int Build(int argc, char* argv[])
+{
+	const bool archive = argc == 5 and std::strcmp(argv[2], "--archive") == 0;
+	if (argc != (archive ? 5 : 4)) {
+		std::cerr << "Usage: TicTacToeStats build [--archive] SOURCE STORE" << std::endl;
+		return -1;
+	}
+
+	const char* source = argv[archive ? 3 : 2];
+	const char* path   = argv[archive ? 4 : 3];
+	const u64   start  = NowNanoseconds();
+
+	StatsWriter writer {};
+	if (!writer.Open(path)) {
+		return -1;
+	}
+
+	if (archive) {
+		ArchiveReader reader {};
+		GameRecord    record {};
+		if (!reader.Open(source)) {
+			return -1;
+		}
+		while (reader.Next(record)) {
+			writer.Append(record);
+		}
+		if (reader.Failed()) {
+			std::cerr << "Archive: " << source << " is damaged after " << writer.Rows()
+					  << " records" << std::endl;
+			return -1;
+		}
+	}
+	else {
+		JournalReader reader {};
+		GameRecord    record {};
+		if (!reader.Open(source)) {
+			return -1;
+		}
+		while (reader.Next(record)) {
+			writer.Append(record);
+		}
+	}
+
+	const u64 rows = writer.Rows();
+	if (!writer.Close()) {
+		return -1;
+	}
+
+	std::cout << "Stored " << rows << " games in " << writer.Bytes() << " bytes ("
+			  << (NowNanoseconds() - start) / 1'000'000 << " ms)" << std::endl;
+
+	return 0;
+}
+
+// COLUMN=VALUE or COLUMN=MIN..MAX
+static bool ParseFilter(const char* text, StatsFilter& filter)
+{
+	const char* equals = std::strchr(text, '=');
+	if (equals == nullptr) {
+		return false;
+	}
+
+	const std::string name { text, equals };
+	for (u32 column = 0; column < COLUMN_COUNT; ++column) {
+		if (name == ColumnName(static_cast<StatsColumn>(column))) {
+			char* end {};
+			filter.m_Column = static_cast<StatsColumn>(column);
+			filter.m_Min    = static_cast<u32>(std::strtoul(equals + 1, &end, 10));
+			filter.m_Max    = std::strncmp(end, "..", 2) == 0
+								  ? static_cast<u32>(std::strtoul(end + 2, nullptr, 10))
+								  : filter.m_Min;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void PrintKey(const Grouping& grouping, u32 key)
+{
+	if (grouping.m_Column != COLUMN_TIME) {
+		std::cout << key;
+		return;
+	}
+
+	const std::time_t time = static_cast<std::time_t>(key) * grouping.m_Divisor;
+	char              text[32] {};
+	std::strftime(text, sizeof(text), grouping.m_Divisor >= 86'400 ? "%F" : "%F %H:00",
+				  std::gmtime(&time));
+	std::cout << text;
+}
+
+static int Query(int argc, char* argv[])
+{
+	u32 threads = 1;
+	int i       = 2;
+
+	if (i + 1 < argc and std::strcmp(argv[i], "--threads") == 0) {
+		threads = static_cast<u32>(std::strtoul(argv[i + 1], nullptr, 10));
+		i += 2;
+	}
+
+	const Grouping* grouping {};
+	for (const Grouping& candidate : Groupings) {
+		if (i + 1 < argc and std::strcmp(argv[i + 1], candidate.m_Name) == 0) {
+			grouping = &candidate;
+		}
+	}
+
+	StatsQuery query {};
+	for (int f = i + 2; grouping != nullptr and f < argc; ++f) {
+		StatsFilter filter {};
+		if (!ParseFilter(argv[f], filter)) {
+			grouping = nullptr;
+			break;
+		}
+		query.m_Filters.push_back(filter);
+	}
+
+	if (grouping == nullptr) {
+		std::cerr << "Usage: TicTacToeStats query [--threads N] STORE "
+					 "day|hour|first|opening|mode|depth|length [COLUMN=MIN[..MAX]]..."
+				  << std::endl;
+		return -1;
+	}
+
+	StatsStore store {};
+	if (!store.Open(argv[i])) {
+		return -1;
+	}
+
+	query.m_GroupBy = grouping->m_Column;
+	query.m_Divisor = grouping->m_Divisor;
+
+	const u64         start  = NowNanoseconds();
+	const StatsResult result = store.Aggregate(query, threads);
+	const u64         took   = NowNanoseconds() - start;
+
+	for (const auto& [key, counts] : result.m_Groups) {
+		const double games = static_cast<double>(counts.m_Games);
+
+		PrintKey(*grouping, key);
+		std::cout << "\t" << counts.m_Games << " games\tX " << 100.0 * counts.m_XWins / games
+				  << "%\tdraw " << 100.0 * counts.m_Draws / games << "%\tO "
+				  << 100.0 * counts.m_OWins / games << "%\n";
+	}
+
+	std::cout << result.m_Rows << " of " << store.Rows() << " games, " << result.m_BlocksRead
+			  << " blocks read, " << result.m_BlocksSkipped << " skipped, " << took / 1'000'000
+			  << " ms" << std::endl;
+
+	return 0;
+}
+
+//     TicTacToeStats build [--archive] SOURCE STORE
+//     TicTacToeStats query [--threads N] STORE GROUP [COLUMN=MIN[..MAX]]...
+//
+// Builds a columnar store of game summaries from a journal or an archive, or
+// prints win rates grouped by day, hour, first move, opening (first two
+// moves), mode, engine depth or length. Filters name a column: time
+// (Unix seconds), opening, length, result, mode or depth.
+int main(int argc, char* argv[])
+{
+	if (argc > 1 and std::strcmp(argv[1], "build") == 0) {
+		return Build(argc, argv);
+	}
+	if (argc > 1 and std::strcmp(argv[1], "query") == 0) {
+		return Query(argc, argv);
+	}
+
+	std::cerr << "Usage: TicTacToeStats build [--archive] SOURCE STORE\n"
+				 "       TicTacToeStats query [--threads N] STORE GROUP [COLUMN=MIN[..MAX]]..."
+			  << std::endl;
+	return -1;
+}
@@ -0,0 +1,487 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "file_io.h"
+#include "stats_store.h"
+
+
+static constexpr unsigned char Magic[8] = { 'T', 'T', 'T', 'C', 'O', 'L', 'S', '1' };
+
+static constexpr u64 BufferSize  = 1 << 20;
+static constexpr u64 Padding     = 8;       // so unpacking can always load 8 bytes
+static constexpr u32 DenseGroups = 4096;    // wider key ranges use the map directly
+
+struct StoreHeader {
+	unsigned char m_Magic[8];
+	u32           m_Columns;
+	u32           m_BlockRows;
+	u64           m_Rows;
+	u64           m_Blocks;
+	u64           m_Directory;    // offset of the BlockInfo table
+};
+
+static u64 PackedSize(u32 rows, u32 width)
+{
+	return (static_cast<u64>(rows) * width + 7) / 8 + Padding;
+}
+
+const char* ColumnName(StatsColumn column)
+{
+	switch (column) {
+	case COLUMN_TIME:
+		return "time";
+	case COLUMN_OPENING:
+		return "opening";
+	case COLUMN_LENGTH:
+		return "length";
+	case COLUMN_RESULT:
+		return "result";
+	case COLUMN_MODE:
+		return "mode";
+	case COLUMN_DEPTH:
+		return "depth";
+	case COLUMN_COUNT:
+		break;
+	}
+
+	return "?";
+}
+
+std::array<u32, COLUMN_COUNT> SummarizeGame(const GameRecord& record)
+{
+	const u32 moves = std::min(record.m_Moves, 9u);
+
+	u32 opening {};
+	for (u32 i = 0; i < 3; ++i) {
+		opening = opening * 10 + (i < moves ? std::min<u32>(record.m_History[i], 9) : 9);
+	}
+
+	std::array<u32, COLUMN_COUNT> values {};
+	values[COLUMN_TIME]    = static_cast<u32>(record.m_Time / 1'000'000'000);
+	values[COLUMN_OPENING] = opening;
+	values[COLUMN_LENGTH]  = moves;
+	values[COLUMN_RESULT]  = static_cast<u32>(record.m_Winner + 1);
+	values[COLUMN_MODE]    = record.m_Mode;
+	values[COLUMN_DEPTH]   = record.m_EngineDepth;
+
+	return values;
+}
+
+StatsWriter::StatsWriter() :
+	m_File { -1 },
+	m_Failed { false },
+	m_Rows {},
+	m_Bytes {}
+{
+}
+
+StatsWriter::~StatsWriter()
+{
+	if (m_File != -1) {
+		close(m_File);
+		unlink((m_Path + ".tmp").c_str());
+	}
+}
+
+bool StatsWriter::Open(const char* path)
+{
+	// Written to path.tmp until Close() renames it over path.
+	m_Path = path;
+	m_File = CreateTemporary(m_Path, "StatsStore");
+	if (m_File == -1) {
+		return false;
+	}
+
+	for (auto& column : m_Columns) {
+		column.reserve(BlockRows);
+	}
+
+	// Room for the header, written last.
+	m_Buffer.reserve(BufferSize + COLUMN_COUNT * PackedSize(BlockRows, 32));
+	m_Buffer.assign(sizeof(StoreHeader), 0);
+
+	return true;
+}
+
+void StatsWriter::Append(const GameRecord& record)
+{
+	const std::array<u32, COLUMN_COUNT> values = SummarizeGame(record);
+	for (u32 column = 0; column < COLUMN_COUNT; ++column) {
+		m_Columns[column].push_back(values[column]);
+	}
+
+	++m_Rows;
+
+	if (m_Columns[0].size() == BlockRows) {
+		WriteBlock();
+	}
+}
+
+bool StatsWriter::Close()
+{
+	if (m_File == -1) {
+		return false;
+	}
+
+	if (!m_Columns[0].empty()) {
+		WriteBlock();
+	}
+
+	// The directory is used in place, so it starts on a BlockInfo boundary.
+	const u64 end = m_Bytes + m_Buffer.size();
+	m_Buffer.resize(m_Buffer.size() + (alignof(BlockInfo) - end % alignof(BlockInfo)) %
+										  alignof(BlockInfo));
+
+	StoreHeader header {};
+	std::memcpy(header.m_Magic, Magic, sizeof(Magic));
+	header.m_Columns   = COLUMN_COUNT;
+	header.m_BlockRows = BlockRows;
+	header.m_Rows      = m_Rows;
+	header.m_Blocks    = m_Blocks.size();
+	header.m_Directory = m_Bytes + m_Buffer.size();
+
+	const auto* directory = reinterpret_cast<const unsigned char*>(m_Blocks.data());
+	m_Buffer.insert(m_Buffer.end(), directory, directory + m_Blocks.size() * sizeof(BlockInfo));
+
+	const bool ok = Flush() and pwrite(m_File, &header, sizeof(header), 0) == sizeof(header) and
+					fdatasync(m_File) == 0;
+
+	const int file = m_File;
+	m_File         = -1;
+
+	return ReplaceWithTemporary(file, m_Path, ok, "StatsStore");
+}
+
+u64 StatsWriter::Rows() const
+{
+	return m_Rows;
+}
+
+u64 StatsWriter::Bytes() const
+{
+	return m_Bytes + m_Buffer.size();
+}
+
+void StatsWriter::WriteBlock()
+{
+	BlockInfo info {};
+	info.m_Rows = static_cast<u32>(m_Columns[0].size());
+
+	for (u32 column = 0; column < COLUMN_COUNT; ++column) {
+		std::vector<u32>& values = m_Columns[column];
+		ColumnChunk&      chunk  = info.m_Columns[column];
+
+		const auto [low, high] = std::minmax_element(values.begin(), values.end());
+		chunk.m_Min            = *low;
+		chunk.m_Max            = *high;
+		chunk.m_Width          = static_cast<u32>(std::bit_width(chunk.m_Max - chunk.m_Min));
+		chunk.m_Offset         = m_Bytes + m_Buffer.size();
+
+		const u64 start = m_Buffer.size();
+		m_Buffer.resize(start + PackedSize(info.m_Rows, chunk.m_Width));
+		unsigned char* data = m_Buffer.data() + start;
+
+		if (chunk.m_Width > 0) {
+			for (u32 i = 0; i < info.m_Rows; ++i) {
+				const u64 bit = static_cast<u64>(i) * chunk.m_Width;
+
+				u64 word {};
+				std::memcpy(&word, data + bit / 8, 8);
+				word |= static_cast<u64>(values[i] - chunk.m_Min) << (bit % 8);
+				std::memcpy(data + bit / 8, &word, 8);
+			}
+		}
+
+		values.clear();
+	}
+
+	m_Blocks.push_back(info);
+
+	if (m_Buffer.size() >= BufferSize) {
+		Flush();
+	}
+}
+
+bool StatsWriter::Flush()
+{
+	if (!m_Failed and !WriteAll(m_File, m_Buffer.data(), m_Buffer.size(), "StatsStore")) {
+		m_Failed = true;
+	}
+
+	m_Bytes += m_Buffer.size();
+	m_Buffer.clear();
+
+	return !m_Failed;
+}
+
+StatsStore::StatsStore() :
+	m_Map { nullptr },
+	m_MapSize {},
+	m_Blocks { nullptr },
+	m_BlockCount {},
+	m_Rows {}
+{
+}
+
+StatsStore::~StatsStore()
+{
+	Close();
+}
+
+bool StatsStore::Open(const char* path)
+{
+	const int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		std::cerr << "StatsStore: cannot open " << path << ": " << std::strerror(errno)
+				  << std::endl;
+		return false;
+	}
+
+	struct stat status {};
+	if (fstat(fd, &status) == -1 or static_cast<u64>(status.st_size) < sizeof(StoreHeader)) {
+		std::cerr << "StatsStore: " << path << " is not a stats store" << std::endl;
+		close(fd);
+		return false;
+	}
+
+	const u64 size   = static_cast<u64>(status.st_size);
+	void*     memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED) {
+		std::cerr << "StatsStore: mmap failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	m_Map     = static_cast<const unsigned char*>(memory);
+	m_MapSize = size;
+
+	StoreHeader header {};
+	std::memcpy(&header, m_Map, sizeof(header));
+
+	bool valid = std::memcmp(header.m_Magic, Magic, sizeof(Magic)) == 0 and
+				 header.m_Columns == COLUMN_COUNT and header.m_BlockRows == StatsWriter::BlockRows and
+				 header.m_Directory % alignof(BlockInfo) == 0 and header.m_Directory <= size and
+				 header.m_Blocks <= (size - header.m_Directory) / sizeof(BlockInfo);
+
+	const auto* blocks = reinterpret_cast<const BlockInfo*>(m_Map + header.m_Directory);
+	u64         rows {};
+
+	for (u64 block = 0; valid and block < header.m_Blocks; ++block) {
+		valid = blocks[block].m_Rows <= StatsWriter::BlockRows;
+		rows += blocks[block].m_Rows;
+
+		for (const ColumnChunk& chunk : blocks[block].m_Columns) {
+			valid = valid and chunk.m_Width <= 32 and chunk.m_Min <= chunk.m_Max and
+					chunk.m_Offset <= header.m_Directory and
+					PackedSize(blocks[block].m_Rows, chunk.m_Width) <=
+						header.m_Directory - chunk.m_Offset;
+		}
+	}
+
+	if (!valid or rows != header.m_Rows) {
+		std::cerr << "StatsStore: " << path << " is not a stats store" << std::endl;
+		Close();
+		return false;
+	}
+
+	m_Blocks     = blocks;
+	m_BlockCount = header.m_Blocks;
+	m_Rows       = header.m_Rows;
+
+	return true;
+}
+
+void StatsStore::Close()
+{
+	if (m_Map != nullptr) {
+		munmap(const_cast<unsigned char*>(m_Map), m_MapSize);
+	}
+
+	m_Map        = nullptr;
+	m_MapSize    = 0;
+	m_Blocks     = nullptr;
+	m_BlockCount = 0;
+	m_Rows       = 0;
+}
+
+u64 StatsStore::Rows() const
+{
+	return m_Rows;
+}
+
+u64 StatsStore::Blocks() const
+{
+	return m_BlockCount;
+}
+
+StatsResult StatsStore::Aggregate(const StatsQuery& query, u32 threads) const
+{
+	std::vector<StatsResult> results(std::max(threads, 1u));
+	std::vector<std::thread> workers {};
+	std::atomic<u64>         next {};
+
+	const auto work = [&](StatsResult& result) {
+		Scratch scratch {};
+		for (u64 block = next++; block < m_BlockCount; block = next++) {
+			Scan(query, block, scratch, result);
+		}
+	};
+
+	for (u32 i = 1; i < results.size(); ++i) {
+		workers.emplace_back(work, std::ref(results[i]));
+	}
+	work(results[0]);
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	for (u32 i = 1; i < results.size(); ++i) {
+		results[0].m_Rows += results[i].m_Rows;
+		results[0].m_BlocksRead += results[i].m_BlocksRead;
+		results[0].m_BlocksSkipped += results[i].m_BlocksSkipped;
+
+		for (const auto& [key, counts] : results[i].m_Groups) {
+			OutcomeCounts& total = results[0].m_Groups[key];
+			total.m_Games += counts.m_Games;
+			total.m_XWins += counts.m_XWins;
+			total.m_Draws += counts.m_Draws;
+			total.m_OWins += counts.m_OWins;
+		}
+	}
+
+	return std::move(results[0]);
+}
+
+void StatsStore::Scan(const StatsQuery& query, u64 block, Scratch& scratch, StatsResult& result) const
+{
+	const BlockInfo& info = m_Blocks[block];
+	const u32        rows = info.m_Rows;
+
+	for (const StatsFilter& filter : query.m_Filters) {
+		const ColumnChunk& chunk = info.m_Columns[filter.m_Column];
+		if (filter.m_Max < chunk.m_Min or filter.m_Min > chunk.m_Max) {
+			++result.m_BlocksSkipped;
+			return;
+		}
+	}
+
+	++result.m_BlocksRead;
+
+	scratch.m_Values.resize(rows);
+	scratch.m_Keys.resize(rows);
+	scratch.m_Results.resize(rows);
+	scratch.m_Mask.assign(rows, 1);
+
+	u32*           values = scratch.m_Values.data();
+	unsigned char* mask   = scratch.m_Mask.data();
+
+	for (const StatsFilter& filter : query.m_Filters) {
+		const ColumnChunk& chunk = info.m_Columns[filter.m_Column];
+		if (filter.m_Min <= chunk.m_Min and filter.m_Max >= chunk.m_Max) {
+			continue;    // every row of the block passes
+		}
+
+		Unpack(chunk, rows, values);
+
+		const u32 low  = filter.m_Min;
+		const u32 span = filter.m_Max - filter.m_Min;
+		for (u32 i = 0; i < rows; ++i) {
+			mask[i] &= values[i] - low <= span;
+		}
+	}
+
+	u32* keys    = scratch.m_Keys.data();
+	u32* outcome = scratch.m_Results.data();
+
+	const ColumnChunk& group   = info.m_Columns[query.m_GroupBy];
+	const u32          divisor = std::max(query.m_Divisor, 1u);
+
+	Unpack(info.m_Columns[COLUMN_RESULT], rows, outcome);
+	Unpack(group, rows, keys);
+
+	const u32 first = group.m_Min / divisor;
+	const u32 range = group.m_Max / divisor - first + 1;
+
+	if (divisor > 1) {
+		for (u32 i = 0; i < rows; ++i) {
+			keys[i] /= divisor;
+		}
+	}
+
+	u64 matched {};
+	for (u32 i = 0; i < rows; ++i) {
+		matched += mask[i];
+	}
+	result.m_Rows += matched;
+
+	if (matched == 0) {
+		return;
+	}
+
+	// Results are Utility + 1: O, draw, X.
+	const auto add = [](OutcomeCounts& counts, u64 o, u64 draws, u64 x) {
+		counts.m_Games += o + draws + x;
+		counts.m_OWins += o;
+		counts.m_Draws += draws;
+		counts.m_XWins += x;
+	};
+
+	if (range <= DenseGroups) {
+		scratch.m_Counts.assign(static_cast<u64>(range) * 3, 0);
+		u64* counts = scratch.m_Counts.data();
+
+		for (u32 i = 0; i < rows; ++i) {
+			counts[(keys[i] - first) * 3 + std::min(outcome[i], 2u)] += mask[i];
+		}
+
+		for (u32 key = 0; key < range; ++key) {
+			const u64* row = counts + key * 3;
+			if (row[0] + row[1] + row[2] > 0) {
+				add(result.m_Groups[first + key], row[0], row[1], row[2]);
+			}
+		}
+	}
+	else {
+		for (u32 i = 0; i < rows; ++i) {
+			if (mask[i] != 0) {
+				const u32 value = std::min(outcome[i], 2u);
+				add(result.m_Groups[keys[i]], value == 0, value == 1, value == 2);
+			}
+		}
+	}
+}
+
+// Values are LSB first in a bit stream; each is one unaligned 8 byte load,
+// a shift and a mask, which the padding after every chunk makes safe.
+void StatsStore::Unpack(const ColumnChunk& chunk, u32 rows, u32* out) const
+{
+	if (chunk.m_Width == 0) {
+		std::fill(out, out + rows, chunk.m_Min);
+		return;
+	}
+
+	const unsigned char* data  = m_Map + chunk.m_Offset;
+	const u32            width = chunk.m_Width;
+	const u64            mask  = (u64 { 1 } << width) - 1;
+	const u32            base  = chunk.m_Min;
+
+	for (u32 i = 0; i < rows; ++i) {
+		const u64 bit = static_cast<u64>(i) * width;
+
+		u64 word {};
+		std::memcpy(&word, data + bit / 8, 8);
+		out[i] = base + static_cast<u32>(word >> (bit % 8) & mask);
+	}
+}
@@ -0,0 +1,148 @@
+#ifndef STATS_STORE_H
+#define STATS_STORE_H
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "journal.h"
+
+
+enum StatsColumn : u32 {
+	COLUMN_TIME,       // Unix seconds
+	COLUMN_OPENING,    // first three cells as decimal digits, 9 where none
+	COLUMN_LENGTH,     // moves
+	COLUMN_RESULT,     // Utility + 1
+	COLUMN_MODE,       // GameMode
+	COLUMN_DEPTH,      // engine depth
+	COLUMN_COUNT
+};
+
+const char* ColumnName(StatsColumn column);
+
+// The columns of one game, as stored.
+std::array<u32, COLUMN_COUNT> SummarizeGame(const GameRecord& record);
+
+// Keeps rows whose column lies in [m_Min, m_Max].
+struct StatsFilter {
+	StatsColumn m_Column {};
+	u32         m_Min {};
+	u32         m_Max {};
+};
+
+// Outcome counts grouped by m_GroupBy / m_Divisor, e.g. COLUMN_TIME with
+// 86400 for days or COLUMN_OPENING with 100 for the first move.
+struct StatsQuery {
+	std::vector<StatsFilter> m_Filters;
+	StatsColumn              m_GroupBy { COLUMN_MODE };
+	u32                      m_Divisor { 1 };
+};
+
+struct OutcomeCounts {
+	u64 m_Games {};
+	u64 m_XWins {};
+	u64 m_Draws {};
+	u64 m_OWins {};
+};
+
+struct StatsResult {
+	std::map<u32, OutcomeCounts> m_Groups;
+	u64                          m_Rows {};             // rows that passed the filters
+	u64                          m_BlocksRead {};
+	u64                          m_BlocksSkipped {};    // ruled out by min/max alone
+};
+
+// Per-block metadata of a StatsStore file.
+struct ColumnChunk {
+	u64 m_Offset {};
+	u32 m_Min {};
+	u32 m_Max {};
+	u32 m_Width {};    // bits per value after subtracting m_Min
+	u32 m_Reserved {};
+};
+
+struct BlockInfo {
+	u32         m_Rows {};
+	u32         m_Reserved {};
+	ColumnChunk m_Columns[COLUMN_COUNT];
+};
+
+// Writes game summaries column by column in blocks of BlockRows. Each column
+// of a block is stored as its minimum and the differences from it packed to
+// the fewest bits that hold them, so a month of timestamps or a column of
+// results costs a few bits a row.
+class StatsWriter {
+public:
+	static constexpr u32 BlockRows = 1 << 16;
+
+	StatsWriter();
+	~StatsWriter();
+
+	StatsWriter(const StatsWriter&)            = delete;
+	StatsWriter& operator=(const StatsWriter&) = delete;
+
+	bool Open(const char* path);
+	void Append(const GameRecord& record);
+
+	// Writes the block directory and moves the file into place.
+	bool Close();
+
+	u64 Rows() const;
+	u64 Bytes() const;
+
+private:
+	std::string                                m_Path;
+	int                                        m_File;
+	bool                                       m_Failed;
+	u64                                        m_Rows;
+	u64                                        m_Bytes;
+	std::array<std::vector<u32>, COLUMN_COUNT> m_Columns;
+	std::vector<BlockInfo>                     m_Blocks;
+	std::vector<unsigned char>                 m_Buffer;
+
+	void WriteBlock();
+	bool Flush();
+};
+
+// Read-only StatsStore mapped with mmap. Aggregate() skips blocks whose
+// min/max rule out a filter, unpacks only the columns a query touches one
+// block at a time, and evaluates filters and counts with branch-free loops
+// over those arrays, spread over threads by block.
+class StatsStore {
+public:
+	StatsStore();
+	~StatsStore();
+
+	StatsStore(const StatsStore&)            = delete;
+	StatsStore& operator=(const StatsStore&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	u64 Rows() const;
+	u64 Blocks() const;
+
+	StatsResult Aggregate(const StatsQuery& query, u32 threads = 1) const;
+
+private:
+	// Column arrays for one block, reused across the blocks of a thread.
+	struct Scratch {
+		std::vector<u32>           m_Values;
+		std::vector<u32>           m_Keys;
+		std::vector<u32>           m_Results;
+		std::vector<unsigned char> m_Mask;
+		std::vector<u64>           m_Counts;
+	};
+
+	const unsigned char* m_Map;
+	u64                  m_MapSize;
+	const BlockInfo*     m_Blocks;
+	u64                  m_BlockCount;
+	u64                  m_Rows;
+
+	void Scan(const StatsQuery& query, u64 block, Scratch& scratch, StatsResult& result) const;
+	void Unpack(const ColumnChunk& chunk, u32 rows, u32* out) const;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+#include "rules.h"
+
+
+// Lock-free hand-off of the latest value from one writer to one reader.
+// The writer fills its back slot and swaps it with the middle one; the
+// reader swaps the middle one for its front slot when it holds something
+// newer. Neither side ever waits for the other, and a reader that falls
+// behind skips straight to the newest value.
+template <typename T>
+class TripleBuffer {
+public:
+	// Writer side: the slot to fill before Publish().
+	T& Back()
+	{
+		return m_Slots[m_Back];
+	}
+
+	void Publish()
+	{
+		m_Back = m_Middle.exchange(m_Back | Fresh, std::memory_order_acq_rel) & Index;
+	}
+
+	// Reader side: true when Front() changed to a newer value.
+	bool Update()
+	{
+		if ((m_Middle.load(std::memory_order_relaxed) & Fresh) == 0) {
+			return false;
+		}
+
+		m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & Index;
+		return true;
+	}
+
+	const T& Front() const
+	{
+		return m_Slots[m_Front];
+	}
+
+private:
+	static constexpr u32 Index = 3;
+	static constexpr u32 Fresh = 4;
+
+	T m_Slots[3] {};
+
+	alignas(64) std::atomic<u32> m_Middle { 1 };
+	alignas(64) u32 m_Back { 0 };
+	alignas(64) u32 m_Front { 2 };
+};
+
+#endif